@@ -0,0 +1,245 @@
+/**
+ * @file lattice_search.h
+ * @brief A* over a PrimitiveSet on an egocentric occupancy grid built from
+ *          one scan.
+ *
+ * The grid marks scan hits as occupied and cells within `near_radius` of
+ * one as "near", from a CostmapInflation that only recomputes distances
+ * around hits that moved since the last scan. A primitive is rejected if
+ * any of its swept cells is occupied and pays extra for every near cell.
+ * The search starts at base_link facing heading bin 0 and ends at the
+ * first state at least `goal_dist` away. If no such state is reachable,
+ * the expanded state that got furthest is used.
+ *
+ * Nothing is allocated per plan: search nodes come from a pool that is
+ * reset every cycle, the open list is a heap over a reused vector, and
+ * the best-cost table is invalidated by bumping a generation counter
+ * instead of being cleared.
+ */
+#pragma once
+
+#include <lattice_planner/primitive_set.h>
+#include <race_common/costmap_inflation.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lattice_planner
+{
+
+struct search_params
+{
+    float resolution;           // meters per cell, the primitive set's
+    float back, front, side;    // grid extent around base_link (m)
+    float lidar_x;              // lidar position ahead of base_link (m)
+    float near_radius;          // ring around hits that costs extra (m)
+    float goal_dist;            // plan at least this far out (m)
+    float w_steer;              // per meter, per radian of steering
+    float w_switch;             // per radian of steering change between primitives
+    float w_near;               // per near cell swept
+    int max_expansions;
+};
+
+class LatticeSearch
+{
+    private:
+        struct node
+        {
+            int x, y;               // cell
+            int h;                  // heading bin
+            float g;
+            int parent;             // pool index, -1 for the root
+            const primitive *prim;  // primitive that led here
+        };
+
+        const PrimitiveSet &set;
+        search_params p;
+        float res, inv_res;
+        int width, height, origin_x, origin_y, bins;
+
+        std::unique_ptr<race_common::CostmapInflation> inflation;
+        int near_d2;    // squared cells
+
+        // Best g per (cell, heading); valid only where stamp == generation
+        std::vector<float> best_g;
+        std::vector<uint32_t> stamp;
+        uint32_t generation;
+
+        std::vector<node> pool;
+        std::vector<std::pair<float, int>> open;    // (f, pool index), min-heap
+        int expansions;
+
+        // Cost of driving `prim` from (x, y), or < 0 if it hits or leaves the grid
+        float sweep_cost(int x, int y, const primitive &prim) const
+        {
+            auto c = set.sweep(prim);
+            int near = 0;
+            for(uint32_t i = 0; i < prim.num_cells; i++)
+            {
+                auto cx = x + c[i].dx, cy = y + c[i].dy;
+                if(cx < 0 || cy < 0 || cx >= width || cy >= height)
+                    return -1.0f;
+                auto d2 = inflation->at(cx, cy);
+                if(d2 == 0)
+                    return -1.0f;
+                near += d2 <= near_d2;
+            }
+            return p.w_near*near;
+        }
+
+        float dist(int x, int y) const
+        {
+            return std::hypot((x - origin_x)*res, (y - origin_y)*res);
+        }
+
+    public:
+        LatticeSearch(const PrimitiveSet &set, const search_params &p)
+            : set(set), p(p), generation(0), expansions(0)
+        {
+            const auto &hdr = set.getHeader();
+            res = p.resolution;
+            inv_res = 1.0f/res;
+            bins = hdr.heading_bins;
+            origin_x = (int)std::ceil(p.back*inv_res);
+            origin_y = (int)std::ceil(p.side*inv_res);
+            width = origin_x + (int)std::ceil(p.front*inv_res) + 1;
+            height = 2*origin_y + 1;
+
+            best_g.resize(width*height*bins);
+            stamp.assign(width*height*bins, 0);
+            pool.reserve(p.max_expansions*8);
+            open.reserve(p.max_expansions*8);
+
+            auto r = (int)std::ceil(p.near_radius*inv_res);
+            near_d2 = r*r;
+            inflation.reset(new race_common::CostmapInflation(width, height, r));
+        }
+
+        template <typename Scan>
+        void build(const Scan &msg)
+        {
+            inflation->clear();
+
+            auto angle = msg.angle_min;
+            for(size_t i = 0; i < msg.ranges.size(); i++, angle += msg.angle_increment)
+            {
+                auto r = msg.ranges[i];
+                if(!(r >= msg.range_min && r <= msg.range_max))
+                    continue;
+                auto x = origin_x + (int)std::lround((p.lidar_x + r*std::cos(angle))*inv_res);
+                auto y = origin_y + (int)std::lround(r*std::sin(angle)*inv_res);
+                if(x >= 0 && y >= 0 && x < width && y < height)
+                    inflation->mark(x, y);
+            }
+            inflation->update();
+        }
+
+        /**
+         * @brief Search from base_link.
+         *
+         * @param out   primitives to drive, first one first
+         * @return      true if the goal distance was reached, false if `out`
+         *              holds the best partial plan (possibly empty)
+         */
+        bool plan(std::vector<const primitive *> &out)
+        {
+            out.clear();
+            pool.clear();
+            open.clear();
+            expansions = 0;
+            if(++generation == 0)
+            {
+                std::fill(stamp.begin(), stamp.end(), 0);
+                generation = 1;
+            }
+
+            auto greater = std::greater<std::pair<float, int>>();
+            pool.push_back({origin_x, origin_y, 0, 0.0f, -1, nullptr});
+            open.emplace_back(p.goal_dist, 0);
+
+            int goal = -1, best = 0;
+            auto best_h = p.goal_dist;
+            while(!open.empty() && expansions < p.max_expansions)
+            {
+                std::pop_heap(open.begin(), open.end(), greater);
+                auto idx = open.back().second;
+                open.pop_back();
+
+                auto cur = pool[idx];
+                auto state = (cur.y*width + cur.x)*bins + cur.h;
+                if(cur.parent >= 0 && stamp[state] == generation && best_g[state] < cur.g)
+                    continue;   // stale entry, a cheaper one was expanded
+
+                auto h = std::max(0.0f, p.goal_dist - dist(cur.x, cur.y));
+                if(h < best_h)
+                {
+                    best_h = h;
+                    best = idx;
+                }
+                if(h <= 0.0f)
+                {
+                    goal = idx;
+                    break;
+                }
+                expansions++;
+
+                auto parent_steer = cur.prim != nullptr ? cur.prim->steer : 0.0f;
+                for(auto prim = set.begin(cur.h); prim != set.end(cur.h); ++prim)
+                {
+                    auto extra = sweep_cost(cur.x, cur.y, *prim);
+                    if(extra < 0.0f)
+                        continue;
+
+                    auto nx = cur.x + prim->dx, ny = cur.y + prim->dy;
+                    if(nx < 0 || ny < 0 || nx >= width || ny >= height)
+                        continue;
+                    auto g = cur.g + prim->length*(1.0f + p.w_steer*std::fabs(prim->steer))
+                             + p.w_switch*std::fabs(prim->steer - parent_steer) + extra;
+                    auto next = (ny*width + nx)*bins + prim->end_heading;
+                    if(stamp[next] == generation && best_g[next] <= g)
+                        continue;
+                    stamp[next] = generation;
+                    best_g[next] = g;
+
+                    pool.push_back({nx, ny, prim->end_heading, g, idx, &*prim});
+                    auto f = g + std::max(0.0f, p.goal_dist - dist(nx, ny));
+                    open.emplace_back(f, (int)pool.size() - 1);
+                    std::push_heap(open.begin(), open.end(), greater);
+                }
+            }
+
+            for(auto i = goal >= 0 ? goal : best; pool[i].parent >= 0; i = pool[i].parent)
+                out.push_back(pool[i].prim);
+            std::reverse(out.begin(), out.end());
+            return goal >= 0;
+        }
+
+        /**
+         * @brief Poses along `plan` in base_link, for drawing it.
+         */
+        void trace(const std::vector<const primitive *> &plan, std::vector<pose> &out) const
+        {
+            out.clear();
+            float x = 0.0f, y = 0.0f;
+            for(auto prim : plan)
+            {
+                auto ps = set.path(*prim);
+                for(uint32_t i = 0; i < prim->num_poses; i++)
+                    out.push_back({x + ps[i].x, y + ps[i].y, ps[i].yaw});
+                x += prim->dx*res;
+                y += prim->dy*res;
+            }
+        }
+
+        int getExpansions() const
+        {
+            return expansions;
+        }
+};
+
+} // namespace lattice_planner
@@ -0,0 +1,233 @@
+/**
+ * @file primitive_set.h
+ * @brief Precomputed motion primitives for the state lattice, and their
+ *          on-disk format.
+ *
+ * A primitive is a constant-steering arc from a lattice state (cell,
+ * heading bin) to another lattice state. Alongside its end point it
+ * carries every grid cell the car's footprint sweeps while driving it,
+ * relative to the start cell, so a collision check is a walk over a short
+ * list of offsets instead of any geometry at plan time.
+ *
+ * The file is a header, a per-heading index into the primitive table, the
+ * primitive table, the swept cell pool and the pose pool (for drawing the
+ * path). It is memory mapped read-only like race_common::SpeedMap.
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace lattice_planner
+{
+
+struct primitive_set_header
+{
+    char magic[4];              // "LATP"
+    uint32_t version;
+    uint32_t heading_bins;
+    float resolution;           // meters per cell
+    float wheelbase, max_steer; // what the set was generated for
+    uint32_t num_primitives, num_cells, num_poses;
+};
+
+struct primitive
+{
+    uint16_t start_heading, end_heading;
+    int16_t dx, dy;             // end cell relative to the start cell
+    float length;               // arc length (m)
+    float steer;                // steering angle held along the arc (rad)
+    uint32_t first_cell, num_cells;
+    uint32_t first_pose, num_poses;
+};
+
+struct cell_offset
+{
+    int16_t dx, dy;
+};
+
+struct pose
+{
+    float x, y, yaw;            // relative to the start cell's center
+};
+
+class PrimitiveSet
+{
+    private:
+        const primitive_set_header *header;
+        const uint32_t *heading_index;  // heading_bins + 1 entries
+        const primitive *prims;
+        const cell_offset *cells;
+        const pose *poses;
+        size_t mapped_size;
+
+        static size_t file_size(uint32_t heading_bins, uint32_t num_primitives,
+                                uint32_t num_cells, uint32_t num_poses)
+        {
+            return sizeof(primitive_set_header) + ((size_t)heading_bins + 1)*sizeof(uint32_t)
+                   + (size_t)num_primitives*sizeof(primitive) + (size_t)num_cells*sizeof(cell_offset)
+                   + (size_t)num_poses*sizeof(pose);
+        }
+
+        // Every index and offset in the tables stays inside the file, so
+        // the planner can follow them without checking
+        bool consistent() const
+        {
+            const auto &h = *header;
+            if(heading_index[0] != 0 || heading_index[h.heading_bins] > h.num_primitives)
+                return false;
+            for(uint32_t b = 0; b < h.heading_bins; b++)
+            {
+                if(heading_index[b] > heading_index[b + 1])
+                    return false;
+                for(auto p = begin(b); p != end(b); p++)
+                {
+                    if(p->start_heading != b || p->end_heading >= h.heading_bins ||
+                       (uint64_t)p->first_cell + p->num_cells > h.num_cells ||
+                       (uint64_t)p->first_pose + p->num_poses > h.num_poses)
+                        return false;
+                }
+            }
+            return true;
+        }
+
+    public:
+        static constexpr uint32_t VERSION = 1;
+
+        PrimitiveSet()
+            : header(nullptr), heading_index(nullptr), prims(nullptr),
+              cells(nullptr), poses(nullptr), mapped_size(0) {}
+
+        ~PrimitiveSet()
+        {
+            close();
+        }
+
+        PrimitiveSet(const PrimitiveSet &) = delete;
+        PrimitiveSet &operator=(const PrimitiveSet &) = delete;
+
+        bool open(const std::string &path)
+        {
+            close();
+
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0)
+                return false;
+
+            struct stat st;
+            if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(primitive_set_header))
+            {
+                ::close(fd);
+                return false;
+            }
+
+            void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if(data == MAP_FAILED)
+                return false;
+
+            auto hdr = (const primitive_set_header *)data;
+            if(std::memcmp(hdr->magic, "LATP", 4) != 0 || hdr->version != VERSION ||
+               hdr->heading_bins == 0 || hdr->resolution <= 0.0f ||
+               (size_t)st.st_size < file_size(hdr->heading_bins, hdr->num_primitives,
+                                              hdr->num_cells, hdr->num_poses))
+            {
+                munmap(data, st.st_size);
+                return false;
+            }
+
+            auto p = (const char *)data + sizeof(primitive_set_header);
+            header = hdr;
+            heading_index = (const uint32_t *)p;
+            p += (hdr->heading_bins + 1)*sizeof(uint32_t);
+            prims = (const primitive *)p;
+            p += hdr->num_primitives*sizeof(primitive);
+            cells = (const cell_offset *)p;
+            p += hdr->num_cells*sizeof(cell_offset);
+            poses = (const pose *)p;
+            mapped_size = st.st_size;
+            if(!consistent())
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close()
+        {
+            if(header != nullptr)
+                munmap((void *)header, mapped_size);
+            header = nullptr;
+            mapped_size = 0;
+        }
+
+        bool loaded() const
+        {
+            return header != nullptr;
+        }
+
+        const primitive_set_header &getHeader() const
+        {
+            return *header;
+        }
+
+        // Primitives leaving heading bin `h` are prims [begin(h), end(h))
+        const primitive *begin(uint32_t h) const { return prims + heading_index[h]; }
+        const primitive *end(uint32_t h) const { return prims + heading_index[h + 1]; }
+
+        const cell_offset *sweep(const primitive &p) const { return cells + p.first_cell; }
+        const pose *path(const primitive &p) const { return poses + p.first_pose; }
+
+        /**
+         * @brief Write a set in the format `open` expects. `prims` must be
+         *          sorted by start heading.
+         */
+        static bool write(const std::string &path, uint32_t heading_bins, float resolution,
+                          float wheelbase, float max_steer,
+                          const std::vector<primitive> &prims,
+                          const std::vector<cell_offset> &cells,
+                          const std::vector<pose> &poses)
+        {
+            primitive_set_header hdr;
+            std::memcpy(hdr.magic, "LATP", 4);
+            hdr.version = VERSION;
+            hdr.heading_bins = heading_bins;
+            hdr.resolution = resolution;
+            hdr.wheelbase = wheelbase;
+            hdr.max_steer = max_steer;
+            hdr.num_primitives = prims.size();
+            hdr.num_cells = cells.size();
+            hdr.num_poses = poses.size();
+
+            std::vector<uint32_t> index(heading_bins + 1, 0);
+            for(const auto &p : prims)
+            {
+                if(p.start_heading >= heading_bins)
+                    return false;
+                index[p.start_heading + 1]++;
+            }
+            for(uint32_t h = 0; h < heading_bins; h++)
+                index[h + 1] += index[h];
+
+            FILE *f = std::fopen(path.c_str(), "wb");
+            if(f == nullptr)
+                return false;
+            auto ok = std::fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+                      std::fwrite(index.data(), sizeof(uint32_t), index.size(), f) == index.size() &&
+                      std::fwrite(prims.data(), sizeof(primitive), prims.size(), f) == prims.size() &&
+                      std::fwrite(cells.data(), sizeof(cell_offset), cells.size(), f) == cells.size() &&
+                      std::fwrite(poses.data(), sizeof(pose), poses.size(), f) == poses.size();
+            return std::fclose(f) == 0 && ok;
+        }
+};
+
+} // namespace lattice_planner
@@ -0,0 +1,170 @@
+/**
+ * @file generate_primitives.cpp
+ * @brief Offline generator for the lattice planner's primitive set.
+ *
+ * For every heading bin and steering level it drives a constant-steering
+ * arc of about `lattice_primitive_length`, trimming the length so the arc
+ * ends exactly on a heading bin, and snaps the end point to the nearest
+ * cell. The snapping error is at most half a cell and is covered by the
+ * footprint margin. The footprint (rear axle to front axle, `width` wide,
+ * the same box safety_node uses) is rasterized along the arc into the
+ * primitive's swept cell list.
+ *
+ * Run once per car geometry: `roslaunch lattice_planner generate_primitives.launch`.
+ */
+
+#include <ros/ros.h>
+
+#include <lattice_planner/primitive_set.h>
+#include <race_common/car_geometry.h>
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+struct generator_params
+{
+    race_common::car_intrinsics car;
+    double max_steer, resolution, length, margin;
+    int heading_bins, steer_levels;
+};
+
+// Cells under the footprint box (rear axle to front axle, grown by the
+// margin) with base_link at (x, y, yaw) relative to the start cell's center
+void footprint_cells(const generator_params &p, double x, double y, double yaw,
+                     std::set<std::pair<int, int>> &out)
+{
+    auto step = p.resolution/2.0;
+    auto c = std::cos(yaw), s = std::sin(yaw);
+    for(auto fx = -p.margin; fx <= p.car.wheelbase + p.margin + 1e-9; fx += step)
+    {
+        for(auto fy = -p.car.width/2.0 - p.margin; fy <= p.car.width/2.0 + p.margin + 1e-9; fy += step)
+        {
+            auto wx = x + c*fx - s*fy, wy = y + s*fx + c*fy;
+            out.emplace((int)std::lround(wy/p.resolution), (int)std::lround(wx/p.resolution));
+        }
+    }
+}
+
+void generate(const generator_params &p,
+              std::vector<lattice_planner::primitive> &prims,
+              std::vector<lattice_planner::cell_offset> &cells,
+              std::vector<lattice_planner::pose> &poses)
+{
+    auto bin_width = 2.0*M_PI/p.heading_bins;
+
+    for(int h = 0; h < p.heading_bins; h++)
+    {
+        auto yaw0 = h*bin_width;
+        std::set<std::tuple<int, int, int>> seen_ends;  // (end cell, end heading) already covered
+
+        for(int i = 0; i < p.steer_levels; i++)
+        {
+            auto steer = p.steer_levels == 1 ? 0.0
+                         : p.max_steer*(2.0*i/(p.steer_levels - 1) - 1.0);
+            auto kappa = std::tan(steer)/p.car.wheelbase;
+
+            // Trim the arc so the end heading is exactly a bin
+            auto length = p.length;
+            if(std::fabs(kappa) > 1e-6)
+            {
+                auto turns = std::max(1.0, std::round(std::fabs(kappa)*p.length/bin_width));
+                length = turns*bin_width/std::fabs(kappa);
+            }
+
+            auto pose_at = [&](double sdist, double &x, double &y, double &yaw) {
+                yaw = yaw0 + kappa*sdist;
+                if(std::fabs(kappa) > 1e-6)
+                {
+                    x = (std::sin(yaw) - std::sin(yaw0))/kappa;
+                    y = (std::cos(yaw0) - std::cos(yaw))/kappa;
+                } else
+                {
+                    x = sdist*std::cos(yaw0);
+                    y = sdist*std::sin(yaw0);
+                }
+            };
+
+            double ex, ey, eyaw;
+            pose_at(length, ex, ey, eyaw);
+            auto dx = (int)std::lround(ex/p.resolution), dy = (int)std::lround(ey/p.resolution);
+            auto end_h = ((int)std::lround(eyaw/bin_width) % p.heading_bins + p.heading_bins) % p.heading_bins;
+            if(!seen_ends.emplace(dx, dy, end_h).second || (dx == 0 && dy == 0))
+                continue;
+
+            lattice_planner::primitive prim;
+            prim.start_heading = h;
+            prim.end_heading = end_h;
+            prim.dx = dx;
+            prim.dy = dy;
+            prim.length = length;
+            prim.steer = steer;
+
+            std::set<std::pair<int, int>> swept;
+            auto n_steps = (int)std::ceil(length/(p.resolution/2.0));
+            for(int k = 0; k <= n_steps; k++)
+            {
+                double x, y, yaw;
+                pose_at(length*k/n_steps, x, y, yaw);
+                footprint_cells(p, x, y, yaw, swept);
+            }
+            prim.first_cell = cells.size();
+            prim.num_cells = swept.size();
+            for(const auto &c : swept)
+                cells.push_back({(int16_t)c.second, (int16_t)c.first});
+
+            prim.first_pose = poses.size();
+            auto n_poses = std::max(2, (int)std::ceil(length/p.resolution) + 1);
+            for(int k = 0; k < n_poses; k++)
+            {
+                double x, y, yaw;
+                pose_at(length*k/(n_poses - 1), x, y, yaw);
+                poses.push_back({(float)x, (float)y, (float)yaw});
+            }
+            prim.num_poses = n_poses;
+            prims.push_back(prim);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "generate_primitives");
+    ros::NodeHandle n("~");
+
+    generator_params p;
+    std::string file;
+    n.param("wheelbase", p.car.wheelbase, 0.3302);
+    n.param("width", p.car.width, 0.2032);
+    n.param("max_steering_angle", p.max_steer, 0.4189);
+    n.param("lattice_resolution", p.resolution, 0.1);
+    n.param("lattice_heading_bins", p.heading_bins, 16);
+    n.param("lattice_steer_levels", p.steer_levels, 5);
+    n.param("lattice_primitive_length", p.length, 1.0);
+    n.param("lattice_footprint_margin", p.margin, 0.1);
+    n.param<std::string>("lattice_primitive_file", file, "primitives.latp");
+    p.heading_bins = std::max(p.heading_bins, 1);
+    p.steer_levels = std::max(p.steer_levels, 1);
+
+    std::vector<lattice_planner::primitive> prims;
+    std::vector<lattice_planner::cell_offset> cells;
+    std::vector<lattice_planner::pose> poses;
+    generate(p, prims, cells, poses);
+
+    if(!lattice_planner::PrimitiveSet::write(file, p.heading_bins, p.resolution,
+                                             p.car.wheelbase, p.max_steer, prims, cells, poses))
+    {
+        ROS_ERROR("Couldn't write primitive set to %s", file.c_str());
+        return 1;
+    }
+    ROS_INFO("Wrote %zu primitives (%zu swept cells) to %s", prims.size(), cells.size(), file.c_str());
+    return 0;
+}
@@ -0,0 +1,195 @@
+/**
+ * @file lattice_planner.cpp
+ * @brief State lattice local planner on its own mux channel.
+ *
+ * Every scan is turned into an occupancy grid and searched with the
+ * precomputed primitive set (see generate_primitives.cpp). The first
+ * primitive's steering angle is driven and the whole plan is published on
+ * /lattice_path; replanning every scan makes it a receding horizon.
+ */
+
+#include <ros/ros.h>
+
+#include <ackermann_msgs/AckermannDriveStamped.h>
+#include <nav_msgs/Path.h>
+#include <std_msgs/Int32MultiArray.h>
+
+#include <lattice_planner/lattice_search.h>
+#include <lattice_planner/primitive_set.h>
+#include <race_common/laser_scan_view.h>
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+class LatticePlanner
+{
+    private:
+        ros::NodeHandle n;
+        ros::Publisher drive_pub, path_pub;
+        ros::Subscriber scan_sub, mux_sub;
+
+        std::string drive_topic;
+        int mux_idx;
+        bool active, always_on;
+        double speed, partial_speed;
+
+        lattice_planner::PrimitiveSet primitives;
+        std::unique_ptr<lattice_planner::LatticeSearch> search;
+        std::vector<const lattice_planner::primitive *> plan;
+        std::vector<lattice_planner::pose> poses;
+
+        // Rolling timing, reported every few seconds
+        double cycle_ms_sum, cycle_ms_max;
+        int cycles;
+
+    public:
+        LatticePlanner()
+            : n(ros::NodeHandle("~")), active(false),
+              cycle_ms_sum(0.0), cycle_ms_max(0.0), cycles(0)
+        {
+            std::string file;
+            n.param<std::string>("lattice_primitive_file", file, "primitives.latp");
+            if(!primitives.open(file))
+            {
+                ROS_ERROR("Couldn't load primitive set %s; generate it with "
+                          "`roslaunch lattice_planner generate_primitives.launch`", file.c_str());
+                exit(-1);
+            }
+
+            double wheelbase, max_steering_angle;
+            n.param("wheelbase", wheelbase, 0.3302);
+            n.param("max_steering_angle", max_steering_angle, 0.4189);
+            const auto &hdr = primitives.getHeader();
+            if(std::fabs(hdr.wheelbase - wheelbase) > 1e-3 || std::fabs(hdr.max_steer - max_steering_angle) > 1e-3)
+                ROS_WARN("Primitive set was generated for wheelbase %.4f, max steer %.4f; "
+                         "the car has %.4f, %.4f. Regenerate it.",
+                         hdr.wheelbase, hdr.max_steer, wheelbase, max_steering_angle);
+            ROS_INFO("Loaded %u primitives over %u headings at %.2f m",
+                     hdr.num_primitives, hdr.heading_bins, hdr.resolution);
+
+            // Primitives are in cells, so they only fit a grid of their own resolution
+            double resolution;
+            n.param("lattice_resolution", resolution, 0.1);
+            if(std::fabs(hdr.resolution - resolution) > 1e-6)
+            {
+                ROS_ERROR("Primitive set %s was generated at %.4f m per cell, the grid is at %.4f. "
+                          "Regenerate it.", file.c_str(), hdr.resolution, resolution);
+                exit(-1);
+            }
+
+            n.param("lattice_idx", mux_idx, 7);
+            n.param<std::string>("lattice_topic", drive_topic, "/lattice_drive");
+            n.param("lattice_always_on", always_on, false);
+            n.param("lattice_speed", speed, 2.0);
+            n.param("lattice_partial_speed", partial_speed, 0.5);
+
+            lattice_planner::search_params sp;
+            double back, front, side, lidar_x, near_radius, goal_dist, w_steer, w_switch, w_near;
+            n.param("lattice_grid_back", back, 1.0);
+            n.param("lattice_grid_front", front, 6.0);
+            n.param("lattice_grid_side", side, 4.0);
+            n.param("scan_distance_to_base_link", lidar_x, 0.275);
+            n.param("lattice_near_radius", near_radius, 0.3);
+            n.param("lattice_goal_dist", goal_dist, 4.0);
+            n.param("lattice_w_steer", w_steer, 0.5);
+            n.param("lattice_w_switch", w_switch, 1.0);
+            n.param("lattice_w_near", w_near, 0.05);
+            n.param("lattice_max_expansions", sp.max_expansions, 3000);
+            sp.resolution = resolution;
+            sp.back = back;
+            sp.front = front;
+            sp.side = side;
+            sp.lidar_x = lidar_x;
+            sp.near_radius = near_radius;
+            sp.goal_dist = std::min(goal_dist, std::min(front, side));
+            sp.w_steer = w_steer;
+            sp.w_switch = w_switch;
+            sp.w_near = w_near;
+            search.reset(new lattice_planner::LatticeSearch(primitives, sp));
+
+            // pubs
+            drive_pub = n.advertise<ackermann_msgs::AckermannDriveStamped>(drive_topic, 1);
+            path_pub = n.advertise<nav_msgs::Path>("/lattice_path", 1);
+
+            // subs
+            scan_sub = n.subscribe("/scan", 1, &LatticePlanner::scan_cb, this);
+            mux_sub = n.subscribe("/mux", 1, &LatticePlanner::mux_cb, this);
+        }
+
+        void mux_cb(const std_msgs::Int32MultiArray &msg)
+        {
+            if(mux_idx >= 0 && mux_idx < (int)msg.data.size())
+                active = msg.data[mux_idx];
+        }
+
+        void scan_cb(const race_common::LaserScanView &msg)
+        {
+            if(!(active || always_on))
+                return;
+
+            auto start = std::chrono::steady_clock::now();
+            search->build(msg);
+            auto reached = search->plan(plan);
+            auto ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+
+            // A partial plan still avoids what we can see, just slower;
+            // no plan at all means every primitive is blocked
+            ackermann_msgs::AckermannDriveStamped drive;
+            drive.header.stamp = msg.header.stamp;
+            drive.header.frame_id = "base_link";
+            if(plan.empty())
+            {
+                drive.drive.speed = 0.0;
+                ROS_WARN_THROTTLE(1.0, "Lattice planner: no collision free primitive, stopping.");
+            } else
+            {
+                drive.drive.steering_angle = plan.front()->steer;
+                drive.drive.speed = reached ? speed : partial_speed;
+            }
+            drive_pub.publish(drive);
+
+            if(path_pub.getNumSubscribers() > 0)
+                publish_path(msg.header.stamp);
+
+            cycle_ms_sum += ms;
+            cycle_ms_max = std::max(cycle_ms_max, ms);
+            if(++cycles == 200)
+            {
+                ROS_INFO("Lattice cycle: mean %.2f ms, max %.2f ms (%d expansions last)",
+                         cycle_ms_sum/cycles, cycle_ms_max, search->getExpansions());
+                cycle_ms_sum = cycle_ms_max = 0.0;
+                cycles = 0;
+            }
+        }
+
+        void publish_path(const ros::Time &stamp)
+        {
+            search->trace(plan, poses);
+
+            nav_msgs::Path path;
+            path.header.stamp = stamp;
+            path.header.frame_id = "base_link";
+            path.poses.resize(poses.size());
+            for(size_t i = 0; i < poses.size(); i++)
+            {
+                auto &ps = path.poses[i];
+                ps.header = path.header;
+                ps.pose.position.x = poses[i].x;
+                ps.pose.position.y = poses[i].y;
+                ps.pose.orientation.z = std::sin(poses[i].yaw/2.0);
+                ps.pose.orientation.w = std::cos(poses[i].yaw/2.0);
+            }
+            path_pub.publish(path);
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "lattice_planner");
+    LatticePlanner l;
+    ros::spin();
+    return 0;
+}
@@ -0,0 +1,278 @@
+/**
+ * @file qnet.h
+ * @brief int8 inference for small 1D-conv / fully connected networks.
+ *
+ * Activations are channels-last ([position][channel]), so a conv window
+ * is a contiguous run of `kernel*in_ch` values and a dense layer is just
+ * a conv whose kernel covers the whole input. Every layer is therefore
+ * the same operation: for each output position and channel, an int8 dot
+ * product between the window and the channel's weight row, accumulated in
+ * int32 and rescaled to float by in_scale*weight_scale[channel].
+ *
+ * Weight rows are zero padded to a multiple of 32 so the SIMD dot product
+ * has no tail; the window read past its end is multiplied by those zeros.
+ * Weights are symmetric per output channel, activations per tensor with
+ * the scale picked offline from calibration data (see
+ * scripts/export_qnet.py). Hidden activations are requantized to int8
+ * right away; the last layer's output stays float.
+ *
+ * All buffers are sized when the file is loaded: two ping-pong int8
+ * activation buffers with 32 bytes of slack for the padded reads. infer()
+ * allocates nothing.
+ */
+#pragma once
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace learned_policy
+{
+
+enum activation : uint32_t
+{
+    ACT_NONE = 0,
+    ACT_RELU = 1,
+    ACT_TANH = 2,
+};
+
+struct qnet_header
+{
+    char magic[4];              // "QNET"
+    uint32_t version;
+    uint32_t num_layers;
+    uint32_t input_len;         // positions (beams) the network expects
+    float input_clip;           // ranges are clipped to this and divided by it
+    uint32_t output_len;
+};
+
+// Followed in the file by int8 weights[out_ch][row], float weight_scale[out_ch], float bias[out_ch]
+struct qnet_layer
+{
+    uint32_t in_len, in_ch;
+    uint32_t out_len, out_ch;
+    uint32_t kernel, stride;
+    uint32_t row;               // kernel*in_ch rounded up to 32
+    uint32_t act;
+    float in_scale;             // float = int8*in_scale for this layer's input
+};
+
+// int8 dot product over `n` bytes, `n` a multiple of 32
+inline int32_t dot_i8(const int8_t *a, const int8_t *b, uint32_t n)
+{
+#if defined(__AVX2__)
+    // maddubs wants one unsigned operand: |a| * (b with a's sign). Pairs
+    // stay below 2*127*127, so the int16 sums never saturate.
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+    for(uint32_t i = 0; i < n; i += 32)
+    {
+        auto va = _mm256_loadu_si256((const __m256i *)(a + i));
+        auto vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        auto prod = _mm256_maddubs_epi16(_mm256_abs_epi8(va), _mm256_sign_epi8(vb, va));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(prod, ones));
+    }
+    auto s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_hadd_epi32(s, s);
+    s = _mm_hadd_epi32(s, s);
+    return _mm_cvtsi128_si32(s);
+#elif defined(__ARM_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    for(uint32_t i = 0; i < n; i += 16)
+    {
+        auto va = vld1q_s8(a + i), vb = vld1q_s8(b + i);
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        acc = vpadalq_s16(acc, vmull_s8(vget_high_s8(va), vget_high_s8(vb)));
+    }
+    return vgetq_lane_s32(acc, 0) + vgetq_lane_s32(acc, 1) + vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3);
+#else
+    int32_t acc = 0;
+    for(uint32_t i = 0; i < n; i++)
+        acc += (int32_t)a[i]*b[i];
+    return acc;
+#endif
+}
+
+class QNet
+{
+    private:
+        static constexpr uint32_t SLACK = 32;
+
+        struct layer
+        {
+            qnet_layer desc;
+            std::vector<int8_t> weights;
+            std::vector<float> scale, bias;   // scale already multiplied by in_scale
+            float out_inv_scale;              // 1/next layer's in_scale
+        };
+
+        qnet_header header;
+        std::vector<layer> layers;
+        std::vector<int8_t> buf_a, buf_b;
+
+        static float activate(float y, uint32_t act)
+        {
+            switch(act)
+            {
+                case ACT_RELU: return std::max(y, 0.0f);
+                case ACT_TANH: return std::tanh(y);
+                default: return y;
+            }
+        }
+
+        static int8_t quantize(float y, float inv_scale)
+        {
+            auto q = std::lround(y*inv_scale);
+            return (int8_t)std::min(std::max(q, -127l), 127l);
+        }
+
+        static bool check(const qnet_layer &l, uint32_t in_len, uint32_t in_ch)
+        {
+            return l.in_len == in_len && l.in_ch == in_ch && l.kernel > 0 && l.stride > 0 &&
+                   l.in_len >= l.kernel && l.out_len == (l.in_len - l.kernel)/l.stride + 1 &&
+                   l.row >= l.kernel*l.in_ch && l.row % 32 == 0 && l.out_ch > 0 &&
+                   l.act <= ACT_TANH && l.in_scale > 0.0f;
+        }
+
+    public:
+        static constexpr uint32_t VERSION = 1;
+
+        QNet()
+        {
+            std::memset(&header, 0, sizeof(header));
+        }
+
+        bool open(const std::string &path)
+        {
+            layers.clear();
+            FILE *f = std::fopen(path.c_str(), "rb");
+            if(f == nullptr)
+                return false;
+
+            auto ok = std::fread(&header, sizeof(header), 1, f) == 1 &&
+                      std::memcmp(header.magic, "QNET", 4) == 0 && header.version == VERSION &&
+                      header.num_layers > 0 && header.input_clip > 0.0f;
+
+            uint32_t len = header.input_len, ch = 1;
+            size_t largest = len;
+            for(uint32_t i = 0; ok && i < header.num_layers; i++)
+            {
+                layer l;
+                ok = std::fread(&l.desc, sizeof(l.desc), 1, f) == 1 && check(l.desc, len, ch);
+                if(!ok)
+                    break;
+
+                l.weights.resize((size_t)l.desc.out_ch*l.desc.row);
+                l.scale.resize(l.desc.out_ch);
+                l.bias.resize(l.desc.out_ch);
+                ok = std::fread(l.weights.data(), 1, l.weights.size(), f) == l.weights.size() &&
+                     std::fread(l.scale.data(), sizeof(float), l.scale.size(), f) == l.scale.size() &&
+                     std::fread(l.bias.data(), sizeof(float), l.bias.size(), f) == l.bias.size();
+                for(auto &s : l.scale)
+                    s *= l.desc.in_scale;
+
+                len = l.desc.out_len;
+                ch = l.desc.out_ch;
+                largest = std::max(largest, (size_t)len*ch);
+                layers.push_back(std::move(l));
+            }
+            std::fclose(f);
+
+            ok = ok && (size_t)len*ch == header.output_len;
+            if(!ok)
+            {
+                layers.clear();
+                return false;
+            }
+
+            for(size_t i = 0; i + 1 < layers.size(); i++)
+                layers[i].out_inv_scale = 1.0f/layers[i + 1].desc.in_scale;
+            buf_a.assign(largest + SLACK, 0);
+            buf_b.assign(largest + SLACK, 0);
+            return true;
+        }
+
+        /**
+         * @brief Write a network in the format `open` expects. `weights[i]`
+         *          must already be padded to `layers[i].row`.
+         */
+        static bool write(const std::string &path, const qnet_header &hdr,
+                          const std::vector<qnet_layer> &layers,
+                          const std::vector<std::vector<int8_t>> &weights,
+                          const std::vector<std::vector<float>> &scales,
+                          const std::vector<std::vector<float>> &biases)
+        {
+            FILE *f = std::fopen(path.c_str(), "wb");
+            if(f == nullptr)
+                return false;
+            auto ok = std::fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+            for(size_t i = 0; ok && i < layers.size(); i++)
+                ok = std::fwrite(&layers[i], sizeof(qnet_layer), 1, f) == 1 &&
+                     std::fwrite(weights[i].data(), 1, weights[i].size(), f) == weights[i].size() &&
+                     std::fwrite(scales[i].data(), sizeof(float), scales[i].size(), f) == scales[i].size() &&
+                     std::fwrite(biases[i].data(), sizeof(float), biases[i].size(), f) == biases[i].size();
+            return std::fclose(f) == 0 && ok;
+        }
+
+        bool loaded() const
+        {
+            return !layers.empty();
+        }
+
+        const qnet_header &getHeader() const
+        {
+            return header;
+        }
+
+        /**
+         * @brief Run the network on `ranges` (input_len of them; NaN, inf
+         *          and anything past input_clip count as input_clip).
+         *
+         * @param out   output_len floats
+         */
+        void infer(const float *ranges, float *out)
+        {
+            // Input layer: ranges normalized to [0, 1], then quantized
+            auto inv = 1.0f/(header.input_clip*layers[0].desc.in_scale);
+            for(uint32_t i = 0; i < header.input_len; i++)
+            {
+                auto r = ranges[i];
+                r = r >= 0.0f && r < header.input_clip ? r : header.input_clip;
+                buf_a[i] = quantize(r, inv);
+            }
+
+            auto *in = buf_a.data(), *next = buf_b.data();
+            for(size_t li = 0; li < layers.size(); li++)
+            {
+                const auto &l = layers[li];
+                const auto &d = l.desc;
+                auto last = li + 1 == layers.size();
+                for(uint32_t p = 0; p < d.out_len; p++)
+                {
+                    auto window = in + (size_t)p*d.stride*d.in_ch;
+                    for(uint32_t o = 0; o < d.out_ch; o++)
+                    {
+                        auto acc = dot_i8(window, &l.weights[(size_t)o*d.row], d.row);
+                        auto y = activate(acc*l.scale[o] + l.bias[o], d.act);
+                        if(last)
+                            out[p*d.out_ch + o] = y;
+                        else
+                            next[p*d.out_ch + o] = quantize(y, l.out_inv_scale);
+                    }
+                }
+                std::swap(in, next);
+            }
+        }
+};
+
+} // namespace learned_policy
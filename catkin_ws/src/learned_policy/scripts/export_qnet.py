@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Quantizes a trained float policy into the .qnet file learned_policy loads.
+
+The input is an .npz with, for layer i = 0, 1, ...:
+  w<i>       Conv1d weights (out_ch, in_ch, kernel) or Linear weights (out, in),
+             in PyTorch's layout
+  b<i>       biases (out,)
+  stride<i>  conv stride (optional, default 1)
+  act<i>     "relu", "tanh" or "none" (optional, default "relu", last "tanh")
+and
+  max_range  ranges are clipped to this and divided by it before layer 0
+  beams      scan length (optional if calib is given)
+  calib      (optional) scans (N, beams) used to pick the activation scales
+
+The network's input is one channel of `beams` normalized ranges. A Linear
+layer after a conv sees the conv output flattened channel-major (PyTorch's
+flatten); its columns are reordered to the engine's channels-last layout.
+
+  rosrun learned_policy export_qnet.py policy.npz policy.qnet
+"""
+
+import struct
+import sys
+
+import numpy as np
+
+MAGIC = b"QNET"
+VERSION = 1
+ACTS = {"none": 0, "relu": 1, "tanh": 2}
+
+
+def activate(y, act):
+    if act == "relu":
+        return np.maximum(y, 0.0)
+    if act == "tanh":
+        return np.tanh(y)
+    return y
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: export_qnet.py policy.npz policy.qnet")
+    data = np.load(sys.argv[1])
+    max_range = float(data["max_range"])
+    n_layers = len([k for k in data.files if k.startswith("w")])
+
+    # Layers as (weights [out][kernel*in_ch] channels-last, bias, kernel, stride, act)
+    layers = []
+    length, ch = None, 1
+    calib = data["calib"] if "calib" in data.files else None
+    beams = int(data["beams"]) if "beams" in data.files else (calib.shape[1] if calib is not None else None)
+    for i in range(n_layers):
+        w = data["w%d" % i].astype(np.float32)
+        act = str(data["act%d" % i]) if "act%d" % i in data.files else ("tanh" if i == n_layers - 1 else "relu")
+        if w.ndim == 3:
+            out_ch, in_ch, kernel = w.shape
+            assert in_ch == ch, "layer %d expects %d channels, gets %d" % (i, in_ch, ch)
+            stride = int(data["stride%d" % i]) if "stride%d" % i in data.files else 1
+            w = w.transpose(0, 2, 1).reshape(out_ch, kernel * in_ch)
+        else:
+            out_ch, n_in = w.shape
+            if length is None:
+                length = n_in // ch
+            assert n_in == length * ch, "layer %d expects %d inputs, gets %d" % (i, n_in, length * ch)
+            w = w.reshape(out_ch, ch, length).transpose(0, 2, 1).reshape(out_ch, n_in)
+            kernel, stride = length, 1
+        if length is None:
+            length = beams
+        assert length is not None, "a conv first layer needs beams or calib"
+        layers.append([w, data["b%d" % i].astype(np.float32), kernel, stride, act, length, ch])
+        length = (length - kernel) // stride + 1
+        ch = out_ch
+
+    # Float forward pass over the calibration scans for the activation ranges
+    x = np.clip(np.nan_to_num(calib, nan=max_range, posinf=max_range), 0, max_range) / max_range \
+        if calib is not None else None
+    in_scales = [1.0 / 127.0]
+    for w, b, kernel, stride, act, in_len, in_ch in layers:
+        if x is None:
+            break
+        x = x.reshape(x.shape[0], -1)
+        out_len = (in_len - kernel) // stride + 1
+        idx = (np.arange(out_len)[:, None] * stride * in_ch + np.arange(kernel * in_ch)[None, :])
+        y = activate(np.einsum("npk,ok->npo", x[:, idx], w) + b, act)
+        in_scales.append(max(np.percentile(np.abs(y), 99.9), 1e-6) / 127.0)
+        x = y
+    if len(in_scales) < len(layers):
+        print("no calib scans; assuming hidden activations within [-4, 4]")
+        in_scales += [4.0 / 127.0] * (len(layers) - len(in_scales))
+
+    out_len, out_ch = layers[-1][5], layers[-1][0].shape[0]
+    out_len = (out_len - layers[-1][2]) // layers[-1][3] + 1
+    with open(sys.argv[2], "wb") as f:
+        f.write(struct.pack("<4sIIIfI", MAGIC, VERSION, len(layers), layers[0][5], max_range, out_len * out_ch))
+        for i, (w, b, kernel, stride, act, in_len, in_ch) in enumerate(layers):
+            n_out = w.shape[0]
+            row = (kernel * in_ch + 31) // 32 * 32
+            w_scale = np.maximum(np.abs(w).max(axis=1), 1e-8) / 127.0
+            q = np.zeros((n_out, row), np.int8)
+            q[:, :kernel * in_ch] = np.clip(np.round(w / w_scale[:, None]), -127, 127)
+            f.write(struct.pack("<8If", in_len, in_ch, (in_len - kernel) // stride + 1, n_out,
+                                kernel, stride, row, ACTS[act], in_scales[i]))
+            f.write(q.tobytes())
+            f.write(w_scale.astype("<f4").tobytes())
+            f.write(b.astype("<f4").tobytes())
+    print("wrote %d layers to %s" % (len(layers), sys.argv[2]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,120 @@
+/**
+ * @file learned_policy.cpp
+ * @brief Learned scan -> steering/speed policy on its own mux channel.
+ *
+ * Every scan goes through the int8 network from `policy_weights_file`
+ * (see qnet.h). The network has two tanh outputs in [-1, 1]: the first
+ * scales max_steering_angle, the second is mapped linearly onto
+ * [policy_min_speed, policy_max_speed].
+ */
+
+#include <ros/ros.h>
+
+#include <ackermann_msgs/AckermannDriveStamped.h>
+#include <std_msgs/Int32MultiArray.h>
+
+#include <learned_policy/qnet.h>
+#include <race_common/laser_scan_view.h>
+
+#include <chrono>
+#include <cmath>
+#include <string>
+
+class LearnedPolicy
+{
+    private:
+        ros::NodeHandle n;
+        ros::Publisher drive_pub;
+        ros::Subscriber scan_sub, mux_sub;
+
+        std::string drive_topic;
+        int mux_idx;
+        bool active, always_on;
+        double max_steering_angle, min_speed, max_speed;
+
+        learned_policy::QNet net;
+        float out[2];
+
+        // Rolling timing, reported every few seconds
+        double cycle_ms_sum, cycle_ms_max;
+        int cycles;
+
+    public:
+        LearnedPolicy()
+            : n(ros::NodeHandle("~")), active(false),
+              cycle_ms_sum(0.0), cycle_ms_max(0.0), cycles(0)
+        {
+            std::string file;
+            n.param<std::string>("policy_weights_file", file, "policy.qnet");
+            if(!net.open(file) || net.getHeader().output_len != 2)
+            {
+                ROS_ERROR("Couldn't load a two-output policy from %s; export one with "
+                          "learned_policy's scripts/export_qnet.py", file.c_str());
+                exit(-1);
+            }
+            ROS_INFO("Loaded policy: %u layers, %u beams in, ranges clipped at %.1f m",
+                     net.getHeader().num_layers, net.getHeader().input_len, net.getHeader().input_clip);
+
+            n.param("policy_idx", mux_idx, 8);
+            n.param<std::string>("policy_topic", drive_topic, "/policy_drive");
+            n.param("policy_always_on", always_on, false);
+            n.param("max_steering_angle", max_steering_angle, 0.4189);
+            n.param("policy_min_speed", min_speed, 0.5);
+            n.param("policy_max_speed", max_speed, 3.0);
+
+            // pubs
+            drive_pub = n.advertise<ackermann_msgs::AckermannDriveStamped>(drive_topic, 1);
+
+            // subs
+            scan_sub = n.subscribe("/scan", 1, &LearnedPolicy::scan_cb, this);
+            mux_sub = n.subscribe("/mux", 1, &LearnedPolicy::mux_cb, this);
+        }
+
+        void mux_cb(const std_msgs::Int32MultiArray &msg)
+        {
+            if(mux_idx >= 0 && mux_idx < (int)msg.data.size())
+                active = msg.data[mux_idx];
+        }
+
+        void scan_cb(const race_common::LaserScanView &msg)
+        {
+            if(!(active || always_on))
+                return;
+
+            if(msg.ranges.size() != net.getHeader().input_len)
+            {
+                ROS_ERROR_THROTTLE(1.0, "Policy expects %u beams, the scan has %zu; not driving.",
+                                   net.getHeader().input_len, msg.ranges.size());
+                return;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            net.infer(msg.ranges.data(), out);
+            auto ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+
+            ackermann_msgs::AckermannDriveStamped drive;
+            drive.header.stamp = msg.header.stamp;
+            drive.header.frame_id = "base_link";
+            drive.drive.steering_angle = out[0]*max_steering_angle;
+            drive.drive.speed = min_speed + 0.5*(out[1] + 1.0)*(max_speed - min_speed);
+            drive_pub.publish(drive);
+
+            cycle_ms_sum += ms;
+            cycle_ms_max = std::max(cycle_ms_max, ms);
+            if(++cycles == 200)
+            {
+                ROS_INFO("Policy inference: mean %.3f ms, max %.3f ms", cycle_ms_sum/cycles, cycle_ms_max);
+                cycle_ms_sum = cycle_ms_max = 0.0;
+                cycles = 0;
+            }
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "learned_policy");
+    LearnedPolicy l;
+    ros::spin();
+    return 0;
+}
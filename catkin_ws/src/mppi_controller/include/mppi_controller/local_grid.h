@@ -0,0 +1,112 @@
+/**
+ * @file local_grid.h
+ * @brief Egocentric obstacle cost grid built from one scan, for cheap
+ *          per-step cost lookups in the rollouts.
+ *
+ * Scan hits are rasterized around base_link into a CostmapInflation, which
+ * keeps every cell's exact distance to the nearest hit out to the
+ * influence distance, recomputing only around tiles whose hits changed
+ * since the last scan. Squared distances are whole cells, so the cost of
+ * each one is tabulated once and a rollout step costs two array reads.
+ */
+#pragma once
+
+#include <race_common/costmap_inflation.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace mppi
+{
+
+struct grid_params
+{
+    float resolution;       // meters per cell
+    float extent;           // half width of the square grid (m)
+    float lidar_x;          // lidar position ahead of base_link (m)
+    float collision_radius; // closer than this to a hit is a crash (m)
+    float influence;        // obstacles stop costing beyond this distance (m)
+    float w_obstacle, w_collision;
+};
+
+class LocalGrid
+{
+    private:
+        grid_params p;
+        int size;
+        float inv_res;
+        race_common::CostmapInflation inflation;
+        std::vector<float> cost_of_d2;  // by squared distance in cells
+
+        // Trig cache, rebuilt only if the scan layout changes
+        std::vector<float> cos_table, sin_table;
+        float cached_min, cached_inc;
+
+        template <typename Scan>
+        void update_trig(const Scan &msg)
+        {
+            if(cos_table.size() == msg.ranges.size() &&
+               cached_min == msg.angle_min && cached_inc == msg.angle_increment)
+                return;
+
+            cos_table.resize(msg.ranges.size());
+            sin_table.resize(msg.ranges.size());
+            for(size_t i = 0; i < msg.ranges.size(); i++)
+            {
+                cos_table[i] = std::cos(msg.angle_min + i*msg.angle_increment);
+                sin_table[i] = std::sin(msg.angle_min + i*msg.angle_increment);
+            }
+            cached_min = msg.angle_min;
+            cached_inc = msg.angle_increment;
+        }
+
+    public:
+        explicit LocalGrid(const grid_params &p)
+            : p(p), size(2*(int)std::ceil(p.extent/p.resolution)), inv_res(1.0f/p.resolution),
+              inflation(size, size, (int)std::ceil(p.influence/p.resolution)),
+              cached_min(0.0f), cached_inc(0.0f)
+        {
+            // Distance -> cost, once per possible distance instead of once per rollout step
+            const auto inv_influence = 1.0f/(p.influence - p.collision_radius);
+            cost_of_d2.resize(inflation.far() + 1);
+            for(size_t d2 = 0; d2 < cost_of_d2.size(); d2++)
+            {
+                auto d = std::sqrt((float)d2)*p.resolution;
+                auto t = std::max(0.0f, 1.0f - (d - p.collision_radius)*inv_influence);
+                cost_of_d2[d2] = d < p.collision_radius ? p.w_collision : p.w_obstacle*t*t;
+            }
+            cost_of_d2[inflation.far()] = 0.0f;
+        }
+
+        template <typename Scan>
+        void build(const Scan &msg)
+        {
+            update_trig(msg);
+
+            inflation.clear();
+            for(size_t i = 0; i < msg.ranges.size(); i++)
+            {
+                auto r = msg.ranges[i];
+                if(!(r >= msg.range_min && r <= msg.range_max))
+                    continue;
+                auto gx = (int)std::floor((p.lidar_x + r*cos_table[i] + p.extent)*inv_res);
+                auto gy = (int)std::floor((r*sin_table[i] + p.extent)*inv_res);
+                if(gx >= 0 && gy >= 0 && gx < size && gy < size)
+                    inflation.mark(gx, gy);
+            }
+            inflation.update();
+        }
+
+        // Off the grid is unknown; treat it as free
+        float lookup(float x, float y) const
+        {
+            auto gx = (int)((x + p.extent)*inv_res);
+            auto gy = (int)((y + p.extent)*inv_res);
+            if(gx < 0 || gy < 0 || gx >= size || gy >= size)
+                return 0.0f;
+            return cost_of_d2[inflation.data()[gy*size + gx]];
+        }
+};
+
+} // namespace mppi
@@ -0,0 +1,240 @@
+/**
+ * @file mppi.h
+ * @brief Model predictive path integral controller over a kinematic
+ *          bicycle model, scored against a LocalGrid.
+ *
+ * Every cycle K perturbed control sequences are rolled out from the car's
+ * current state in base_link and weighted by exp(-cost/lambda); the
+ * nominal sequence moves towards the weighted mean and is shifted one step
+ * for the next cycle.
+ *
+ * Rollout state is kept as structure-of-arrays indexed by sample and noise
+ * as [t*K + k], so the inner loop of every time step runs over contiguous
+ * samples and vectorizes. Heading is carried as a (cos, sin) pair rotated
+ * by a short polynomial, which keeps libm calls out of that loop. Samples
+ * are split into chunks that run on a race_common::ThreadPool.
+ */
+#pragma once
+
+#include <mppi_controller/local_grid.h>
+#include <race_common/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace mppi
+{
+
+struct mppi_params
+{
+    int samples, horizon;
+    float dt;
+    float lambda;               // temperature: lower trusts the best rollouts more
+    float gamma;                // weight of the control cost term, 0..lambda
+    float steer_sigma, speed_sigma;
+    float wheelbase, max_steer;
+    float min_speed, max_speed;
+    float speed_tau;            // first order lag from speed command to speed (s)
+    float w_progress;           // reward per meter travelled along the start heading
+};
+
+struct control
+{
+    float steer, speed;
+};
+
+class MPPI
+{
+    private:
+        mppi_params p;
+        race_common::ThreadPool pool;
+        int chunk_size, n_chunks;
+        std::vector<std::mt19937> rngs;     // one per chunk, no shared state
+
+        std::vector<float> steer_nom, speed_nom;    // [t]
+        std::vector<float> steer_eps, speed_eps;    // [t*K + k]
+        std::vector<float> x, y, c, s, v, cost;     // [k]
+        std::vector<float> weight;                  // [k]
+
+        // Short Taylor series; the per-step arguments stay well inside their range
+        static inline float poly_tan(float a)
+        {
+            auto a2 = a*a;
+            return a*(1.0f + a2*(1.0f/3.0f + a2*(2.0f/15.0f + a2*(17.0f/315.0f))));
+        }
+
+        static inline float poly_sin(float a)
+        {
+            auto a2 = a*a;
+            return a*(1.0f - a2*(1.0f/6.0f - a2*(1.0f/120.0f)));
+        }
+
+        static inline float poly_cos(float a)
+        {
+            auto a2 = a*a;
+            return 1.0f - a2*(0.5f - a2*(1.0f/24.0f));
+        }
+
+        void sample_noise(int k0, int k1, std::mt19937 &rng)
+        {
+            const int K = p.samples;
+            std::normal_distribution<float> steer_dist(0.0f, p.steer_sigma);
+            std::normal_distribution<float> speed_dist(0.0f, p.speed_sigma);
+            for(int t = 0; t < p.horizon; t++)
+            {
+                auto se = &steer_eps[t*K], ve = &speed_eps[t*K];
+                for(int k = k0; k < k1; k++)
+                {
+                    se[k] = steer_dist(rng);
+                    ve[k] = speed_dist(rng);
+                }
+            }
+
+            // Sample 0 replays the nominal sequence unperturbed
+            if(k0 == 0)
+                for(int t = 0; t < p.horizon; t++)
+                    steer_eps[t*K] = speed_eps[t*K] = 0.0f;
+        }
+
+        void rollout(int k0, int k1, const LocalGrid &grid, float v0)
+        {
+            const int K = p.samples;
+            const float dt = p.dt, inv_L = 1.0f/p.wheelbase;
+            const float lag = std::min(1.0f, dt/std::max(p.speed_tau, 1e-3f));
+            const float inv_var_steer = 1.0f/(p.steer_sigma*p.steer_sigma);
+            const float inv_var_speed = 1.0f/(p.speed_sigma*p.speed_sigma);
+
+            auto px = x.data(), py = y.data(), pc = c.data(), ps = s.data(),
+                 pv = v.data(), pcost = cost.data();
+            for(int k = k0; k < k1; k++)
+            {
+                px[k] = py[k] = ps[k] = pcost[k] = 0.0f;
+                pc[k] = 1.0f;
+                pv[k] = v0;
+            }
+
+            for(int t = 0; t < p.horizon; t++)
+            {
+                auto se = &steer_eps[t*K], ve = &speed_eps[t*K];
+                const float sn = steer_nom[t], vn = speed_nom[t];
+                const float ctrl_steer = p.gamma*sn*inv_var_steer;
+                const float ctrl_speed = p.gamma*vn*inv_var_speed;
+
+                // Dynamics and control cost: straight-line code over samples
+                for(int k = k0; k < k1; k++)
+                {
+                    // Store the applied (clamped) perturbation, so the update
+                    // only moves the nominal towards feasible controls
+                    auto delta = std::min(std::max(sn + se[k], -p.max_steer), p.max_steer);
+                    auto cmd = std::min(std::max(vn + ve[k], p.min_speed), p.max_speed);
+                    se[k] = delta - sn;
+                    ve[k] = cmd - vn;
+
+                    auto vel = pv[k] + (cmd - pv[k])*lag;
+                    auto dyaw = vel*poly_tan(delta)*inv_L*dt;
+                    auto dc = poly_cos(dyaw), ds = poly_sin(dyaw);
+                    auto nc = pc[k]*dc - ps[k]*ds;
+                    auto ns = ps[k]*dc + pc[k]*ds;
+
+                    px[k] += vel*nc*dt;
+                    py[k] += vel*ns*dt;
+                    pc[k] = nc;
+                    ps[k] = ns;
+                    pv[k] = vel;
+                    pcost[k] += ctrl_steer*se[k] + ctrl_speed*ve[k] - p.w_progress*vel*nc*dt;
+                }
+
+                // Obstacle cost is a gather, kept out of the loop above
+                for(int k = k0; k < k1; k++)
+                    pcost[k] += grid.lookup(px[k], py[k]);
+            }
+        }
+
+    public:
+        MPPI(const mppi_params &p, int threads, unsigned seed = 0)
+            : p(p), pool(threads)
+        {
+            // A few chunks per thread evens out the load; multiples of 16
+            // keep each chunk's slice of the arrays vector aligned
+            n_chunks = std::max(1, std::min(pool.size()*4, p.samples/64));
+            chunk_size = ((p.samples + n_chunks - 1)/n_chunks + 15)/16*16;
+            n_chunks = (p.samples + chunk_size - 1)/chunk_size;
+
+            std::seed_seq seq{seed};
+            std::vector<unsigned> seeds(n_chunks);
+            seq.generate(seeds.begin(), seeds.end());
+            for(auto sd : seeds)
+                rngs.emplace_back(sd);
+
+            steer_nom.assign(p.horizon, 0.0f);
+            speed_nom.assign(p.horizon, p.min_speed);
+            steer_eps.resize(p.horizon*p.samples);
+            speed_eps.resize(p.horizon*p.samples);
+            for(auto vec : {&x, &y, &c, &s, &v, &cost, &weight})
+                vec->resize(p.samples);
+        }
+
+        /**
+         * @brief Run one optimization cycle from the origin of `grid`'s frame.
+         *
+         * @param v0  current forward speed (m/s)
+         * @return    control to apply now; the nominal is then shifted a step
+         */
+        control compute(const LocalGrid &grid, float v0)
+        {
+            const int K = p.samples;
+            pool.run(n_chunks, [&](int chunk)
+            {
+                auto k0 = chunk*chunk_size, k1 = std::min(K, k0 + chunk_size);
+                sample_noise(k0, k1, rngs[chunk]);
+                rollout(k0, k1, grid, v0);
+            });
+
+            auto best = *std::min_element(cost.begin(), cost.end());
+            float total = 0.0f;
+            for(int k = 0; k < K; k++)
+            {
+                weight[k] = std::exp(-(cost[k] - best)/p.lambda);
+                total += weight[k];
+            }
+            auto inv_total = 1.0f/total;
+
+            for(int t = 0; t < p.horizon; t++)
+            {
+                auto se = &steer_eps[t*K], ve = &speed_eps[t*K];
+                float ds = 0.0f, dv = 0.0f;
+                for(int k = 0; k < K; k++)
+                {
+                    ds += weight[k]*se[k];
+                    dv += weight[k]*ve[k];
+                }
+                steer_nom[t] += ds*inv_total;
+                speed_nom[t] += dv*inv_total;
+            }
+
+            control out{steer_nom[0], speed_nom[0]};
+
+            // Warm start: shift by one step, repeat the last control
+            std::rotate(steer_nom.begin(), steer_nom.begin() + 1, steer_nom.end());
+            std::rotate(speed_nom.begin(), speed_nom.begin() + 1, speed_nom.end());
+            steer_nom.back() = steer_nom[std::max(p.horizon - 2, 0)];
+            speed_nom.back() = speed_nom[std::max(p.horizon - 2, 0)];
+            return out;
+        }
+
+        // Forget the warm start, e.g. after the controller was switched out
+        void reset()
+        {
+            std::fill(steer_nom.begin(), steer_nom.end(), 0.0f);
+            std::fill(speed_nom.begin(), speed_nom.end(), p.min_speed);
+        }
+
+        int threads() const
+        {
+            return pool.size();
+        }
+};
+
+} // namespace mppi
@@ -0,0 +1,195 @@
+/**
+ * @file mppi_controller.cpp
+ * @brief Sampling based (MPPI) local controller on its own mux channel.
+ *
+ * Each scan is rasterized into an egocentric LocalGrid; a timer at
+ * `mppi_rate` runs one MPPI cycle against the latest grid and the odometry
+ * speed and publishes the first control. Scan and timer callbacks share
+ * the single spinner thread, so the grid is never rebuilt mid-cycle; the
+ * rollouts themselves fan out on the MPPI's thread pool.
+ */
+
+#include <ros/ros.h>
+
+#include <ackermann_msgs/AckermannDriveStamped.h>
+#include <nav_msgs/Odometry.h>
+#include <std_msgs/Int32MultiArray.h>
+
+#include <mppi_controller/local_grid.h>
+#include <mppi_controller/mppi.h>
+#include <race_common/laser_scan_view.h>
+#include <race_common/velocity_input.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+class MPPIController
+{
+    private:
+        ros::NodeHandle n;
+        ros::Publisher drive_pub;
+        ros::Subscriber scan_sub, mux_sub, odom_sub, velocity_sub;
+        ros::Timer timer;
+
+        std::string drive_topic;
+        int mux_idx;
+        bool active, always_on, have_scan;
+        double speed;
+        race_common::VelocityInput velocity;
+
+        std::unique_ptr<mppi::LocalGrid> grid;
+        std::unique_ptr<mppi::MPPI> mppi;
+
+        // Rolling timing, reported every few seconds
+        double cycle_ms_sum, cycle_ms_max;
+        int cycles;
+
+    public:
+        MPPIController()
+            : n(ros::NodeHandle("~")), active(false), have_scan(false), speed(0.0),
+              cycle_ms_sum(0.0), cycle_ms_max(0.0), cycles(0)
+        {
+            n.param("mppi_idx", mux_idx, 6);
+            n.param<std::string>("mppi_topic", drive_topic, "/mppi_drive");
+            n.param("mppi_always_on", always_on, false);
+
+            double scan_distance_to_base_link, wheelbase, width, max_steering_angle, max_speed;
+            n.param("scan_distance_to_base_link", scan_distance_to_base_link, 0.275);
+            n.param("width", width, 0.2032);
+            n.param("wheelbase", wheelbase, 0.3302);
+            n.param("max_steering_angle", max_steering_angle, 0.4189);
+            n.param("max_speed", max_speed, 7.0);
+
+            mppi::grid_params gp;
+            double resolution, extent, margin, influence, w_obstacle, w_collision;
+            n.param("mppi_grid_resolution", resolution, 0.1);
+            n.param("mppi_grid_extent", extent, 12.0);
+            n.param("mppi_inflation_margin", margin, 0.2);
+            n.param("mppi_obstacle_influence", influence, 1.0);
+            n.param("mppi_w_obstacle", w_obstacle, 5.0);
+            n.param("mppi_w_collision", w_collision, 1000.0);
+            gp.resolution = resolution;
+            gp.extent = extent;
+            gp.lidar_x = scan_distance_to_base_link;
+            // Rollouts are points at base_link, so obstacles are inflated by half the car
+            gp.collision_radius = 0.5*width + margin;
+            gp.influence = std::max(influence, gp.collision_radius + resolution);
+            gp.w_obstacle = w_obstacle;
+            gp.w_collision = w_collision;
+            grid.reset(new mppi::LocalGrid(gp));
+
+            mppi::mppi_params mp;
+            double rate, lambda, control_weight, steer_sigma, speed_sigma, min_speed, top_speed, speed_tau, w_progress;
+            int threads;
+            n.param("mppi_rate", rate, 40.0);
+            n.param("mppi_samples", mp.samples, 2000);
+            n.param("mppi_horizon", mp.horizon, 30);
+            n.param("mppi_lambda", lambda, 0.3);
+            n.param("mppi_control_weight", control_weight, 0.1);
+            n.param("mppi_steer_sigma", steer_sigma, 0.15);
+            n.param("mppi_speed_sigma", speed_sigma, 1.0);
+            n.param("mppi_min_speed", min_speed, 0.5);
+            n.param("mppi_max_speed", top_speed, 4.0);
+            n.param("mppi_speed_tau", speed_tau, 0.2);
+            n.param("mppi_w_progress", w_progress, 10.0);
+            n.param("mppi_threads", threads, -1);
+            if(threads < 0)
+                threads = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+
+            mp.samples = std::max(mp.samples, 1);
+            mp.horizon = std::max(mp.horizon, 1);
+            mp.dt = 1.0/rate;
+            mp.lambda = lambda;
+            mp.gamma = lambda*std::min(std::max(control_weight, 0.0), 1.0);
+            mp.steer_sigma = steer_sigma;
+            mp.speed_sigma = speed_sigma;
+            mp.wheelbase = wheelbase;
+            mp.max_steer = max_steering_angle;
+            mp.min_speed = min_speed;
+            mp.max_speed = std::min(top_speed, max_speed);
+            mp.speed_tau = speed_tau;
+            mp.w_progress = w_progress;
+            mppi.reset(new mppi::MPPI(mp, threads));
+
+            ROS_INFO("MPPI: %d samples x %d steps at %.0f Hz on %d threads",
+                     mp.samples, mp.horizon, rate, mppi->threads());
+
+            // pubs
+            drive_pub = n.advertise<ackermann_msgs::AckermannDriveStamped>(drive_topic, 1);
+
+            // subs
+            scan_sub = n.subscribe("/scan", 1, &MPPIController::scan_cb, this);
+            mux_sub = n.subscribe("/mux", 1, &MPPIController::mux_cb, this);
+            odom_sub = n.subscribe("/odom", 1, &MPPIController::odom_cb, this);
+            velocity_sub = n.subscribe("/velocity_estimate", 1, &MPPIController::velocity_cb, this);
+
+            timer = n.createTimer(ros::Duration(mp.dt), &MPPIController::control_cb, this);
+        }
+
+        void mux_cb(const std_msgs::Int32MultiArray &msg)
+        {
+            if(mux_idx < 0 || mux_idx >= (int)msg.data.size())
+                return;
+
+            // Stale warm start from before we were switched out is worse than none
+            bool on = msg.data[mux_idx];
+            if(on && !active)
+                mppi->reset();
+            active = on;
+        }
+
+        // velocity_ekf's estimate while it runs, /odom's twist otherwise
+        void odom_cb(const nav_msgs::Odometry &msg)
+        {
+            velocity.from_odom(msg);
+            speed = velocity.speed();
+        }
+
+        void velocity_cb(const geometry_msgs::TwistWithCovarianceStamped &msg)
+        {
+            velocity.from_estimate(msg);
+            speed = velocity.speed();
+        }
+
+        void scan_cb(const race_common::LaserScanView &msg)
+        {
+            grid->build(msg);
+            have_scan = true;
+        }
+
+        void control_cb(const ros::TimerEvent &)
+        {
+            if(!have_scan || !(active || always_on))
+                return;
+
+            auto start = std::chrono::steady_clock::now();
+            auto u = mppi->compute(*grid, speed);
+            auto ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+
+            ackermann_msgs::AckermannDriveStamped drive;
+            drive.header.stamp = ros::Time::now();
+            drive.header.frame_id = "base_link";
+            drive.drive.steering_angle = u.steer;
+            drive.drive.speed = u.speed;
+            drive_pub.publish(drive);
+
+            cycle_ms_sum += ms;
+            cycle_ms_max = std::max(cycle_ms_max, ms);
+            if(++cycles == 200)
+            {
+                ROS_INFO("MPPI cycle: mean %.2f ms, max %.2f ms", cycle_ms_sum/cycles, cycle_ms_max);
+                cycle_ms_sum = cycle_ms_max = 0.0;
+                cycles = 0;
+            }
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "mppi_controller");
+    MPPIController m;
+    ros::spin();
+    return 0;
+}
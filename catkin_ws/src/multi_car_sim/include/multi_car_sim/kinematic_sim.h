@@ -0,0 +1,377 @@
+/**
+ * @file kinematic_sim.h
+ * @brief A small headless simulator for many cars on one map: kinematic
+ *          bicycle models and lidar scans ray marched through a distance
+ *          transform of the map, with the other cars' boxes in the scans.
+ *
+ * It has none of f1tenth_simulator's tire model, only what the safety,
+ * wall following and point distance pipelines need to close the loop.
+ * Scans use the beam directions of a race_common::ScanTables, so the sim
+ * and every car's pipeline share one copy.
+ */
+#pragma once
+
+#include <ros/ros.h>
+#include <nav_msgs/OccupancyGrid.h>
+
+#include <race_common/car_geometry.h>
+#include <race_common/scan_tables.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace multi_car_sim
+{
+
+struct sim_params
+{
+    race_common::car_intrinsics car;
+    double max_speed, max_steer;        // m/s, rad
+    double max_accel, max_decel;        // m/s^2
+    double max_steer_vel;               // rad/s
+    double max_range;                   // m, what a beam that hits nothing reads
+    double range_noise;                 // std dev of gaussian range noise (m)
+};
+
+// Car limits and lidar noise from the simulator's params.yaml
+inline sim_params load_sim_params(const ros::NodeHandle &n)
+{
+    sim_params p;
+    n.param("wheelbase", p.car.wheelbase, 0.3302);
+    n.param("width", p.car.width, 0.2032);
+    n.param("scan_distance_to_base_link", p.car.base_link, 0.275);
+    n.param("max_speed", p.max_speed, 7.0);
+    n.param("max_steering_angle", p.max_steer, 0.4189);
+    n.param("max_accel", p.max_accel, 7.51);
+    n.param("max_decel", p.max_decel, 8.26);
+    n.param("max_steering_vel", p.max_steer_vel, 3.2);
+    n.param("scan_max_range", p.max_range, 30.0);
+    n.param("scan_std_dev", p.range_noise, 0.01);
+    return p;
+}
+
+// The lidar layout the simulator's scan_beams and scan_field_of_view give
+inline race_common::lidar_intrinsics load_sim_lidar(const ros::NodeHandle &n)
+{
+    race_common::lidar_intrinsics lidar;
+    double fov;
+    n.param("scan_beams", lidar.num_scans, 1080);
+    n.param("scan_field_of_view", fov, 2.0*M_PI);
+    lidar.num_scans = std::max(lidar.num_scans, 2);
+    // Through float, as a LaserScan carries them, so the tables match exactly
+    lidar.min_angle = (float)(-fov/2.0);
+    lidar.max_angle = (float)(fov/2.0);
+    lidar.scan_inc = (float)(fov/(lidar.num_scans - 1));
+    return lidar;
+}
+
+/**
+ * @brief Distance (m) from every cell of the map to the nearest occupied
+ *          one, so a ray can safely step that far.
+ */
+class DistanceMap
+{
+    private:
+        int width, height;
+        double resolution, origin_x, origin_y;
+        std::vector<float> dist;
+
+        // Felzenszwalb's 1D squared distance transform of f (n samples):
+        // the lower envelope of the parabolas (q - p)^2 + f[p]
+        static void edt_1d(const double *f, double *d, int n, std::vector<int> &v, std::vector<double> &z)
+        {
+            const auto inf = std::numeric_limits<double>::infinity();
+            int k = 0;
+            v[0] = 0;
+            z[0] = -inf;
+            z[1] = inf;
+            for(int q = 1; q < n; q++)
+            {
+                double s;
+                while(true)
+                {
+                    auto p = v[k];
+                    s = ((f[q] + (double)q*q) - (f[p] + (double)p*p))/(2.0*(q - p));
+                    if(s > z[k] || k == 0)
+                        break;
+                    k--;
+                }
+                k++;
+                v[k] = q;
+                z[k] = s;
+                z[k + 1] = inf;
+            }
+            k = 0;
+            for(int q = 0; q < n; q++)
+            {
+                while(z[k + 1] < q)
+                    k++;
+                auto p = v[k];
+                d[q] = (double)(q - p)*(q - p) + f[p];
+            }
+        }
+
+    public:
+        DistanceMap() : width(0), height(0), resolution(1.0), origin_x(0.0), origin_y(0.0) {}
+
+        /**
+         * @brief Cells above 50% occupancy, and unknown ones, are walls.
+         */
+        void build(const nav_msgs::OccupancyGrid &map)
+        {
+            width = map.info.width;
+            height = map.info.height;
+            resolution = map.info.resolution;
+            origin_x = map.info.origin.position.x;
+            origin_y = map.info.origin.position.y;
+
+            // Free cells start "far" rather than at infinity, which would
+            // turn the parabola intersections into NaNs
+            const double far = 1e12;
+            std::vector<double> sq((size_t)width*height, far);
+            for(size_t i = 0; i < sq.size(); i++)
+                if(map.data[i] < 0 || map.data[i] > 50)
+                    sq[i] = 0.0;
+
+            // Separable: columns, then rows, in squared cells
+            auto n = std::max(width, height);
+            std::vector<double> f(n), d(n), z(n + 1);
+            std::vector<int> v(n);
+            for(int x = 0; x < width; x++)
+            {
+                for(int y = 0; y < height; y++)
+                    f[y] = sq[(size_t)y*width + x];
+                edt_1d(f.data(), d.data(), height, v, z);
+                for(int y = 0; y < height; y++)
+                    sq[(size_t)y*width + x] = d[y];
+            }
+            dist.resize(sq.size());
+            for(int y = 0; y < height; y++)
+            {
+                auto row = &sq[(size_t)y*width];
+                edt_1d(row, d.data(), width, v, z);
+                for(int x = 0; x < width; x++)
+                    dist[(size_t)y*width + x] = d[x] < far/2 ? std::sqrt(d[x])*resolution
+                                                             : std::numeric_limits<float>::infinity();
+            }
+        }
+
+        // Off the map counts as a wall
+        float at(double x, double y) const
+        {
+            auto cx = (int)std::floor((x - origin_x)/resolution);
+            auto cy = (int)std::floor((y - origin_y)/resolution);
+            if(cx < 0 || cy < 0 || cx >= width || cy >= height)
+                return 0.0f;
+            return dist[(size_t)cy*width + cx];
+        }
+
+        double getResolution() const
+        {
+            return resolution;
+        }
+};
+
+struct car_state
+{
+    double x, y, theta;     // base_link (rear axle) in the map
+    double speed, steer;
+    bool crashed;
+};
+
+struct car_command
+{
+    double speed, steer;
+};
+
+class KinematicSim
+{
+    private:
+        sim_params p;
+        std::shared_ptr<const DistanceMap> map;
+        std::shared_ptr<const race_common::ScanTables> tables;
+        std::vector<car_state> cars;
+        std::vector<std::mt19937> rngs;     // one per car, so scans don't depend on the order
+
+        // Corners of car i's box, in the map
+        void corners(const car_state &c, double (&out)[4][2]) const
+        {
+            const double lx[4] = {0.0, p.car.wheelbase, p.car.wheelbase, 0.0};
+            const double ly[4] = {-p.car.width/2.0, -p.car.width/2.0, p.car.width/2.0, p.car.width/2.0};
+            auto cs = std::cos(c.theta), sn = std::sin(c.theta);
+            for(int k = 0; k < 4; k++)
+            {
+                out[k][0] = c.x + cs*lx[k] - sn*ly[k];
+                out[k][1] = c.y + sn*lx[k] + cs*ly[k];
+            }
+        }
+
+        bool inside(const car_state &c, double x, double y) const
+        {
+            auto dx = x - c.x, dy = y - c.y;
+            auto cs = std::cos(c.theta), sn = std::sin(c.theta);
+            auto bx = cs*dx + sn*dy, by = -sn*dx + cs*dy;
+            return bx >= 0.0 && bx <= p.car.wheelbase && std::fabs(by) <= p.car.width/2.0;
+        }
+
+        bool collides(int i) const
+        {
+            double pts[4][2];
+            corners(cars[i], pts);
+            auto touch = map->getResolution();
+            for(int k = 0; k < 4; k++)
+            {
+                // Corners and edge midpoints against the walls
+                auto &a = pts[k], &b = pts[(k + 1) % 4];
+                if(map->at(a[0], a[1]) < touch || map->at(0.5*(a[0] + b[0]), 0.5*(a[1] + b[1])) < touch)
+                    return true;
+            }
+            for(size_t j = 0; j < cars.size(); j++)
+            {
+                if((int)j == i)
+                    continue;
+                double other[4][2];
+                corners(cars[j], other);
+                for(int k = 0; k < 4; k++)
+                    if(inside(cars[j], pts[k][0], pts[k][1]) || inside(cars[i], other[k][0], other[k][1]))
+                        return true;
+            }
+            return false;
+        }
+
+        // Distance along the ray (ox, oy) + t(dx, dy) to car c's box, or max_range
+        double hit_box(const car_state &c, double ox, double oy, double dx, double dy) const
+        {
+            auto cs = std::cos(c.theta), sn = std::sin(c.theta);
+            const double o[2] = {cs*(ox - c.x) + sn*(oy - c.y), -sn*(ox - c.x) + cs*(oy - c.y)};
+            const double d[2] = {cs*dx + sn*dy, -sn*dx + cs*dy};
+            const double lo[2] = {0.0, -p.car.width/2.0}, hi[2] = {p.car.wheelbase, p.car.width/2.0};
+            double t_near = 0.0, t_far = p.max_range;
+            for(int k = 0; k < 2; k++)
+            {
+                if(std::fabs(d[k]) < 1e-12)
+                {
+                    if(o[k] < lo[k] || o[k] > hi[k])
+                        return p.max_range;
+                    continue;
+                }
+                auto t0 = (lo[k] - o[k])/d[k], t1 = (hi[k] - o[k])/d[k];
+                if(t0 > t1)
+                    std::swap(t0, t1);
+                t_near = std::max(t_near, t0);
+                t_far = std::min(t_far, t1);
+            }
+            return t_near <= t_far ? t_near : p.max_range;
+        }
+
+    public:
+        KinematicSim(const sim_params &p, std::shared_ptr<const DistanceMap> map,
+                     std::shared_ptr<const race_common::ScanTables> tables,
+                     const std::vector<car_state> &starts)
+            : p(p), map(map), tables(tables), cars(starts)
+        {
+            for(size_t i = 0; i < cars.size(); i++)
+                rngs.emplace_back(i + 1);
+        }
+
+        size_t size() const
+        {
+            return cars.size();
+        }
+
+        const car_state &car(int i) const
+        {
+            return cars[i];
+        }
+
+        const race_common::ScanTables &getTables() const
+        {
+            return *tables;
+        }
+
+        /**
+         * @brief Advance every car by dt toward its command. A car that hits
+         *          a wall or another car stops where it is for good.
+         * @return the number of cars that crashed during this step
+         */
+        int step(const std::vector<car_command> &cmds, double dt)
+        {
+            for(size_t i = 0; i < cars.size(); i++)
+            {
+                auto &c = cars[i];
+                if(c.crashed)
+                    continue;
+                auto steer = std::min(std::max(cmds[i].steer, -p.max_steer), p.max_steer);
+                auto max_ds = p.max_steer_vel*dt;
+                c.steer += std::min(std::max(steer - c.steer, -max_ds), max_ds);
+
+                auto speed = std::min(std::max(cmds[i].speed, -p.max_speed), p.max_speed);
+                auto accel = std::min(std::max((speed - c.speed)/dt, -p.max_decel), p.max_accel);
+                c.speed += accel*dt;
+
+                // Midpoint heading for the position update
+                auto yaw_rate = c.speed*std::tan(c.steer)/p.car.wheelbase;
+                auto mid = c.theta + 0.5*yaw_rate*dt;
+                c.x += c.speed*std::cos(mid)*dt;
+                c.y += c.speed*std::sin(mid)*dt;
+                c.theta = std::remainder(c.theta + yaw_rate*dt, 2.0*M_PI);
+            }
+
+            int crashes = 0;
+            for(size_t i = 0; i < cars.size(); i++)
+            {
+                if(cars[i].crashed || !collides(i))
+                    continue;
+                cars[i].crashed = true;
+                cars[i].speed = 0.0;
+                crashes++;
+            }
+            return crashes;
+        }
+
+        /**
+         * @brief Car i's scan into `ranges` (resized to the tables' beams).
+         */
+        void scan(int i, std::vector<float> &ranges)
+        {
+            const auto &c = cars[i];
+            const auto &t = *tables;
+            auto cs = std::cos(c.theta), sn = std::sin(c.theta);
+            auto ox = c.x + cs*p.car.base_link, oy = c.y + sn*p.car.base_link;
+            auto min_step = 0.5*map->getResolution();
+            std::normal_distribution<float> noise(0.0f, p.range_noise);
+
+            ranges.resize(t.cos.size());
+            for(size_t b = 0; b < ranges.size(); b++)
+            {
+                auto dx = cs*t.cos[b] - sn*t.sin[b];
+                auto dy = sn*t.cos[b] + cs*t.sin[b];
+
+                // March through the distance map: each step can't cross a wall
+                double r = 0.0;
+                while(r < p.max_range)
+                {
+                    auto d = map->at(ox + r*dx, oy + r*dy);
+                    if(d < min_step)
+                        break;
+                    // Less a cell, as the distance is from this cell's center
+                    r += std::max((double)d - map->getResolution(), min_step);
+                }
+                r = std::min(r, p.max_range);
+
+                for(size_t j = 0; j < cars.size(); j++)
+                    if((int)j != i)
+                        r = std::min(r, hit_box(cars[j], ox, oy, dx, dy));
+
+                if(p.range_noise > 0.0 && r < p.max_range)
+                    r = std::max(r + noise(rngs[i]), 0.0);
+                ranges[b] = r;
+            }
+        }
+};
+
+} // namespace multi_car_sim
@@ -0,0 +1,364 @@
+/**
+ * @file multi_car_sim.cpp
+ * @brief Runs `num_cars` independent copies of the Safety, WallFollow and
+ *          PointDist pipelines in one process, driving cars on the
+ *          headless KinematicSim.
+ *
+ * Car i lives under the car<i> namespace: the sim publishes car<i>/scan,
+ * car<i>/odom and car<i>/mux, and drives it with car<i>/wall_follow until
+ * its safety node asserts car<i>/brake_bool. Every car reads its params
+ * from ~car<i>, a copy of this node's params, so one can be overridden.
+ *
+ * The read-only tables (braking thresholds, beam directions and the
+ * footprint perimeter) are built once and shared by every car. Each car's
+ * callbacks go to its own queue, and a pool of `threads` workers serves the
+ * queues round robin, so a car's pipelines never run concurrently with
+ * each other and need no locks. The pipelines subscribe to scans as
+ * race_common::LaserScanView, not as the published sensor_msgs::LaserScan,
+ * so roscpp serializes every scan once per subscriber even in process and
+ * deserializes it into a recycled view.
+ */
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <nav_msgs/Odometry.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <sensor_msgs/LaserScan.h>
+#include <ackermann_msgs/AckermannDriveStamped.h>
+#include <std_msgs/Bool.h>
+#include <std_msgs/Int32MultiArray.h>
+
+#include <boost/make_shared.hpp>
+
+#include <multi_car_sim/kinematic_sim.h>
+#include <point_dist/point_dist.h>
+#include <safety_node/safety.h>
+#include <wall_follow/wall_follow.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One car's pipelines and the queue their callbacks go to
+struct car_pipeline
+{
+    ros::CallbackQueue queue;
+    std::unique_ptr<Safety> safety;
+    std::unique_ptr<WallFollow> wall_follow;
+    std::unique_ptr<PointDist> point_dist;
+};
+
+// The sim's side of one car
+struct car_io
+{
+    ros::Publisher scan_pub, odom_pub, mux_pub;
+    ros::Subscriber drive_sub, brake_sub, brake_bool_sub;
+    multi_car_sim::car_command drive, brake;
+    ros::Time braked;       // last brake_bool, zero if not braking
+};
+
+class MultiCarSim
+{
+    private:
+        ros::NodeHandle n;
+        ros::Timer step_timer, report_timer;
+
+        std::shared_ptr<const race_common::ScanTables> tables;
+        std::shared_ptr<const safety_node::BrakingTable> braking;
+        std::unique_ptr<multi_car_sim::KinematicSim> sim;
+        std::vector<car_io> io;
+        std::vector<multi_car_sim::car_command> commands;
+
+        std::vector<std::unique_ptr<car_pipeline>> cars;
+        std::vector<std::thread> workers;
+        std::vector<std::atomic<int64_t>> busy_ns;     // per worker, since the last report
+        std::atomic<bool> running;
+
+        race_common::lidar_intrinsics lidar;
+        multi_car_sim::sim_params params;
+        std::string frame;
+        double dt, brake_release_time;
+        int threads, steps_per_scan, steps, crashes, brakes;
+        ros::WallTime last_report;
+
+        // The params every car starts from: ours, minus the per-car copies
+        XmlRpc::XmlRpcValue car_params()
+        {
+            XmlRpc::XmlRpcValue all, out;
+            n.getParam(n.getNamespace(), all);
+            for(auto &kv : all)
+                if(kv.first.compare(0, 3, "car") != 0 || kv.first.size() == 3 ||
+                   !std::isdigit((unsigned char)kv.first[3]))
+                    out[kv.first] = kv.second;
+
+            // Each car's drive topic is in its own namespace, and it gets
+            // whole scans rather than the shared scan_slicer's slices
+            out["wall_follow_topic"] = std::string("wall_follow");
+            out["use_scan_slices"] = false;
+            return out;
+        }
+
+    public:
+        MultiCarSim()
+            : n(ros::NodeHandle("~")),
+              running(false), steps(0), crashes(0), brakes(0)
+        {
+            int num_cars;
+            double sim_rate, scan_rate, start_x, start_y, start_theta, spacing;
+            n.param("num_cars", num_cars, 4);
+            n.param("sim_rate", sim_rate, 200.0);
+            n.param("sim_scan_rate", scan_rate, 40.0);
+            n.param("sim_brake_release_time", brake_release_time, 1.0);
+            n.param("start_x", start_x, 0.0);
+            n.param("start_y", start_y, 0.0);
+            n.param("start_theta", start_theta, 0.0);
+            n.param("start_spacing", spacing, 1.0);
+            n.param("threads", threads, (int)std::max(std::thread::hardware_concurrency(), 1u));
+            n.param<std::string>("scan_frame", frame, "laser");
+            num_cars = std::max(num_cars, 1);
+            threads = std::max(std::min(threads, num_cars), 1);
+            busy_ns = std::vector<std::atomic<int64_t>>(threads);
+            dt = 1.0/sim_rate;
+            steps_per_scan = std::max((int)std::lround(sim_rate/scan_rate), 1);
+
+            boost::shared_ptr<const nav_msgs::OccupancyGrid>
+                grid = ros::topic::waitForMessage<nav_msgs::OccupancyGrid>("/map", ros::Duration(10.0));
+            if(grid == NULL)
+            {
+                ROS_ERROR("Couldn't get /map for the simulator.");
+                ros::shutdown();
+                return;
+            }
+            auto map = std::make_shared<multi_car_sim::DistanceMap>();
+            map->build(*grid);
+
+            // Shared tables: one copy for the sim and every car
+            lidar = multi_car_sim::load_sim_lidar(n);
+            auto bp = safety_node::load_braking_params(n);
+            tables = std::make_shared<const race_common::ScanTables>(bp.car, lidar);
+
+            std::string table_file;
+            n.param<std::string>("braking_table_file", table_file, "");
+            auto table = std::make_shared<safety_node::BrakingTable>();
+            if(table_file.empty() || !table->open(table_file) || !table->matches(lidar))
+            {
+                ROS_WARN("No usable braking table at '%s', building it now.", table_file.c_str());
+                table->build(bp, lidar);
+            }
+            braking = table;
+
+            // Cars in a line behind the start pose
+            std::vector<multi_car_sim::car_state> starts(num_cars);
+            for(int i = 0; i < num_cars; i++)
+            {
+                auto &s = starts[i];
+                s.x = start_x - i*spacing*std::cos(start_theta);
+                s.y = start_y - i*spacing*std::sin(start_theta);
+                s.theta = start_theta;
+                s.speed = s.steer = 0.0;
+                s.crashed = false;
+            }
+            params = multi_car_sim::load_sim_params(n);
+            sim.reset(new multi_car_sim::KinematicSim(params, map, tables, starts));
+
+            // Enable each car's wall follower on its mux
+            int mux_size, wall_follow_idx;
+            n.param("mux_size", mux_size, 6);
+            n.param("wall_follow_idx", wall_follow_idx, 5);
+            std_msgs::Int32MultiArray mux;
+            mux.data.assign(std::max(mux_size, wall_follow_idx + 1), 0);
+            mux.data[wall_follow_idx] = 1;
+
+            ros::NodeHandle root;
+            io.resize(num_cars);
+            commands.assign(num_cars, multi_car_sim::car_command{0.0, 0.0});
+            for(int i = 0; i < num_cars; i++)
+            {
+                auto ns = "car" + std::to_string(i) + "/";
+                auto &c = io[i];
+                c.drive = c.brake = multi_car_sim::car_command{0.0, 0.0};
+
+                // pubs
+                c.scan_pub = root.advertise<sensor_msgs::LaserScan>(ns + "scan", 1);
+                c.odom_pub = root.advertise<nav_msgs::Odometry>(ns + "odom", 1);
+                c.mux_pub = root.advertise<std_msgs::Int32MultiArray>(ns + "mux", 1, true);
+                c.mux_pub.publish(mux);
+
+                // subs
+                c.drive_sub = root.subscribe<ackermann_msgs::AckermannDriveStamped>(ns + "wall_follow", 1,
+                    [this, i](const ackermann_msgs::AckermannDriveStamped::ConstPtr &msg) {
+                        io[i].drive = {msg->drive.speed, msg->drive.steering_angle};
+                    });
+                c.brake_sub = root.subscribe<ackermann_msgs::AckermannDriveStamped>(ns + "brake", 1,
+                    [this, i](const ackermann_msgs::AckermannDriveStamped::ConstPtr &msg) {
+                        io[i].brake = {msg->drive.speed, msg->drive.steering_angle};
+                    });
+                c.brake_bool_sub = root.subscribe<std_msgs::Bool>(ns + "brake_bool", 1,
+                    [this, i](const std_msgs::Bool::ConstPtr &msg) {
+                        if(!msg->data)
+                            return;
+                        if(io[i].braked.isZero())
+                            brakes++;
+                        io[i].braked = ros::Time::now();
+                    });
+            }
+
+            step_timer = n.createTimer(ros::Duration(dt), &MultiCarSim::step_cb, this);
+            report_timer = n.createTimer(ros::Duration(5.0), &MultiCarSim::report_cb, this);
+            last_report = ros::WallTime::now();
+        }
+
+        ~MultiCarSim()
+        {
+            running = false;
+            for(auto &w : workers)
+                w.join();
+        }
+
+        bool ok() const
+        {
+            return sim != nullptr;
+        }
+
+        /**
+         * @brief Build every car's pipelines and start the workers. The sim
+         *          must already be publishing (see main): the constructors
+         *          wait for a first scan.
+         */
+        void spawn()
+        {
+            auto params = car_params();
+            for(size_t i = 0; i < io.size(); i++)
+            {
+                auto ns = "car" + std::to_string(i);
+                n.setParam(ns, params);
+
+                std::unique_ptr<car_pipeline> car(new car_pipeline);
+                ros::NodeHandle nh(ns), pnh(n, ns);
+                nh.setCallbackQueue(&car->queue);
+                pnh.setCallbackQueue(&car->queue);
+                car->safety.reset(new Safety(nh, pnh, braking, tables));
+                car->wall_follow.reset(new WallFollow(nh, pnh));
+                car->point_dist.reset(new PointDist(nh, pnh, tables));
+                cars.push_back(std::move(car));
+            }
+
+            running = true;
+            for(int k = 0; k < threads; k++)
+                workers.emplace_back(&MultiCarSim::work, this, k);
+            ROS_INFO("Simulating %zu cars on %d worker threads.", cars.size(), threads);
+        }
+
+        // Worker k serves cars k, k + threads, ... one callback at a time
+        void work(int k)
+        {
+            while(running)
+            {
+                bool idle = true;
+                for(size_t i = k; i < cars.size(); i += threads)
+                {
+                    auto t0 = std::chrono::steady_clock::now();
+                    if(cars[i]->queue.callOne() != ros::CallbackQueue::Called)
+                        continue;
+                    idle = false;
+                    busy_ns[k] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - t0).count();
+                }
+                if(idle)
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+
+        void step_cb(const ros::TimerEvent &)
+        {
+            auto now = ros::Time::now();
+            for(size_t i = 0; i < io.size(); i++)
+            {
+                auto &c = io[i];
+                // Braking holds until the car has stopped and the safety
+                // node has been quiet for a while, then the wall follower resumes
+                if(!c.braked.isZero() && sim->car(i).speed == 0.0 &&
+                   (now - c.braked).toSec() > brake_release_time)
+                    c.braked = ros::Time();
+                commands[i] = c.braked.isZero() ? c.drive : c.brake;
+            }
+
+            auto crashed = sim->step(commands, dt);
+            if(crashed > 0)
+            {
+                crashes += crashed;
+                ROS_WARN("%d car(s) crashed (%d total).", crashed, crashes);
+            }
+
+            if(++steps % steps_per_scan == 0)
+                publish(now);
+        }
+
+        void publish(const ros::Time &now)
+        {
+            for(size_t i = 0; i < io.size(); i++)
+            {
+                const auto &s = sim->car(i);
+
+                auto scan = boost::make_shared<sensor_msgs::LaserScan>();
+                scan->header.stamp = now;
+                scan->header.frame_id = frame;
+                scan->angle_min = lidar.min_angle;
+                scan->angle_max = lidar.max_angle;
+                scan->angle_increment = lidar.scan_inc;
+                scan->range_min = 0.0;
+                scan->range_max = params.max_range;
+                sim->scan(i, scan->ranges);
+                io[i].scan_pub.publish(scan);
+
+                auto odom = boost::make_shared<nav_msgs::Odometry>();
+                odom->header.stamp = now;
+                odom->header.frame_id = "map";
+                odom->child_frame_id = "base_link";
+                odom->pose.pose.position.x = s.x;
+                odom->pose.pose.position.y = s.y;
+                odom->pose.pose.orientation.z = std::sin(0.5*s.theta);
+                odom->pose.pose.orientation.w = std::cos(0.5*s.theta);
+                odom->twist.twist.linear.x = s.speed;
+                odom->twist.twist.angular.z = s.speed*std::tan(s.steer)/params.car.wheelbase;
+                io[i].odom_pub.publish(odom);
+            }
+        }
+
+        void report_cb(const ros::TimerEvent &)
+        {
+            auto wall = ros::WallTime::now();
+            auto period = (wall - last_report).toSec();
+            last_report = wall;
+            if(period <= 0.0)
+                return;
+
+            std::string load;
+            for(auto &b : busy_ns)
+            {
+                char buf[16];
+                snprintf(buf, sizeof(buf), " %.0f%%", 100.0*b.exchange(0)*1e-9/period);
+                load += buf;
+            }
+            ROS_INFO("Sim %.1f s, %d brakes, %d crashes, worker load:%s",
+                     steps*dt, brakes, crashes, load.c_str());
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "multi_car_sim");
+    MultiCarSim sim;
+    if(!sim.ok())
+        return 1;
+
+    // The sim steps on the global queue while the pipelines wait for their first scan
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+    sim.spawn();
+    ros::waitForShutdown();
+    return 0;
+}
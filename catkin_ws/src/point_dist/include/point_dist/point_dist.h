@@ -0,0 +1,270 @@
+/**
+ * @file point_dist.h
+ * @brief Farthest and closest beams of every scan, and optionally the
+ *          footprint clearance and the k nearest distinct obstacles.
+ *
+ * Topics are resolved in the namespace of the NodeHandle it is given, so
+ * several cars can run in one process (see multi_car_sim).
+ */
+#pragma once
+
+#include <ros/ros.h> 
+#include <point_dist/PointDist.h> 
+#include <point_dist/NearestObstacles.h> 
+#include <sensor_msgs/LaserScan.h>
+#include <race_common/car_geometry.h>
+#include <race_common/laser_scan_view.h>
+#include <race_common/scan_tables.h>
+#include <race_common/viz_publisher.h>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <math.h> 
+
+class PointDist
+{
+private: 
+    ros::NodeHandle nh, n;  // topics, params
+    ros::Subscriber scan; 
+    ros::Publisher max_pub, min_pub, clearance_pub, nearest_pub; 
+
+    // Footprint-relative clearance (optional)
+    bool use_footprint; 
+    race_common::car_intrinsics car; 
+    std::shared_ptr<const race_common::ScanTables> tables;  // footprint, may be shared
+    std::vector<float> no_footprint;    // zeros, when clearance is just the range
+    const float *footprint;             // lidar to car edge, per beam
+    std::vector<float> clearance;       // scratch, reused every scan
+
+    // k nearest distinct obstacles (optional)
+    int num_nearest; 
+    double nms_radius, break_dist; 
+    std::vector<int> candidates;    // scratch, one beam per object
+    std::vector<int> taken;         // scratch, beams already published
+
+    // Closest, farthest and nearest obstacle hits on point_dist_markers
+    // while someone watches them
+    race_common::VizPublisher viz; 
+
+    void update_footprint( const race_common::LaserScanView & msg )
+    {
+        clearance.resize(msg.ranges.size()); 
+
+        // Without the footprint clearance is just the range
+        if( !use_footprint )
+        {
+            no_footprint.resize(msg.ranges.size(), 0.0f); 
+            footprint = no_footprint.data(); 
+            return; 
+        }
+
+        // Rebuilt only if the lidar layout isn't the one the tables were made for
+        if( !tables || !tables->matches(msg) )
+            tables = std::make_shared<const race_common::ScanTables>(car, race_common::ScanTables::layout(msg)); 
+        footprint = tables->perimeter.data(); 
+    }
+
+    void compute_clearance( const race_common::LaserScanView & msg )
+    {
+        update_footprint(msg); 
+
+        // Branch-free so the compiler vectorizes it; invalid beams never win the min
+        const auto inf = std::numeric_limits<float>::infinity(); 
+        const auto lo = msg.range_min, hi = msg.range_max; 
+        const auto n = msg.ranges.size(); 
+        const float *ranges = msg.ranges.data(); 
+        const float *perim = footprint; 
+        float *out = clearance.data(); 
+        for( size_t i = 0; i < n; i++ )
+        {
+            auto r = ranges[i]; 
+            out[i] = (r >= lo && r <= hi) ? r - perim[i] : inf; 
+        }
+    }
+
+    void publish_clearance( const race_common::LaserScanView & msg )
+    {
+        auto closest = std::min_element(clearance.begin(), clearance.end()) - clearance.begin(); 
+
+        point_dist::PointDist body; 
+        body.distance = clearance[closest]; 
+        body.angle = msg.angle_min + closest*msg.angle_increment; 
+        clearance_pub.publish(body); 
+    }
+
+    void publish_nearest( const race_common::LaserScanView & msg )
+    {
+        const auto n = (int)clearance.size(); 
+        const auto inf = std::numeric_limits<float>::infinity(); 
+
+        // One candidate per object: the closest beam of every run of
+        // neighbouring beams that doesn't jump by more than break_dist
+        candidates.clear(); 
+        int best = -1; 
+        for( int i = 0; i < n; i++ )
+        {
+            if( clearance[i] == inf )
+            {
+                if( best >= 0 ) candidates.push_back(best); 
+                best = -1; 
+                continue; 
+            }
+            if( best >= 0 && std::fabs(msg.ranges[i] - msg.ranges[i-1]) > break_dist )
+            {
+                candidates.push_back(best); 
+                best = -1; 
+            }
+            if( best < 0 || clearance[i] < clearance[best] )
+                best = i; 
+        }
+        if( best >= 0 ) candidates.push_back(best); 
+
+        // Partial selection: only the few closest candidates get ordered.
+        // Take extra in case suppression below removes some.
+        auto by_clearance = [this](int a, int b) { return clearance[a] < clearance[b]; }; 
+        auto m = std::min((int)candidates.size(), 2*num_nearest); 
+        std::partial_sort(candidates.begin(), candidates.begin() + m, candidates.end(), by_clearance); 
+
+        // Suppress candidates whose hit points are within nms_radius of one
+        // already taken (an object split by a noisy beam)
+        point_dist::NearestObstacles out; 
+        out.header = msg.header; 
+        taken.clear(); 
+        const auto nms_sq = nms_radius*nms_radius; 
+        for( int c = 0; c < m && (int)taken.size() < num_nearest; c++ )
+        {
+            auto i = candidates[c]; 
+            auto ri = msg.ranges[i]; 
+            bool distinct = true; 
+            for( auto j : taken )
+            {
+                auto rj = msg.ranges[j]; 
+                auto d_sq = ri*ri + rj*rj - 2.0*ri*rj*std::cos((i - j)*msg.angle_increment); 
+                if( d_sq < nms_sq ) { distinct = false; break; }
+            }
+            if( !distinct )
+                continue; 
+
+            taken.push_back(i); 
+            point_dist::PointDist p; 
+            p.distance = clearance[i]; 
+            p.angle = msg.angle_min + i*msg.angle_increment; 
+            out.obstacles.push_back(p); 
+        }
+        nearest_pub.publish(out); 
+    }
+
+    // Hit points in the lidar frame: closest red, farthest green, the k
+    // nearest obstacles orange
+    void post_markers( const race_common::LaserScanView & msg, 
+                       const point_dist::PointDist & min, const point_dist::PointDist & max )
+    {
+        auto header = msg.header; 
+        auto hit = [](double r, double a) { return race_common::viz::point(r*std::cos(a), r*std::sin(a)); }; 
+        auto closest = hit(min.distance, min.angle), farthest = hit(max.distance, max.angle); 
+        std::vector<geometry_msgs::Point> nearest; 
+        if( num_nearest > 0 )
+            for( auto i : taken )
+                nearest.push_back(hit(msg.ranges[i], msg.angle_min + i*msg.angle_increment)); 
+
+        viz.post([=](visualization_msgs::MarkerArray & out) {
+            auto m = race_common::viz::marker(header, "points", 0, visualization_msgs::Marker::SPHERE, 0.15); 
+            m.pose.position = closest; 
+            m.color = race_common::viz::color(1.0f, 0.0f, 0.0f); 
+            out.markers.push_back(m); 
+
+            m.id = 1; 
+            m.pose.position = farthest; 
+            m.color = race_common::viz::color(0.0f, 1.0f, 0.0f); 
+            out.markers.push_back(m); 
+
+            auto list = race_common::viz::marker(header, "nearest", 0, visualization_msgs::Marker::SPHERE_LIST, 0.1); 
+            list.points = nearest; 
+            list.color = race_common::viz::color(1.0f, 0.5f, 0.0f); 
+            out.markers.push_back(list); 
+        }); 
+    }
+
+public: 
+
+    /**
+     * @param nh      topics are resolved in its namespace
+     * @param pnh     params are read from it
+     * @param shared  footprint tables built elsewhere for the same car, if any
+     */
+    PointDist( ros::NodeHandle nh = ros::NodeHandle(), ros::NodeHandle pnh = ros::NodeHandle("~"), 
+               std::shared_ptr<const race_common::ScanTables> shared = nullptr )
+        : nh(nh), n(pnh), 
+          tables(shared), footprint(nullptr)
+    {   
+        ROS_INFO("Setting up point distance node."); 
+        n.param("use_footprint", use_footprint, false); 
+        n.param("width", car.width, 0.2032); 
+        n.param("wheelbase", car.wheelbase, 0.3302); 
+        n.param("scan_distance_to_base_link", car.base_link, 0.275); 
+        n.param("num_nearest", num_nearest, 0); 
+        n.param("nearest_nms_radius", nms_radius, 0.3); 
+        n.param("nearest_break_dist", break_dist, 0.2); 
+
+        scan = nh.subscribe("scan", 1, &PointDist::scan_cb, this); 
+        max_pub = nh.advertise<point_dist::PointDist>("farthest_point", 1); 
+        min_pub = nh.advertise<point_dist::PointDist>("closest_point", 1); 
+        if( use_footprint )
+            clearance_pub = nh.advertise<point_dist::PointDist>("closest_clearance", 1); 
+        if( num_nearest > 0 )
+            nearest_pub = nh.advertise<point_dist::NearestObstacles>("nearest_obstacles", 1); 
+
+        double viz_rate; 
+        n.param("viz_rate", viz_rate, 10.0); 
+        viz = race_common::VizPublisher(nh, "point_dist_markers", viz_rate); 
+    }
+
+    void scan_cb( const race_common::LaserScanView & msg )
+    {
+        point_dist::PointDist max, min; 
+        
+        // Initiate inital mins and max
+        max.distance = msg.ranges[0];  
+        min.distance = msg.ranges[0]; 
+        max.angle = msg.angle_min; 
+        min.angle = msg.angle_min; 
+
+        for( size_t i = 1; i < msg.ranges.size(); i ++ )
+        {
+            if( max.distance < msg.ranges[i] )
+            {
+                max.distance = msg.ranges[i];  
+                max.angle = (msg.angle_min + (i*msg.angle_increment));
+            }
+
+            if( min.distance > msg.ranges[i] ) 
+            {
+                min.distance = msg.ranges[i]; 
+                min.angle = (msg.angle_min + (i*msg.angle_increment));
+            } 
+        }
+        
+        // min.angle = min.angle*(180.0/M_PI); 
+        // max.angle = max.angle*(180.0/M_PI);
+
+        min.angle = min.angle; 
+        max.angle = max.angle; 
+
+        max_pub.publish(max);
+        min_pub.publish(min); 
+
+        if( !msg.ranges.empty() && (use_footprint || num_nearest > 0) )
+        {
+            compute_clearance(msg); 
+            if( use_footprint )
+                publish_clearance(msg); 
+            if( num_nearest > 0 )
+                publish_nearest(msg); 
+        }
+
+        if( !msg.ranges.empty() && viz.wanted() )
+            post_markers(msg, min, max); 
+    }
+
+};
@@ -0,0 +1,77 @@
+/**
+ * @file car_geometry.h
+ * @brief Car and lidar intrinsics, and the per-beam distance from the
+ *          lidar to the edge of the car's footprint.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifndef PI
+#define PI M_PI
+#endif
+
+namespace race_common
+{
+
+struct car_intrinsics
+{ 
+        double width, wheelbase, base_link;  
+};
+
+struct lidar_intrinsics 
+{ 
+    double scan_inc,
+           min_angle,
+           max_angle;
+    int num_scans; 
+}; 
+
+// Distance from the lidar to the footprint's edge along every beam
+inline std::vector<double> compute_car_perim(
+    const car_intrinsics& car_data, const lidar_intrinsics& lidar_data)
+{
+    std::vector<double> car_perim = std::vector<double>(); 
+    car_perim.reserve(lidar_data.num_scans); 
+    
+    auto angle = lidar_data.min_angle; 
+    for( size_t i = 0; i < lidar_data.num_scans; i++ ) 
+    {   
+        if(angle > 0.0) // left side of the car
+        {
+            if(angle < PI/2.0) // 0 -> pi/2
+            {
+                auto left_side = (car_data.width/2.0)/std::sin(angle);
+                auto top_left = (car_data.wheelbase - car_data.base_link)/std::cos(angle); 
+                car_perim.push_back(std::min(left_side, top_left));  
+            }
+            else // pi/2 -> pi
+            {
+                auto left_side = (car_data.width/2.0)/std::cos(angle - (PI/2.0));  
+                auto bottom_left = (car_data.base_link)/std::sin(angle - (PI/2.0));
+                car_perim.push_back(std::min(left_side, bottom_left)); 
+            }
+        }
+        else // right side of the car
+        {
+            if(angle < -PI/2.0) // pi -> 3pi/2
+            {
+                auto right_side = (car_data.width/2.0)/std::cos(-angle - (PI/2.0));
+                auto bottom_right = (car_data.base_link)/std::sin(-angle - (PI/2.0)); 
+                car_perim.push_back(std::min(right_side, bottom_right)); 
+            }
+            else // 3pi/2 -> 2pi
+            {
+                auto right_side = (car_data.width/2.0)/std::sin(-angle);
+                auto top_right = (car_data.wheelbase - car_data.base_link)/std::cos(-angle); 
+                car_perim.push_back(std::min(top_right, right_side)); 
+            }
+        }
+        angle += lidar_data.scan_inc; 
+    }
+    return car_perim; 
+}
+
+} // namespace race_common
@@ -0,0 +1,226 @@
+/**
+ * @file clock_sync.h
+ * @brief Recovers a sensor's steady clock from jittery host stamps, so
+ *          messages can be re-stamped on it.
+ *
+ * A lidar fires on its own oscillator, one scan every period, but drivers
+ * often stamp scans when the host reads them, which adds milliseconds of
+ * scheduling and transport jitter. Over a few seconds the true stamps are
+ * a straight line in the scan count,
+ *
+ *     stamp_k = offset + period*n_k
+ *
+ * where period is the nominal one off by the sensor's drift and n_k counts
+ * periods since the first scan (lost scans skip counts). Each new stamp
+ * gets its count from the current line, and the line is refit over a
+ * sliding window by Huber-weighted least squares, which shrugs off the odd
+ * late scan. Delays only ever add to a stamp, so the line is finally
+ * lowered onto a low quantile of the residuals: the corrected stamp is the
+ * earliest the host could have seen the scan, rather than the average.
+ *
+ * A stamp far from the line for several scans in a row (a restarted
+ * driver, a looping bag) starts the fit over.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+namespace race_common
+{
+
+struct clock_sync_params
+{
+    int window;             // stamps in the fit
+    int min_samples;        // stamps before correcting anything
+    double huber;           // residuals past this many robust std devs are down-weighted
+    double quantile;        // residual quantile the line is lowered onto
+    double reset_error;     // s; a stamp this far from the line is an outlier...
+    int reset_count;        // ...and this many in a row restart the fit
+};
+
+class ClockSync
+{
+    private:
+        struct sample
+        {
+            double n;       // periods since the first stamp
+            double t;       // s since the first stamp
+        };
+
+        clock_sync_params p;
+        std::deque<sample> samples;
+        std::vector<double> residuals;
+        double t0;          // first stamp (s), everything is relative to it
+        double last_n, last_t;
+        double offset, period, nominal;
+        double jitter;      // robust std dev of the residuals (s)
+        int outliers;
+        bool fitted;
+
+        void fit()
+        {
+            // Centered for conditioning
+            double mn = 0.0, mt = 0.0;
+            for(const auto &s : samples)
+            {
+                mn += s.n;
+                mt += s.t;
+            }
+            mn /= samples.size();
+            mt /= samples.size();
+
+            double a = mt, b = period, scale = 0.0;
+            for(int it = 0; it < 4; it++)
+            {
+                // Robust scale from the median absolute residual
+                residuals.clear();
+                for(const auto &s : samples)
+                    residuals.push_back(std::fabs(s.t - (a + b*(s.n - mn))));
+                auto mid = residuals.begin() + residuals.size()/2;
+                std::nth_element(residuals.begin(), mid, residuals.end());
+                scale = std::max(1.4826*(*mid), 1e-6);
+
+                double sw = 0.0, swn = 0.0, swt = 0.0, swnn = 0.0, swnt = 0.0;
+                for(const auto &s : samples)
+                {
+                    auto r = std::fabs(s.t - (a + b*(s.n - mn)));
+                    auto w = r <= p.huber*scale ? 1.0 : p.huber*scale/r;
+                    auto dn = s.n - mn;
+                    sw += w;
+                    swn += w*dn;
+                    swt += w*s.t;
+                    swnn += w*dn*dn;
+                    swnt += w*dn*s.t;
+                }
+                auto det = sw*swnn - swn*swn;
+                if(det <= 1e-12)
+                    break;
+                b = (sw*swnt - swn*swt)/det;
+                a = (swt - b*swn)/sw;
+            }
+
+            // Onto the low quantile of the residuals
+            residuals.clear();
+            for(const auto &s : samples)
+                residuals.push_back(s.t - (a + b*(s.n - mn)));
+            auto q = residuals.begin() + (size_t)(p.quantile*(residuals.size() - 1));
+            std::nth_element(residuals.begin(), q, residuals.end());
+
+            period = b;
+            offset = a - b*mn + *q;
+            jitter = scale;
+            fitted = true;
+        }
+
+        // Counts for the warm-up stamps, from the nominal period or else the
+        // median interval, which a few lost scans don't move
+        void count()
+        {
+            period = nominal;
+            if(period <= 0.0)
+            {
+                residuals.clear();
+                for(size_t i = 1; i < samples.size(); i++)
+                    residuals.push_back(samples[i].t - samples[i - 1].t);
+                auto mid = residuals.begin() + residuals.size()/2;
+                std::nth_element(residuals.begin(), mid, residuals.end());
+                period = std::max(*mid, 1e-6);
+            }
+            for(size_t i = 1; i < samples.size(); i++)
+                samples[i].n = samples[i - 1].n +
+                    std::max(std::round((samples[i].t - samples[i - 1].t)/period), 1.0);
+            last_n = samples.back().n;
+        }
+
+    public:
+        explicit ClockSync(const clock_sync_params &p)
+            : p(p)
+        {
+            // Warm-up needs an interval to count from, and the fit a window to fit
+            this->p.min_samples = std::max(p.min_samples, 2);
+            this->p.window = std::max(p.window, this->p.min_samples);
+            this->p.quantile = std::min(std::max(p.quantile, 0.0), 1.0);
+            reset();
+        }
+
+        void reset()
+        {
+            samples.clear();
+            t0 = last_n = last_t = 0.0;
+            offset = period = nominal = 0.0;
+            jitter = 0.0;
+            outliers = 0;
+            fitted = false;
+        }
+
+        /**
+         * @brief Add one stamp and correct it.
+         * @param stamp     host stamp (s)
+         * @param nominal_period    the sensor's period if known (s), otherwise <= 0
+         * @return the corrected stamp (s); the input itself until the fit has
+         *          enough samples
+         */
+        double correct(double stamp, double nominal_period)
+        {
+            if(!samples.empty() && stamp <= t0 + last_t - 0.5*std::max(period, 1e-3))
+                reset();    // time went backwards
+            if(samples.empty())
+            {
+                t0 = stamp;
+                nominal = nominal_period;
+            }
+            auto t = stamp - t0;
+
+            if(!fitted)
+            {
+                // Warming up: stamps only, counted once there are enough
+                last_t = t;
+                samples.push_back({0.0, t});
+                if((int)samples.size() < p.min_samples)
+                    return stamp;
+                count();
+                fit();
+                return t0 + offset + period*last_n;
+            }
+
+            // Periods since the first stamp, from the current line. The line
+            // is the earliest a stamp arrives, so a stamp belongs to the last
+            // tick before it, give or take a little: delays up to 3/4 of a
+            // period are counted right.
+            auto n = std::floor((t - offset)/period + 0.25);
+            if(n <= last_n || std::fabs(t - (offset + period*n)) > p.reset_error)
+            {
+                // Kept out of the fit; several in a row mean the clock jumped
+                if(++outliers >= p.reset_count)
+                {
+                    reset();
+                    return correct(stamp, nominal_period);
+                }
+                return stamp;
+            }
+            outliers = 0;
+
+            last_n = n;
+            last_t = t;
+            samples.push_back({n, t});
+            while((int)samples.size() > p.window)
+                samples.pop_front();
+
+            fit();
+            return t0 + offset + period*n;
+        }
+
+        bool ready() const { return fitted; }
+
+        // Fitted sensor period (s) and its drift from the nominal one (s/s)
+        double getPeriod() const { return period; }
+        double getDrift() const { return nominal > 0.0 ? period/nominal - 1.0 : 0.0; }
+
+        // Robust std dev of the host stamps around the line (s)
+        double getJitter() const { return jitter; }
+};
+
+} // namespace race_common
@@ -0,0 +1,227 @@
+/**
+ * @file costmap_inflation.h
+ * @brief Obstacle grid with each cell's exact Euclidean distance to the
+ *          nearest obstacle, out to a fixed radius, kept up to date
+ *          incrementally.
+ *
+ * Distances come from a separable transform: a column pass finds every
+ * cell's vertical distance to the nearest obstacle in its column, and a
+ * row pass takes the lower envelope of the parabolas dx^2 + column^2
+ * (Felzenszwalb and Huttenlocher), so the cost per cell doesn't grow with
+ * the radius. They are kept as squared cells, and anything beyond the
+ * radius reads far().
+ *
+ * A new obstacle layer is staged with clear()/mark() and applied by
+ * update(), which compares it with the previous one tile by tile and only
+ * recomputes tiles within the radius of a tile that changed. Where a scan
+ * only sees the same walls again, open space and unchanged walls cost
+ * nothing, which full recomputation can't offer at fine resolutions.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace race_common
+{
+
+class CostmapInflation
+{
+    private:
+        int width, height, radius, tile;
+        int tiles_x, tiles_y;
+        uint16_t far_d2;
+
+        std::vector<uint8_t> occ, staged;   // applied and next obstacle layers
+        std::vector<uint16_t> d2;           // squared cells, far_d2 past the radius
+        std::vector<uint8_t> dirty, affected;
+        int updated;
+
+        // Scratch for recompute()
+        std::vector<int32_t> col, v;
+        std::vector<float> z;
+
+        bool tile_changed(int tx, int ty) const
+        {
+            auto x0 = tx*tile, y0 = ty*tile;
+            auto w = std::min(tile, width - x0), y1 = std::min(y0 + tile, height);
+            for(int y = y0; y < y1; y++)
+                if(std::memcmp(&occ[(size_t)y*width + x0], &staged[(size_t)y*width + x0], w) != 0)
+                    return true;
+            return false;
+        }
+
+        // Distances for cells [x0, x1) x [y0, y1), reading obstacles within the radius around it
+        void recompute(int x0, int x1, int y0, int y1)
+        {
+            const int cap = radius + 1;
+            const int wx0 = std::max(x0 - radius, 0), wx1 = std::min(x1 + radius, width);
+            const int ww = wx1 - wx0, hh = y1 - y0;
+            col.resize((size_t)ww*hh);
+
+            // Columns: squared vertical distance to the nearest obstacle, capped
+            const int sy0 = std::max(y0 - radius, 0), sy1 = std::min(y1 + radius, height);
+            for(int x = wx0; x < wx1; x++)
+            {
+                auto out = &col[x - wx0];
+                int last = -cap - radius - 1;
+                for(int y = sy0; y < y1; y++)
+                {
+                    if(occ[(size_t)y*width + x])
+                        last = y;
+                    if(y >= y0)
+                        out[(size_t)(y - y0)*ww] = std::min(y - last, cap);
+                }
+                last = sy1 + cap + radius;
+                for(int y = sy1 - 1; y >= y0; y--)
+                {
+                    if(occ[(size_t)y*width + x])
+                        last = y;
+                    if(y < y1)
+                    {
+                        auto &c = out[(size_t)(y - y0)*ww];
+                        c = std::min(c, std::min(last - y, cap));
+                    }
+                }
+                for(int y = y0; y < y1; y++)
+                {
+                    auto &c = out[(size_t)(y - y0)*ww];
+                    c *= c;
+                }
+            }
+
+            // Rows: lower envelope of (x - q)^2 + col(q)
+            v.resize(ww);
+            z.resize(ww + 1);
+            for(int y = y0; y < y1; y++)
+            {
+                const auto g = &col[(size_t)(y - y0)*ww];
+                int k = 0;
+                v[0] = 0;
+                z[0] = -1e9f;
+                z[1] = 1e9f;
+                for(int q = 1; q < ww; q++)
+                {
+                    auto s = ((g[q] + q*q) - (g[v[k]] + v[k]*v[k]))/(2.0f*(q - v[k]));
+                    while(s <= z[k])
+                    {
+                        k--;
+                        s = ((g[q] + q*q) - (g[v[k]] + v[k]*v[k]))/(2.0f*(q - v[k]));
+                    }
+                    k++;
+                    v[k] = q;
+                    z[k] = s;
+                    z[k + 1] = 1e9f;
+                }
+
+                k = 0;
+                auto row = &d2[(size_t)y*width];
+                for(int x = x0; x < x1; x++)
+                {
+                    auto q = x - wx0;
+                    while(z[k + 1] < q)
+                        k++;
+                    auto dq = q - v[k];
+                    auto d = dq*dq + g[v[k]];
+                    row[x] = d > radius*radius ? far_d2 : (uint16_t)d;
+                }
+            }
+            updated += (x1 - x0)*(y1 - y0);
+        }
+
+    public:
+        /**
+         * @param radius    cells; distances beyond it aren't needed (at most 255)
+         * @param tile      cells per side of a change-tracking tile
+         */
+        CostmapInflation(int width, int height, int radius, int tile = 16)
+            : width(width), height(height), radius(std::min(std::max(radius, 1), 255)),
+              tile(std::max(tile, 1)), updated(0)
+        {
+            tiles_x = (width + this->tile - 1)/this->tile;
+            tiles_y = (height + this->tile - 1)/this->tile;
+            far_d2 = (uint16_t)(this->radius*this->radius + 1);
+            occ.assign((size_t)width*height, 0);
+            staged.assign(occ.size(), 0);
+            d2.assign(occ.size(), far_d2);
+            dirty.assign((size_t)tiles_x*tiles_y, 0);
+            affected.assign(dirty.size(), 0);
+        }
+
+        int getWidth() const { return width; }
+        int getHeight() const { return height; }
+        int getRadius() const { return radius; }
+
+        // Squared distance that means "beyond the radius"
+        uint16_t far() const { return far_d2; }
+
+        // Squared distance in cells from (x, y) to the nearest obstacle
+        uint16_t at(int x, int y) const { return d2[(size_t)y*width + x]; }
+        const uint16_t *data() const { return d2.data(); }
+
+        bool occupied(int x, int y) const { return occ[(size_t)y*width + x] != 0; }
+
+        // Cells recomputed by the last update()
+        int lastUpdated() const { return updated; }
+
+        // Start staging a new obstacle layer
+        void clear()
+        {
+            std::fill(staged.begin(), staged.end(), 0);
+        }
+
+        void mark(int x, int y)
+        {
+            staged[(size_t)y*width + x] = 1;
+        }
+
+        /**
+         * @brief Apply the staged layer, recomputing distances only around
+         *          tiles that changed.
+         */
+        void update()
+        {
+            updated = 0;
+            bool any = false;
+            for(int ty = 0; ty < tiles_y; ty++)
+                for(int tx = 0; tx < tiles_x; tx++)
+                {
+                    auto c = tile_changed(tx, ty);
+                    dirty[ty*tiles_x + tx] = c;
+                    any |= c;
+                }
+            if(!any)
+                return;
+            occ.swap(staged);
+
+            // Tiles a changed cell's radius can reach
+            const int reach = (radius + tile - 1)/tile;
+            std::fill(affected.begin(), affected.end(), 0);
+            for(int ty = 0; ty < tiles_y; ty++)
+                for(int tx = 0; tx < tiles_x; tx++)
+                {
+                    if(!dirty[ty*tiles_x + tx])
+                        continue;
+                    for(int y = std::max(ty - reach, 0); y <= std::min(ty + reach, tiles_y - 1); y++)
+                        for(int x = std::max(tx - reach, 0); x <= std::min(tx + reach, tiles_x - 1); x++)
+                            affected[y*tiles_x + x] = 1;
+                }
+
+            // One rectangle per run of affected tiles along a tile row
+            for(int ty = 0; ty < tiles_y; ty++)
+                for(int tx = 0; tx < tiles_x; tx++)
+                {
+                    if(!affected[ty*tiles_x + tx])
+                        continue;
+                    auto end = tx;
+                    while(end < tiles_x && affected[ty*tiles_x + end])
+                        end++;
+                    recompute(tx*tile, std::min(end*tile, width), ty*tile, std::min((ty + 1)*tile, height));
+                    tx = end;
+                }
+        }
+};
+
+} // namespace race_common
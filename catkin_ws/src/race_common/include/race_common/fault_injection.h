@@ -0,0 +1,172 @@
+/**
+ * @file fault_injection.h
+ * @brief Sensor faults and delays applied between recorded or simulated
+ *          inputs and the nodes under test (see fault_injector.cpp).
+ *
+ * Every stream gets the same timing faults: a fixed latency plus uniform
+ * jitter before delivery (order is kept, like a real transport), and a
+ * sensor clock that is off by an offset and drifts. Scans additionally get
+ * range noise, single beam dropouts, burst dropouts over a run of
+ * neighbouring beams and lost scans. Everything draws from one seeded
+ * generator, so a replay with the same seed sees the same faults.
+ */
+#pragma once
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace race_common
+{
+
+struct stream_faults
+{
+    double latency;         // s added before delivery
+    double jitter;          // s, uniform on top of the latency
+    double clock_offset;    // s added to header stamps
+    double clock_drift;     // s per s (1e-4 = 100 ppm), grows from the first message
+    double drop;            // probability a message is lost
+};
+
+struct scan_faults
+{
+    double range_noise;     // std dev of gaussian noise on valid ranges (m)
+    double beam_dropout;    // probability a single beam returns dropout_range
+    double burst_prob;      // probability per scan of a burst dropout
+    int burst_beams;        // width of a burst
+    float dropout_range;    // what a dropped beam reads (inf, NaN, 0, ...)
+};
+
+inline stream_faults load_stream_faults(const ros::NodeHandle &n, const std::string &prefix)
+{
+    stream_faults f;
+    n.param(prefix + "_latency", f.latency, 0.0);
+    n.param(prefix + "_jitter", f.jitter, 0.0);
+    n.param(prefix + "_clock_offset", f.clock_offset, 0.0);
+    n.param(prefix + "_clock_drift", f.clock_drift, 0.0);
+    n.param(prefix + "_drop", f.drop, 0.0);
+    return f;
+}
+
+inline scan_faults load_scan_faults(const ros::NodeHandle &n)
+{
+    scan_faults f;
+    double dropout_range;
+    n.param("fault_range_noise", f.range_noise, 0.0);
+    n.param("fault_beam_dropout", f.beam_dropout, 0.0);
+    n.param("fault_burst_prob", f.burst_prob, 0.0);
+    n.param("fault_burst_beams", f.burst_beams, 30);
+    n.param("fault_dropout_range", dropout_range, (double)std::numeric_limits<float>::infinity());
+    f.dropout_range = dropout_range;
+    return f;
+}
+
+/**
+ * @brief Noise and dropouts on `scan`'s ranges, in place.
+ */
+template <typename Rng>
+void corrupt_scan(sensor_msgs::LaserScan &scan, const scan_faults &f, Rng &rng)
+{
+    auto &r = scan.ranges;
+    if(r.empty())
+        return;
+
+    if(f.range_noise > 0.0)
+    {
+        std::normal_distribution<float> noise(0.0f, f.range_noise);
+        for(auto &x : r)
+            if(x >= scan.range_min && x <= scan.range_max)
+                x = std::min(std::max(x + noise(rng), scan.range_min), scan.range_max);
+    }
+
+    if(f.beam_dropout >= 1.0)
+    {
+        std::fill(r.begin(), r.end(), f.dropout_range);
+    } else if(f.beam_dropout > 0.0)
+    {
+        // Skip straight to the next dropped beam instead of a draw per beam
+        std::geometric_distribution<size_t> gap(f.beam_dropout);
+        for(auto i = gap(rng); i < r.size(); i += gap(rng) + 1)
+            r[i] = f.dropout_range;
+    }
+
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    if(f.burst_beams > 0 && u(rng) < f.burst_prob)
+    {
+        auto first = std::uniform_int_distribution<size_t>(0, r.size() - 1)(rng);
+        for(size_t k = 0; k < (size_t)f.burst_beams; k++)
+            r[(first + k) % r.size()] = f.dropout_range;
+    }
+}
+
+/**
+ * @brief Holds messages until their release time, in arrival order.
+ */
+template <typename Msg>
+class DelayLine
+{
+    private:
+        stream_faults f;
+        std::deque<std::pair<ros::Time, Msg>> queue;
+        ros::Time last_release, first_stamp;
+
+    public:
+        explicit DelayLine(const stream_faults &f) : f(f) {}
+
+        const stream_faults &faults() const
+        {
+            return f;
+        }
+
+        // Sensor time for a message stamped `stamp`
+        ros::Time skew(const ros::Time &stamp)
+        {
+            if(first_stamp.isZero())
+                first_stamp = stamp;
+            auto shift = f.clock_offset + f.clock_drift*(stamp - first_stamp).toSec();
+            return stamp.toSec() + shift > 0.0 ? stamp + ros::Duration(shift) : stamp;
+        }
+
+        // Queue `msg`, received at `now`; false if it was dropped
+        template <typename Rng>
+        bool push(const ros::Time &now, Msg msg, Rng &rng)
+        {
+            std::uniform_real_distribution<double> u(0.0, 1.0);
+            if(f.drop > 0.0 && u(rng) < f.drop)
+                return false;
+
+            auto release = now + ros::Duration(f.latency + f.jitter*u(rng));
+            if(release < last_release)
+                release = last_release;
+            last_release = release;
+            queue.emplace_back(release, std::move(msg));
+            return true;
+        }
+
+        // Hand every message due by `now` to `deliver`
+        template <typename Fn>
+        void flush(const ros::Time &now, Fn deliver)
+        {
+            while(!queue.empty() && !(now < queue.front().first))
+            {
+                deliver(queue.front().second);
+                queue.pop_front();
+            }
+        }
+
+        // Forget everything, e.g. when a bag loops and time jumps back
+        void clear()
+        {
+            queue.clear();
+            last_release = first_stamp = ros::Time();
+        }
+};
+
+} // namespace race_common
@@ -0,0 +1,141 @@
+/**
+ * @file fixed_matrix.h
+ * @brief Small matrices with sizes fixed at compile time, stored inline.
+ *
+ * Meant for filters with a handful of states: nothing is allocated, the
+ * loops have constant trip counts the compiler can unroll, and a size
+ * mismatch is a compile error instead of a runtime one.
+ */
+#pragma once
+
+#include <cmath>
+#include <utility>
+
+namespace race_common
+{
+
+template <int R, int C>
+struct Matrix
+{
+    double m[R][C];
+
+    static Matrix zeros()
+    {
+        Matrix a;
+        for(int i = 0; i < R; i++)
+            for(int j = 0; j < C; j++)
+                a.m[i][j] = 0.0;
+        return a;
+    }
+
+    static Matrix identity()
+    {
+        static_assert(R == C, "identity of a non-square matrix");
+        auto a = zeros();
+        for(int i = 0; i < R; i++)
+            a.m[i][i] = 1.0;
+        return a;
+    }
+
+    double &operator()(int i, int j) { return m[i][j]; }
+    double operator()(int i, int j) const { return m[i][j]; }
+
+    Matrix<C, R> transpose() const
+    {
+        Matrix<C, R> t;
+        for(int i = 0; i < R; i++)
+            for(int j = 0; j < C; j++)
+                t.m[j][i] = m[i][j];
+        return t;
+    }
+
+    Matrix &operator+=(const Matrix &b)
+    {
+        for(int i = 0; i < R; i++)
+            for(int j = 0; j < C; j++)
+                m[i][j] += b.m[i][j];
+        return *this;
+    }
+
+    Matrix &operator-=(const Matrix &b)
+    {
+        for(int i = 0; i < R; i++)
+            for(int j = 0; j < C; j++)
+                m[i][j] -= b.m[i][j];
+        return *this;
+    }
+
+    Matrix operator+(const Matrix &b) const { auto a = *this; return a += b; }
+    Matrix operator-(const Matrix &b) const { auto a = *this; return a -= b; }
+
+    template <int K>
+    Matrix<R, K> operator*(const Matrix<C, K> &b) const
+    {
+        auto a = Matrix<R, K>::zeros();
+        for(int i = 0; i < R; i++)
+            for(int k = 0; k < C; k++)
+                for(int j = 0; j < K; j++)
+                    a.m[i][j] += m[i][k]*b.m[k][j];
+        return a;
+    }
+
+    // Average with the transpose, to undo rounding drift in covariances
+    void symmetrize()
+    {
+        static_assert(R == C, "symmetrize of a non-square matrix");
+        for(int i = 0; i < R; i++)
+            for(int j = i + 1; j < C; j++)
+                m[i][j] = m[j][i] = 0.5*(m[i][j] + m[j][i]);
+    }
+
+    /**
+     * @brief Gauss-Jordan inverse with partial pivoting.
+     *
+     * @return false (and leaves `out` undefined) if the matrix is singular
+     */
+    bool inverse(Matrix &out) const
+    {
+        static_assert(R == C, "inverse of a non-square matrix");
+        auto a = *this;
+        out = identity();
+        for(int c = 0; c < R; c++)
+        {
+            auto pivot = c;
+            for(int i = c + 1; i < R; i++)
+                if(std::fabs(a.m[i][c]) > std::fabs(a.m[pivot][c]))
+                    pivot = i;
+            if(std::fabs(a.m[pivot][c]) < 1e-12)
+                return false;
+            if(pivot != c)
+                for(int j = 0; j < C; j++)
+                {
+                    std::swap(a.m[c][j], a.m[pivot][j]);
+                    std::swap(out.m[c][j], out.m[pivot][j]);
+                }
+
+            auto inv = 1.0/a.m[c][c];
+            for(int j = 0; j < C; j++)
+            {
+                a.m[c][j] *= inv;
+                out.m[c][j] *= inv;
+            }
+            for(int i = 0; i < R; i++)
+            {
+                if(i == c || a.m[i][c] == 0.0)
+                    continue;
+                auto f = a.m[i][c];
+                for(int j = 0; j < C; j++)
+                {
+                    a.m[i][j] -= f*a.m[c][j];
+                    out.m[i][j] -= f*out.m[c][j];
+                }
+            }
+        }
+        return true;
+    }
+};
+
+template <int N>
+using Vector = Matrix<N, 1>;
+
+} // namespace race_common
@@ -0,0 +1,257 @@
+/**
+ * @file laser_scan_view.h
+ * @brief A read-only LaserScan whose arrays live in recycled storage, so
+ *          receiving a scan allocates nothing once the node has warmed up.
+ *
+ * Subscribing with `sensor_msgs::LaserScan` deserializes both arrays into
+ * freshly allocated vectors for every message. LaserScanView is wire
+ * compatible with sensor_msgs/LaserScan (same md5sum, datatype and
+ * definition), so it can be used on any /scan subscriber in its place:
+ *
+ *     sub = n.subscribe("/scan", 1, &Node::scan_cb, this);
+ *     void scan_cb(const race_common::LaserScanView &msg);
+ *
+ * roscpp frees the receive buffer before the callback runs, so the arrays
+ * are copied out of it, into vectors owned by the view. Views come from a
+ * process-wide free list and go back to it when the last reference drops,
+ * keeping their vectors' capacity, so after the first few scans the copy
+ * is a plain memcpy into memory that is already there. `ranges` and
+ * `intensities` are spans over those vectors (or over a LaserScan, see
+ * makeView()), valid for as long as the view is.
+ */
+#pragma once
+
+#include <ros/ros.h>
+#include <ros/message_event.h>
+#include <ros/message_traits.h>
+#include <ros/serialization.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace race_common
+{
+
+// Just enough of std::span (C++20) for the scan kernels
+template <typename T>
+class span
+{
+    private:
+        T *ptr;
+        size_t len;
+
+    public:
+        span() : ptr(nullptr), len(0) {}
+        span(T *ptr, size_t len) : ptr(ptr), len(len) {}
+
+        T *data() const { return ptr; }
+        size_t size() const { return len; }
+        bool empty() const { return len == 0; }
+        T &operator[](size_t i) const { return ptr[i]; }
+        T *begin() const { return ptr; }
+        T *end() const { return ptr + len; }
+};
+
+struct LaserScanView
+{
+    typedef boost::shared_ptr<LaserScanView> Ptr;
+    typedef boost::shared_ptr<LaserScanView const> ConstPtr;
+
+    std_msgs::Header header;
+    float angle_min, angle_max, angle_increment;
+    float time_increment, scan_time;
+    float range_min, range_max;
+    span<const float> ranges, intensities;
+
+    // Storage behind the spans of a received view
+    std::vector<float> owned_ranges, owned_intensities;
+
+    LaserScanView() = default;
+
+    // A copy owns its own storage: spans into `o`'s vectors are re-pointed
+    // at the copies, spans over a LaserScan (makeView) are shared
+    LaserScanView(const LaserScanView &o)
+    {
+        *this = o;
+    }
+
+    LaserScanView &operator=(const LaserScanView &o)
+    {
+        header = o.header;
+        angle_min = o.angle_min;
+        angle_max = o.angle_max;
+        angle_increment = o.angle_increment;
+        time_increment = o.time_increment;
+        scan_time = o.scan_time;
+        range_min = o.range_min;
+        range_max = o.range_max;
+        owned_ranges = o.owned_ranges;
+        owned_intensities = o.owned_intensities;
+        ranges = rebase(o.ranges, o.owned_ranges, owned_ranges);
+        intensities = rebase(o.intensities, o.owned_intensities, owned_intensities);
+        return *this;
+    }
+
+    // Moving a vector keeps its buffer, so the spans stay valid
+    LaserScanView(LaserScanView &&) = default;
+    LaserScanView &operator=(LaserScanView &&) = default;
+
+    // `s` moved from `from` to `to` if it points into `from`
+    static span<const float> rebase(span<const float> s, const std::vector<float> &from,
+                                    const std::vector<float> &to)
+    {
+        return s.data() == from.data() ? span<const float>(to.data(), s.size()) : s;
+    }
+};
+
+// Free list of received views; see DefaultMessageCreator below
+class LaserScanViewPool
+{
+    private:
+        std::mutex m;
+        std::vector<std::unique_ptr<LaserScanView>> spare;
+
+        // Enough for every scan a node can have in flight at once
+        static const size_t max_free = 16;
+
+        void give(LaserScanView *v)
+        {
+            std::unique_ptr<LaserScanView> owned(v);
+            std::lock_guard<std::mutex> lock(m);
+            if(spare.size() < max_free)
+                spare.push_back(std::move(owned));
+        }
+
+    public:
+        // Never destroyed, so views released during shutdown still have a home
+        static LaserScanViewPool &instance()
+        {
+            static auto pool = new LaserScanViewPool;
+            return *pool;
+        }
+
+        boost::shared_ptr<LaserScanView> take()
+        {
+            std::unique_ptr<LaserScanView> v;
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if(!spare.empty())
+                {
+                    v = std::move(spare.back());
+                    spare.pop_back();
+                }
+            }
+            if(!v)
+                v.reset(new LaserScanView);
+            return boost::shared_ptr<LaserScanView>(v.release(), [this](LaserScanView *p) { give(p); });
+        }
+};
+
+// View over an already deserialized scan (replay, simulation, tests); only
+// valid while `msg` is
+inline LaserScanView makeView(const sensor_msgs::LaserScan &msg)
+{
+    LaserScanView v;
+    v.header = msg.header;
+    v.angle_min = msg.angle_min;
+    v.angle_max = msg.angle_max;
+    v.angle_increment = msg.angle_increment;
+    v.time_increment = msg.time_increment;
+    v.scan_time = msg.scan_time;
+    v.range_min = msg.range_min;
+    v.range_max = msg.range_max;
+    v.ranges = span<const float>(msg.ranges.data(), msg.ranges.size());
+    v.intensities = span<const float>(msg.intensities.data(), msg.intensities.size());
+    return v;
+}
+
+} // namespace race_common
+
+namespace ros
+{
+
+// Subscribers get their views from the pool instead of a new allocation
+template <>
+struct DefaultMessageCreator<race_common::LaserScanView>
+{
+    boost::shared_ptr<race_common::LaserScanView> operator()()
+    {
+        return race_common::LaserScanViewPool::instance().take();
+    }
+};
+
+namespace message_traits
+{
+
+// Present exactly as sensor_msgs/LaserScan so publishers accept the connection
+template <> struct IsMessage<race_common::LaserScanView> : TrueType {};
+template <> struct IsMessage<const race_common::LaserScanView> : TrueType {};
+template <> struct HasHeader<race_common::LaserScanView> : TrueType {};
+template <> struct HasHeader<const race_common::LaserScanView> : TrueType {};
+
+template <>
+struct MD5Sum<race_common::LaserScanView>
+{
+    static const char *value() { return MD5Sum<sensor_msgs::LaserScan>::value(); }
+    static const char *value(const race_common::LaserScanView &) { return value(); }
+};
+
+template <>
+struct DataType<race_common::LaserScanView>
+{
+    static const char *value() { return DataType<sensor_msgs::LaserScan>::value(); }
+    static const char *value(const race_common::LaserScanView &) { return value(); }
+};
+
+template <>
+struct Definition<race_common::LaserScanView>
+{
+    static const char *value() { return Definition<sensor_msgs::LaserScan>::value(); }
+    static const char *value(const race_common::LaserScanView &) { return value(); }
+};
+
+} // namespace message_traits
+
+namespace serialization
+{
+
+template <>
+struct Serializer<race_common::LaserScanView>
+{
+    // Copies `count` floats out of the stream into `owned`, which the
+    // receive buffer doesn't outlive, and points `out` at them
+    template <typename Stream>
+    inline static void readFloats(Stream &stream, race_common::span<const float> &out,
+                                  std::vector<float> &owned)
+    {
+        uint32_t count;
+        stream.next(count);
+        auto bytes = stream.advance(count*sizeof(float));
+
+        owned.resize(count);
+        std::memcpy(owned.data(), bytes, count*sizeof(float));
+        out = race_common::span<const float>(owned.data(), count);
+    }
+
+    template <typename Stream>
+    inline static void read(Stream &stream, race_common::LaserScanView &m)
+    {
+        stream.next(m.header);
+        stream.next(m.angle_min);
+        stream.next(m.angle_max);
+        stream.next(m.angle_increment);
+        stream.next(m.time_increment);
+        stream.next(m.scan_time);
+        stream.next(m.range_min);
+        stream.next(m.range_max);
+        readFloats(stream, m.ranges, m.owned_ranges);
+        readFloats(stream, m.intensities, m.owned_intensities);
+    }
+};
+
+} // namespace serialization
+} // namespace ros
@@ -0,0 +1,134 @@
+/**
+ * @file lidar_health.h
+ * @brief One-pass scan health checks: invalid beams per sector, frozen
+ *          data and persistently blocked sectors.
+ *
+ * Every beam is visited once. It is counted as invalid (NaN, inf, outside
+ * [range_min, range_max]) or blocked (a valid return closer than
+ * `block_range`, e.g. a cable in view), and its raw bits are folded into
+ * a 64-bit hash. A real lidar never returns the exact same ranges twice,
+ * so an unchanged hash means the driver is republishing old data. A sector
+ * whose blocked fraction stays above `block_ratio` for `block_time` is
+ * reported as blocked (dirty lens, something mounted in view).
+ */
+#pragma once
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace race_common
+{
+
+struct lidar_health_params
+{
+    int sectors;
+    double block_range;     // closer returns count as blocked (m)
+    double block_ratio;     // blocked fraction that makes a sector suspect
+    double block_time;      // how long a sector must stay suspect (s)
+    int frozen_scans;       // repeats of the previous scan that mean frozen
+};
+
+struct lidar_health
+{
+    bool frozen;
+    float invalid_ratio;
+    std::vector<float> sector_invalid;
+    std::vector<uint8_t> sector_blocked;
+
+    bool healthy() const
+    {
+        return !frozen && std::find(sector_blocked.begin(), sector_blocked.end(), 1) == sector_blocked.end();
+    }
+};
+
+class LidarHealthMonitor
+{
+    private:
+        lidar_health_params p;
+        lidar_health health;
+        std::vector<ros::Time> suspect_since;   // zero while the sector looks fine
+        uint64_t last_hash;
+        int repeats;
+
+        static inline uint64_t mix(uint64_t h, uint32_t bits)
+        {
+            return (h ^ bits)*0x100000001b3ull;
+        }
+
+    public:
+        explicit LidarHealthMonitor(const lidar_health_params &p)
+            : p(p), last_hash(0), repeats(0)
+        {
+            this->p.sectors = std::max(p.sectors, 1);
+            health.frozen = false;
+            health.invalid_ratio = 0.0f;
+            health.sector_invalid.assign(this->p.sectors, 0.0f);
+            health.sector_blocked.assign(this->p.sectors, 0);
+            suspect_since.assign(this->p.sectors, ros::Time());
+        }
+
+        /**
+         * @tparam Scan  sensor_msgs::LaserScan or race_common::LaserScanView
+         */
+        template <typename Scan>
+        const lidar_health &update(const Scan &msg)
+        {
+            const auto n = msg.ranges.size();
+            const auto lo = msg.range_min, hi = msg.range_max;
+            const auto near = std::max((float)p.block_range, lo);
+            uint64_t hash = 0xcbf29ce484222325ull;
+            size_t total_invalid = 0;
+
+            for(int s = 0; s < p.sectors; s++)
+            {
+                auto first = n*s/p.sectors, last = n*(s + 1)/p.sectors;
+                size_t invalid = 0, blocked = 0;
+                for(auto i = first; i < last; i++)
+                {
+                    auto r = msg.ranges[i];
+                    uint32_t bits;
+                    std::memcpy(&bits, &r, sizeof(bits));
+                    hash = mix(hash, bits);
+
+                    // NaN fails both compares, inf fails the upper one
+                    auto valid = r >= lo && r <= hi;
+                    invalid += !valid;
+                    // No return is open space as often as a fault; that's sector_invalid's
+                    blocked += valid && r < near;
+                }
+                total_invalid += invalid;
+
+                auto count = std::max<size_t>(last - first, 1);
+                health.sector_invalid[s] = (float)invalid/count;
+
+                if((double)blocked/count >= p.block_ratio)
+                {
+                    if(suspect_since[s].isZero())
+                        suspect_since[s] = msg.header.stamp;
+                    health.sector_blocked[s] = (msg.header.stamp - suspect_since[s]).toSec() >= p.block_time;
+                } else
+                {
+                    suspect_since[s] = ros::Time();
+                    health.sector_blocked[s] = 0;
+                }
+            }
+
+            repeats = n > 0 && hash == last_hash ? repeats + 1 : 0;
+            last_hash = hash;
+            health.frozen = repeats >= p.frozen_scans;
+            health.invalid_ratio = n > 0 ? (float)total_invalid/n : 1.0f;
+            return health;
+        }
+
+        const lidar_health &get() const
+        {
+            return health;
+        }
+};
+
+} // namespace race_common
@@ -0,0 +1,636 @@
+/**
+ * @file scan_codec.h
+ * @brief Compressed scan archive: a streaming LaserScan codec and the file
+ *          it writes (.scnz), far smaller than the same scans in a bag.
+ *
+ * Ranges are quantized to `quantum` (pick the sensor's precision; the error
+ * is at most quantum/2), then every beam is predicted from beams already
+ * coded and only the residual is stored. Per block of BLOCK beams the
+ * encoder picks whichever predictor does best there:
+ *   SPATIAL   the previous beam of this scan (smooth walls, a moving car)
+ *   TEMPORAL  the same beam of the previous scan (a static scene)
+ *   GRADIENT  the previous beam plus how this beam changed since the
+ *             previous scan relative to it (scene sliding past the car)
+ * The residuals are zigzagged and Rice coded with a per-block parameter,
+ * which is a few shifts per beam to decode.
+ *
+ * Every `key_interval` scans, and whenever the layout changes, a key
+ * frame only uses SPATIAL, so a reader can start there or recover after
+ * a damaged record. NaN and +inf ranges get codes of their own and come
+ * back as they went in; intensities, when present, are coded the same
+ * way with their own quantum.
+ */
+#pragma once
+
+#include <sensor_msgs/LaserScan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace race_common
+{
+
+struct scan_archive_header
+{
+    char magic[4];          // "SCNZ"
+    uint32_t version;
+};
+
+struct scan_record_header
+{
+    uint32_t payload_bytes; // after this header (and the frame id)
+    uint32_t flags;
+    int32_t sec;
+    uint32_t nsec;
+    uint32_t num_beams;
+    float angle_min, angle_increment;
+    float time_increment, scan_time;
+    float range_min, range_max;
+    float quantum, intensity_quantum;
+    uint32_t frame_id_len;  // frame id follows on key frames only
+};
+
+enum scan_record_flags
+{
+    SCAN_KEY_FRAME = 1,
+    SCAN_HAS_INTENSITIES = 2,
+};
+
+struct scan_codec_params
+{
+    float quantum;              // m per range step
+    float intensity_quantum;    // intensity units per step
+    int key_interval;           // scans between key frames
+};
+
+// Appends bits least significant first
+class BitWriter
+{
+    private:
+        std::vector<uint8_t> &out;
+        uint64_t acc;
+        int bits;
+
+    public:
+        explicit BitWriter(std::vector<uint8_t> &out) : out(out), acc(0), bits(0) {}
+
+        // n <= 32
+        void put(uint32_t v, int n)
+        {
+            acc |= (uint64_t)v << bits;
+            bits += n;
+            while(bits >= 8)
+            {
+                out.push_back((uint8_t)acc);
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+
+        void flush()
+        {
+            if(bits > 0)
+                out.push_back((uint8_t)acc);
+            acc = 0;
+            bits = 0;
+        }
+};
+
+// Reads past the end as zeros; check overrun() once done
+class BitReader
+{
+    private:
+        const uint8_t *p, *end;
+        uint64_t acc;
+        int bits;
+        size_t consumed, size_bits;
+
+        void refill()
+        {
+            while(bits <= 56)
+            {
+                if(p < end)
+                    acc |= (uint64_t)*p++ << bits;
+                bits += 8;
+            }
+        }
+
+    public:
+        BitReader(const uint8_t *data, size_t size)
+            : p(data), end(data + size), acc(0), bits(0), consumed(0), size_bits(8*size) {}
+
+        // n <= 32
+        uint32_t get(int n)
+        {
+            if(bits < n)
+                refill();
+            auto v = (uint32_t)(acc & ((1ull << n) - 1));
+            acc >>= n;
+            bits -= n;
+            consumed += n;
+            return v;
+        }
+
+        // Ones before the next zero (consumed), up to `limit`
+        int unary(int limit)
+        {
+            if(bits < limit + 1)
+                refill();
+            auto zeros = ~acc;
+            int ones = zeros ? __builtin_ctzll(zeros) : 64;
+            if(ones >= limit)
+            {
+                acc >>= limit;
+                bits -= limit;
+                consumed += limit;
+                return limit;
+            }
+            acc >>= ones + 1;
+            bits -= ones + 1;
+            consumed += ones + 1;
+            return ones;
+        }
+
+        // Read past the end of the data
+        bool overrun() const
+        {
+            return consumed > size_bits;
+        }
+};
+
+class ScanCodec
+{
+    public:
+        static constexpr uint32_t VERSION = 1;
+        static constexpr int BLOCK = 32;
+        static constexpr int ESCAPE = 24;      // unary length that escapes to a raw word
+
+        enum predictor { SPATIAL, TEMPORAL, GRADIENT };
+
+        // Range codes: NaN and +inf are reserved, the rest are steps above 0
+        static constexpr int32_t CODE_NAN = 0, CODE_INF = 1, CODE_ZERO = 2;
+
+        // Codes are clamped so predictions and residuals can't overflow
+        static constexpr float MAX_CODE = 1e8f;
+
+        static int32_t quantize_range(float r, float inv_quantum)
+        {
+            if(std::isnan(r) || r < 0.0f)
+                return CODE_NAN;
+            if(std::isinf(r))
+                return CODE_INF;
+            auto q = r*inv_quantum + 0.5f;
+            return CODE_ZERO + (int32_t)(q < MAX_CODE ? q : MAX_CODE);
+        }
+
+        static float range(int32_t code, float quantum)
+        {
+            if(code == CODE_NAN)
+                return std::numeric_limits<float>::quiet_NaN();
+            if(code == CODE_INF)
+                return std::numeric_limits<float>::infinity();
+            return (code - CODE_ZERO)*quantum;
+        }
+
+        static int32_t quantize_intensity(float x, float inv_quantum)
+        {
+            if(!std::isfinite(x))
+                return 0;
+            auto q = x*inv_quantum;
+            return (int32_t)std::lround(q > MAX_CODE ? MAX_CODE : (q < -MAX_CODE ? -MAX_CODE : q));
+        }
+
+        static uint32_t zigzag(int32_t v)
+        {
+            return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+        }
+
+        static int32_t unzigzag(uint32_t u)
+        {
+            return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+        }
+
+        static int64_t predict(predictor p, const int32_t *cur, const int32_t *prev, size_t i)
+        {
+            int64_t left = i > 0 ? cur[i - 1] : (prev ? prev[0] : CODE_ZERO);
+            switch(p)
+            {
+                case TEMPORAL:
+                    return prev[i];
+                case GRADIENT:
+                    return i > 0 ? left + prev[i] - (int64_t)prev[i - 1] : prev[i];
+                default:
+                    return left;
+            }
+        }
+
+        /**
+         * @brief Code `n` values of one channel against the previous scan's
+         *          (`prev`, null on key frames).
+         */
+        static void encode(const int32_t *cur, const int32_t *prev, size_t n, BitWriter &w)
+        {
+            uint32_t res[3][BLOCK];
+            for(size_t b = 0; b < n; b += BLOCK)
+            {
+                auto len = std::min(n - b, (size_t)BLOCK);
+
+                // Cheapest predictor by its residuals' sum, a proxy for the Rice cost
+                int best = SPATIAL;
+                uint64_t best_sum = std::numeric_limits<uint64_t>::max();
+                for(int p = SPATIAL; p <= (prev ? GRADIENT : SPATIAL); p++)
+                {
+                    uint64_t sum = 0;
+                    for(size_t i = 0; i < len; i++)
+                    {
+                        res[p][i] = zigzag((int32_t)(cur[b + i] - predict((predictor)p, cur, prev, b + i)));
+                        sum += res[p][i];
+                    }
+                    if(sum < best_sum)
+                    {
+                        best_sum = sum;
+                        best = p;
+                    }
+                }
+
+                // Rice parameter: near log2 of the mean residual, then the
+                // exact cost of its neighbours decides
+                auto mean = best_sum/len;
+                int k = 0;
+                while(k < 31 && (2ull << k) <= mean)
+                    k++;
+                auto cost = [&](int k) {
+                    uint64_t bits = len*(k + 1);
+                    for(size_t i = 0; i < len; i++)
+                        bits += std::min(res[best][i] >> k, (uint32_t)ESCAPE + 32);
+                    return bits;
+                };
+                auto lo = k > 0 ? k - 1 : k, hi = k < 31 ? k + 1 : k;
+                auto c = cost(k);
+                for(int j = lo; j <= hi; j += 2)
+                {
+                    auto cj = cost(j);
+                    if(cj < c)
+                    {
+                        c = cj;
+                        k = j;
+                    }
+                }
+
+                w.put(best, 2);
+                w.put(k, 5);
+                for(size_t i = 0; i < len; i++)
+                {
+                    auto u = res[best][i];
+                    auto q = u >> k;
+                    if(q < (uint32_t)ESCAPE)
+                    {
+                        w.put((1u << q) - 1, q + 1);
+                        if(k > 0)
+                            w.put(u & ((1u << k) - 1), k);
+                    } else
+                    {
+                        w.put((1u << ESCAPE) - 1, ESCAPE);
+                        w.put(u, 32);
+                    }
+                }
+            }
+        }
+
+        static void decode(int32_t *cur, const int32_t *prev, size_t n, BitReader &r)
+        {
+            for(size_t b = 0; b < n; b += BLOCK)
+            {
+                auto len = std::min(n - b, (size_t)BLOCK);
+                auto p = (predictor)r.get(2);
+                int k = r.get(5);
+                if(!prev && p != SPATIAL)
+                    p = SPATIAL;    // damaged; the caller sees the overrun or garbage
+                for(size_t i = b; i < b + len; i++)
+                {
+                    uint32_t u;
+                    auto q = r.unary(ESCAPE);
+                    if(q < ESCAPE)
+                        u = ((uint32_t)q << k) | (k > 0 ? r.get(k) : 0);
+                    else
+                        u = r.get(32);
+                    cur[i] = (int32_t)(predict(p, cur, prev, i) + unzigzag(u));
+                }
+            }
+        }
+};
+
+/**
+ * @brief Streaming encoder: one record per scan, carrying state (the
+ *          previous scan's codes) from one to the next.
+ */
+class ScanEncoder
+{
+    private:
+        scan_codec_params p;
+        std::vector<int32_t> ranges, intensities, prev_ranges, prev_intensities;
+        std::string prev_frame;
+        float prev_min, prev_inc;
+        int since_key;
+
+    public:
+        explicit ScanEncoder(const scan_codec_params &p)
+            : p(p), prev_min(0.0f), prev_inc(0.0f), since_key(-1) {}
+
+        // Next scan is a key frame
+        void reset()
+        {
+            since_key = -1;
+        }
+
+        void encode(const sensor_msgs::LaserScan &scan, std::vector<uint8_t> &out)
+        {
+            const auto n = scan.ranges.size();
+            const bool has_intensities = scan.intensities.size() == n && n > 0;
+            const bool key = since_key < 0 || since_key + 1 >= p.key_interval ||
+                             n != prev_ranges.size() || scan.angle_min != prev_min ||
+                             scan.angle_increment != prev_inc || scan.header.frame_id != prev_frame ||
+                             has_intensities != (prev_intensities.size() == n);
+            since_key = key ? 0 : since_key + 1;
+
+            scan_record_header hdr;
+            hdr.flags = (key ? SCAN_KEY_FRAME : 0) | (has_intensities ? SCAN_HAS_INTENSITIES : 0);
+            hdr.sec = scan.header.stamp.sec;
+            hdr.nsec = scan.header.stamp.nsec;
+            hdr.num_beams = n;
+            hdr.angle_min = scan.angle_min;
+            hdr.angle_increment = scan.angle_increment;
+            hdr.time_increment = scan.time_increment;
+            hdr.scan_time = scan.scan_time;
+            hdr.range_min = scan.range_min;
+            hdr.range_max = scan.range_max;
+            hdr.quantum = p.quantum;
+            hdr.intensity_quantum = p.intensity_quantum;
+            hdr.frame_id_len = key ? scan.header.frame_id.size() : 0;
+
+            auto start = out.size();
+            out.resize(start + sizeof(hdr));
+            out.insert(out.end(), scan.header.frame_id.begin(), scan.header.frame_id.begin() + hdr.frame_id_len);
+            auto payload = out.size();
+
+            ranges.resize(n);
+            auto inv = 1.0f/p.quantum;
+            for(size_t i = 0; i < n; i++)
+                ranges[i] = ScanCodec::quantize_range(scan.ranges[i], inv);
+            BitWriter w(out);
+            ScanCodec::encode(ranges.data(), key ? nullptr : prev_ranges.data(), n, w);
+            if(has_intensities)
+            {
+                intensities.resize(n);
+                auto inv_i = 1.0f/p.intensity_quantum;
+                for(size_t i = 0; i < n; i++)
+                    intensities[i] = ScanCodec::quantize_intensity(scan.intensities[i], inv_i);
+                ScanCodec::encode(intensities.data(), key ? nullptr : prev_intensities.data(), n, w);
+            } else
+            {
+                intensities.clear();
+            }
+            w.flush();
+
+            hdr.payload_bytes = out.size() - payload;
+            std::memcpy(&out[start], &hdr, sizeof(hdr));
+
+            ranges.swap(prev_ranges);
+            intensities.swap(prev_intensities);
+            prev_frame = scan.header.frame_id;
+            prev_min = scan.angle_min;
+            prev_inc = scan.angle_increment;
+        }
+};
+
+class ScanDecoder
+{
+    private:
+        std::vector<int32_t> ranges, intensities, prev_ranges, prev_intensities;
+        std::string frame;
+        bool synced;
+
+    public:
+        ScanDecoder() : synced(false) {}
+
+        /**
+         * @brief Decode the record with header `hdr`, whose frame id and
+         *          payload are at `data`, into `scan`.
+         * @return false if it can't be decoded (a delta frame with no key
+         *          frame before it, or a damaged record); decoding resumes
+         *          at the next key frame
+         */
+        bool decode(const scan_record_header &hdr, const uint8_t *data, sensor_msgs::LaserScan &scan)
+        {
+            const auto n = hdr.num_beams;
+            const bool key = hdr.flags & SCAN_KEY_FRAME;
+            const bool has_intensities = hdr.flags & SCAN_HAS_INTENSITIES;
+
+            // Every beam codes to at least one bit, so a larger count is a
+            // damaged header; don't size the buffers from it
+            if((uint64_t)n*(has_intensities ? 2 : 1) > 8ull*hdr.payload_bytes)
+            {
+                synced = false;
+                return false;
+            }
+            if(key)
+            {
+                frame.assign((const char *)data, hdr.frame_id_len);
+                data += hdr.frame_id_len;
+            } else if(!synced || prev_ranges.size() != n ||
+                      has_intensities != (prev_intensities.size() == n && n > 0))
+            {
+                synced = false;
+                return false;
+            }
+
+            BitReader r(data, hdr.payload_bytes);
+            ranges.resize(n);
+            ScanCodec::decode(ranges.data(), key ? nullptr : prev_ranges.data(), n, r);
+            intensities.resize(has_intensities ? n : 0);
+            if(has_intensities)
+                ScanCodec::decode(intensities.data(), key ? nullptr : prev_intensities.data(), n, r);
+            if(r.overrun())
+            {
+                synced = false;
+                return false;
+            }
+
+            scan.header.stamp.sec = hdr.sec;
+            scan.header.stamp.nsec = hdr.nsec;
+            scan.header.frame_id = frame;
+            scan.angle_min = hdr.angle_min;
+            scan.angle_increment = hdr.angle_increment;
+            scan.angle_max = hdr.angle_min + (n > 0 ? (n - 1)*hdr.angle_increment : 0.0f);
+            scan.time_increment = hdr.time_increment;
+            scan.scan_time = hdr.scan_time;
+            scan.range_min = hdr.range_min;
+            scan.range_max = hdr.range_max;
+            scan.ranges.resize(n);
+            for(size_t i = 0; i < n; i++)
+                scan.ranges[i] = ScanCodec::range(ranges[i], hdr.quantum);
+            scan.intensities.resize(intensities.size());
+            for(size_t i = 0; i < intensities.size(); i++)
+                scan.intensities[i] = intensities[i]*hdr.intensity_quantum;
+
+            ranges.swap(prev_ranges);
+            intensities.swap(prev_intensities);
+            synced = true;
+            return true;
+        }
+};
+
+/**
+ * @brief Appends scans to a .scnz file.
+ */
+class ScanArchiveWriter
+{
+    private:
+        FILE *f;
+        ScanEncoder encoder;
+        std::vector<uint8_t> buf;
+        size_t bytes;
+
+    public:
+        explicit ScanArchiveWriter(const scan_codec_params &p) : f(nullptr), encoder(p), bytes(0) {}
+
+        ~ScanArchiveWriter()
+        {
+            close();
+        }
+
+        bool open(const std::string &path)
+        {
+            close();
+            f = std::fopen(path.c_str(), "wb");
+            if(f == nullptr)
+                return false;
+            scan_archive_header hdr;
+            std::memcpy(hdr.magic, "SCNZ", 4);
+            hdr.version = ScanCodec::VERSION;
+            encoder.reset();
+            bytes = sizeof(hdr);
+            return std::fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+        }
+
+        bool write(const sensor_msgs::LaserScan &scan)
+        {
+            if(f == nullptr)
+                return false;
+            buf.clear();
+            encoder.encode(scan, buf);
+            bytes += buf.size();
+            return std::fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+        }
+
+        void flush()
+        {
+            if(f != nullptr)
+                std::fflush(f);
+        }
+
+        bool close()
+        {
+            if(f == nullptr)
+                return true;
+            auto ok = std::fclose(f) == 0;
+            f = nullptr;
+            return ok;
+        }
+
+        size_t size() const
+        {
+            return bytes;
+        }
+};
+
+/**
+ * @brief Reads the scans of a .scnz file in order.
+ */
+class ScanArchiveReader
+{
+    private:
+        FILE *f;
+        long file_size;
+        ScanDecoder decoder;
+        std::vector<uint8_t> buf;
+
+    public:
+        ScanArchiveReader() : f(nullptr), file_size(0) {}
+
+        ~ScanArchiveReader()
+        {
+            if(f != nullptr)
+                std::fclose(f);
+        }
+
+        bool open(const std::string &path)
+        {
+            if(f != nullptr)
+                std::fclose(f);
+            f = std::fopen(path.c_str(), "rb");
+            if(f == nullptr)
+                return false;
+            if(std::fseek(f, 0, SEEK_END) != 0 || (file_size = std::ftell(f)) < 0 ||
+               std::fseek(f, 0, SEEK_SET) != 0)
+            {
+                std::fclose(f);
+                f = nullptr;
+                return false;
+            }
+            scan_archive_header hdr;
+            if(std::fread(&hdr, sizeof(hdr), 1, f) != 1 || std::memcmp(hdr.magic, "SCNZ", 4) != 0 ||
+               hdr.version != ScanCodec::VERSION)
+            {
+                std::fclose(f);
+                f = nullptr;
+                return false;
+            }
+            decoder = ScanDecoder();
+            return true;
+        }
+
+        // Back to the first scan
+        bool rewind()
+        {
+            if(f == nullptr || std::fseek(f, sizeof(scan_archive_header), SEEK_SET) != 0)
+                return false;
+            decoder = ScanDecoder();
+            return true;
+        }
+
+        /**
+         * @brief The next scan that decodes; false at the end of the file
+         *          (or a record cut short by the recorder stopping, or one
+         *          whose header claims more bytes than the file has left).
+         * @param skipped  records that couldn't be decoded on the way
+         */
+        bool next(sensor_msgs::LaserScan &scan, size_t *skipped = nullptr)
+        {
+            scan_record_header hdr;
+            while(f != nullptr && std::fread(&hdr, sizeof(hdr), 1, f) == 1)
+            {
+                // A corrupt header mustn't turn into a huge allocation
+                auto record = (uint64_t)hdr.frame_id_len + hdr.payload_bytes;
+                auto pos = std::ftell(f);
+                if(pos < 0 || record > (uint64_t)(file_size - pos))
+                    return false;
+                buf.resize(record);
+                if(std::fread(buf.data(), 1, buf.size(), f) != buf.size())
+                    return false;
+                if(decoder.decode(hdr, buf.data(), scan))
+                    return true;
+                if(skipped != nullptr)
+                    (*skipped)++;
+            }
+            return false;
+        }
+};
+
+} // namespace race_common
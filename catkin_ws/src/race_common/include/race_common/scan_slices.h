@@ -0,0 +1,185 @@
+/**
+ * @file scan_slices.h
+ * @brief Angular windows of a scan for consumers that only need a few
+ *          beams.
+ *
+ * A consumer declares its windows once. ScanSlicer turns them into beam
+ * index ranges (cached until the scan layout changes) and packs the beams
+ * into a compact ScanSlices message for the scan_slicer node to publish.
+ *
+ * On the receiving side SlicedScan indexes a ScanSlices message with
+ * full-scan beam indices, so code written against LaserScan (`ranges[i]`,
+ * `ranges.size()`, `range_min`, ...) runs on it unchanged. Beams outside
+ * every window read as NaN, which scan kernels already treat as invalid.
+ */
+#pragma once
+
+#include <race_common/ScanSlices.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace race_common
+{
+
+struct beam_window
+{
+    double min_angle, max_angle;    // radians, inclusive
+};
+
+class ScanSlicer
+{
+    private:
+        std::vector<beam_window> windows;
+
+        // [first, last] beam indices, sorted and merged
+        std::vector<std::pair<int, int>> ranges;
+        float cached_min, cached_inc;
+        size_t cached_beams;
+
+        void layout(float angle_min, float angle_inc, size_t beams)
+        {
+            if(cached_beams == beams && cached_min == angle_min && cached_inc == angle_inc)
+                return;
+
+            ranges.clear();
+            for(const auto &w : windows)
+            {
+                auto lo = (int)std::ceil((w.min_angle - angle_min)/angle_inc);
+                auto hi = (int)std::floor((w.max_angle - angle_min)/angle_inc);
+                lo = std::max(lo, 0);
+                hi = std::min(hi, (int)beams - 1);
+                if(lo <= hi)
+                    ranges.emplace_back(lo, hi);
+            }
+
+            // Overlapping windows would otherwise send beams twice
+            std::sort(ranges.begin(), ranges.end());
+            size_t merged = 0;
+            for(size_t i = 0; i < ranges.size(); i++)
+            {
+                if(merged > 0 && ranges[i].first <= ranges[merged - 1].second + 1)
+                    ranges[merged - 1].second = std::max(ranges[merged - 1].second, ranges[i].second);
+                else
+                    ranges[merged++] = ranges[i];
+            }
+            ranges.resize(merged);
+
+            cached_min = angle_min;
+            cached_inc = angle_inc;
+            cached_beams = beams;
+        }
+
+    public:
+        explicit ScanSlicer(const std::vector<beam_window> &windows = {})
+            : windows(windows), cached_min(0.0f), cached_inc(0.0f), cached_beams(0)
+        {}
+
+        // Windows as a flat [min, max, min, max, ...] list, the params format
+        static std::vector<beam_window> fromFlat(const std::vector<double> &flat)
+        {
+            std::vector<beam_window> out;
+            for(size_t i = 0; i + 1 < flat.size(); i += 2)
+                out.push_back({flat[i], flat[i + 1]});
+            return out;
+        }
+
+        // Pack the windows into `out`
+        template <typename Scan>
+        void fill(const Scan &msg, ScanSlices &out)
+        {
+            layout(msg.angle_min, msg.angle_increment, msg.ranges.size());
+
+            out.header = msg.header;
+            out.angle_min = msg.angle_min;
+            out.angle_increment = msg.angle_increment;
+            out.num_beams = msg.ranges.size();
+            out.range_min = msg.range_min;
+            out.range_max = msg.range_max;
+            out.first.clear();
+            out.count.clear();
+            out.offset.clear();
+            out.ranges.clear();
+
+            for(const auto &r : ranges)
+            {
+                out.first.push_back(r.first);
+                out.count.push_back(r.second - r.first + 1);
+                out.offset.push_back(out.ranges.size());
+                out.ranges.insert(out.ranges.end(), msg.ranges.data() + r.first,
+                                  msg.ranges.data() + r.second + 1);
+            }
+        }
+};
+
+/**
+ * @brief Full-scan index -> slot in a ScanSlices message. Keep one per
+ *          subscriber; it is only rebuilt when the windows change.
+ */
+class SliceIndex
+{
+    private:
+        std::vector<int32_t> slot;  // -1 outside every window
+        std::vector<uint32_t> cached_first, cached_count;
+
+    public:
+        const std::vector<int32_t> &get(const ScanSlices &msg)
+        {
+            if(slot.size() == msg.num_beams && cached_first == msg.first && cached_count == msg.count)
+                return slot;
+
+            slot.assign(msg.num_beams, -1);
+            auto windows = std::min({msg.first.size(), msg.count.size(), msg.offset.size()});
+            for(size_t w = 0; w < windows; w++)
+            {
+                for(uint32_t k = 0; k < msg.count[w]; k++)
+                {
+                    auto beam = msg.first[w] + k, at = msg.offset[w] + k;
+                    if(beam < msg.num_beams && at < msg.ranges.size())
+                        slot[beam] = at;
+                }
+            }
+
+            cached_first = msg.first;
+            cached_count = msg.count;
+            return slot;
+        }
+};
+
+// LaserScan-shaped view of a ScanSlices message
+struct SlicedScan
+{
+    struct beams
+    {
+        const float *data_;
+        const int32_t *slot;
+        size_t n;
+
+        float operator[](size_t i) const
+        {
+            auto s = slot[i];
+            return s < 0 ? std::numeric_limits<float>::quiet_NaN() : data_[s];
+        }
+        size_t size() const { return n; }
+        bool empty() const { return n == 0; }
+    };
+
+    std_msgs::Header header;
+    float angle_min, angle_increment;
+    float range_min, range_max;
+    beams ranges;
+
+    SlicedScan(const ScanSlices &msg, SliceIndex &index)
+        : header(msg.header),
+          angle_min(msg.angle_min), angle_increment(msg.angle_increment),
+          range_min(msg.range_min), range_max(msg.range_max)
+    {
+        const auto &slot = index.get(msg);
+        ranges = {msg.ranges.data(), slot.data(), slot.size()};
+    }
+};
+
+} // namespace race_common
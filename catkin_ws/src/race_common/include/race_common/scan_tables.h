@@ -0,0 +1,63 @@
+/**
+ * @file scan_tables.h
+ * @brief Per-beam tables that depend only on the lidar layout and the car:
+ *          beam direction cosines/sines and the footprint perimeter.
+ *
+ * They are read-only once built, so every node (or every car in a
+ * multi-car process) with the same lidar can share one copy through a
+ * std::shared_ptr<const ScanTables>.
+ */
+#pragma once
+
+#include <race_common/car_geometry.h>
+
+#include <cmath>
+#include <vector>
+
+namespace race_common
+{
+
+class ScanTables
+{
+    public:
+        lidar_intrinsics lidar;
+        std::vector<float> cos, sin;    // beam direction in the lidar frame
+        std::vector<float> perimeter;   // lidar to the footprint's edge
+
+        ScanTables(const car_intrinsics &car, const lidar_intrinsics &lidar)
+            : lidar(lidar)
+        {
+            cos.resize(lidar.num_scans);
+            sin.resize(lidar.num_scans);
+            for(int i = 0; i < lidar.num_scans; i++)
+            {
+                auto a = lidar.min_angle + i*lidar.scan_inc;
+                cos[i] = std::cos(a);
+                sin[i] = std::sin(a);
+            }
+            auto perim = compute_car_perim(car, lidar);
+            perimeter.assign(perim.begin(), perim.end());
+        }
+
+        // Layout of a received scan, for checking it against the tables
+        template <typename Scan>
+        static lidar_intrinsics layout(const Scan &msg)
+        {
+            lidar_intrinsics l;
+            l.scan_inc = msg.angle_increment;
+            l.min_angle = msg.angle_min;
+            l.max_angle = msg.angle_max;
+            l.num_scans = msg.ranges.size();
+            return l;
+        }
+
+        template <typename Scan>
+        bool matches(const Scan &msg) const
+        {
+            return (size_t)lidar.num_scans == msg.ranges.size() &&
+                   std::fabs(lidar.min_angle - msg.angle_min) < 1e-6 &&
+                   std::fabs(lidar.scan_inc - msg.angle_increment) < 1e-9;
+        }
+};
+
+} // namespace race_common
@@ -0,0 +1,169 @@
+/**
+ * @file speed_map.h
+ * @brief Grid of allowed speeds over the track, queried by pose.
+ *
+ * On disk the map is a small header followed by one byte per cell, row
+ * major from the map origin. A cell holds the allowed speed in units of
+ * `speed_step`; 0 means "unknown" and the caller's default applies. The
+ * file is memory mapped read-only, so loading is free and every node
+ * that opens the same map shares the pages.
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace race_common
+{
+
+struct speed_map_header
+{
+    char magic[4];          // "SPDM"
+    uint32_t version;
+    uint32_t width, height; // cells
+    float resolution;       // meters per cell
+    float origin_x, origin_y; // world position of cell (0, 0)'s corner
+    float speed_step;       // meters/second per count
+};
+
+class SpeedMap
+{
+    private:
+        const speed_map_header *header;
+        const uint8_t *cells;
+        size_t mapped_size;
+        float inv_res;
+
+    public:
+        static constexpr uint32_t VERSION = 1;
+
+        SpeedMap() : header(nullptr), cells(nullptr), mapped_size(0), inv_res(0.0f) {}
+
+        ~SpeedMap()
+        {
+            close();
+        }
+
+        SpeedMap(const SpeedMap &) = delete;
+        SpeedMap &operator=(const SpeedMap &) = delete;
+
+        bool open(const std::string &path)
+        {
+            close();
+
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0)
+                return false;
+
+            struct stat st;
+            if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(speed_map_header))
+            {
+                ::close(fd);
+                return false;
+            }
+
+            void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if(data == MAP_FAILED)
+                return false;
+
+            auto hdr = (const speed_map_header *)data;
+            auto expected = sizeof(speed_map_header) + (size_t)hdr->width*hdr->height;
+            if(std::memcmp(hdr->magic, "SPDM", 4) != 0 || hdr->version != VERSION ||
+               (size_t)st.st_size < expected || hdr->resolution <= 0.0f)
+            {
+                munmap(data, st.st_size);
+                return false;
+            }
+
+            header = hdr;
+            cells = (const uint8_t *)data + sizeof(speed_map_header);
+            mapped_size = st.st_size;
+            inv_res = 1.0f/hdr->resolution;
+            return true;
+        }
+
+        void close()
+        {
+            if(header != nullptr)
+                munmap((void *)header, mapped_size);
+            header = nullptr;
+            cells = nullptr;
+            mapped_size = 0;
+        }
+
+        bool loaded() const
+        {
+            return header != nullptr;
+        }
+
+        // O(1): allowed speed at (x, y), or `fallback` off the map / in unknown cells
+        double query(double x, double y, double fallback) const
+        {
+            if(header == nullptr)
+                return fallback;
+
+            auto cx = (long)std::floor((x - header->origin_x)*inv_res);
+            auto cy = (long)std::floor((y - header->origin_y)*inv_res);
+            if(cx < 0 || cy < 0 || cx >= (long)header->width || cy >= (long)header->height)
+                return fallback;
+
+            auto v = cells[cy*header->width + cx];
+            return v == 0 ? fallback : v*header->speed_step;
+        }
+
+        const speed_map_header *getHeader() const
+        {
+            return header;
+        }
+
+        /**
+         * @brief Quantize `speeds` (row major, <= 0 for unknown) and write
+         *          them in the format `open` expects.
+         */
+        static bool write(const std::string &path, uint32_t width, uint32_t height,
+                          float resolution, float origin_x, float origin_y,
+                          float max_speed, const std::vector<float> &speeds)
+        {
+            if(speeds.size() != (size_t)width*height || max_speed <= 0.0f)
+                return false;
+
+            speed_map_header hdr;
+            std::memcpy(hdr.magic, "SPDM", 4);
+            hdr.version = VERSION;
+            hdr.width = width;
+            hdr.height = height;
+            hdr.resolution = resolution;
+            hdr.origin_x = origin_x;
+            hdr.origin_y = origin_y;
+            hdr.speed_step = max_speed/255.0f;
+
+            std::vector<uint8_t> quantized(speeds.size());
+            for(size_t i = 0; i < speeds.size(); i++)
+            {
+                // Round down so the stored speed never exceeds the learned one,
+                // but keep known cells off the "unknown" code
+                auto q = std::floor(speeds[i]/hdr.speed_step);
+                quantized[i] = speeds[i] <= 0.0f ? 0 : (uint8_t)std::min(std::max(q, 1.0f), 255.0f);
+            }
+
+            FILE *f = std::fopen(path.c_str(), "wb");
+            if(f == nullptr)
+                return false;
+            auto ok = std::fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+                      std::fwrite(quantized.data(), 1, quantized.size(), f) == quantized.size();
+            return std::fclose(f) == 0 && ok;
+        }
+};
+
+} // namespace race_common
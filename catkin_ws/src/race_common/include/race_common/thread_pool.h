@@ -0,0 +1,119 @@
+/**
+ * @file thread_pool.h
+ * @brief Fixed set of worker threads for splitting a per-cycle batch of
+ *          work (e.g. sampled rollouts) across cores.
+ *
+ * `run(n, fn)` calls fn(0) .. fn(n - 1) across the workers and the calling
+ * thread and returns once all of them have finished. Threads are created
+ * once, so a control loop pays only a wake-up per cycle.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace race_common
+{
+
+class ThreadPool
+{
+    private:
+        std::vector<std::thread> workers;
+        std::mutex m;
+        std::condition_variable wake, finished;
+
+        const std::function<void(int)> *job;
+        int n_jobs;
+        std::atomic<int> next;
+        int busy;               // workers still inside the current batch
+        uint64_t generation;    // bumped once per batch
+        bool stop;
+
+        void drain()
+        {
+            for(int i = next.fetch_add(1); i < n_jobs; i = next.fetch_add(1))
+                (*job)(i);
+        }
+
+        void worker()
+        {
+            uint64_t seen = 0;
+            for(;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m);
+                    wake.wait(lock, [&] { return stop || generation != seen; });
+                    if(stop)
+                        return;
+                    seen = generation;
+                }
+
+                drain();
+
+                std::lock_guard<std::mutex> lock(m);
+                if(--busy == 0)
+                    finished.notify_one();
+            }
+        }
+
+    public:
+        // `threads` workers in addition to the caller; 0 runs everything inline
+        explicit ThreadPool(int threads)
+            : job(nullptr), n_jobs(0), next(0), busy(0), generation(0), stop(false)
+        {
+            for(int i = 0; i < threads; i++)
+                workers.emplace_back(&ThreadPool::worker, this);
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m);
+                stop = true;
+            }
+            wake.notify_all();
+            for(auto &w : workers)
+                w.join();
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        int size() const
+        {
+            return workers.size() + 1;
+        }
+
+        void run(int n, const std::function<void(int)> &fn)
+        {
+            if(workers.empty())
+            {
+                for(int i = 0; i < n; i++)
+                    fn(i);
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m);
+                job = &fn;
+                n_jobs = n;
+                next = 0;
+                busy = workers.size();
+                generation++;
+            }
+            wake.notify_all();
+
+            drain();
+
+            std::unique_lock<std::mutex> lock(m);
+            finished.wait(lock, [&] { return busy == 0; });
+            job = nullptr;
+        }
+};
+
+} // namespace race_common
@@ -0,0 +1,150 @@
+/**
+ * @file velocity_ekf.h
+ * @brief EKF over forward speed and yaw rate, fusing the IMU with wheel
+ *          odometry.
+ *
+ * State: [v, r, b_a, b_g], the forward speed, the yaw rate, and the biases
+ * of the forward accelerometer and the yaw gyro. The IMU's forward
+ * acceleration drives the prediction (v' = a_x - b_a), so the estimate
+ * moves at IMU rate instead of waiting for odometry. Every IMU sample
+ * then measures the gyro (r + b_g) and the lateral acceleration, which
+ * for a car without side slip is centripetal (v*r) and is what makes this
+ * an EKF. Odometry measures v and r directly, which is what keeps both
+ * biases observable.
+ */
+#pragma once
+
+#include <race_common/fixed_matrix.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace race_common
+{
+
+struct velocity_ekf_params
+{
+    // Process noise densities (per sqrt(s))
+    double accel_noise;     // forward accel, drives v (m/s^2)
+    double yaw_accel_noise; // random walk of r (rad/s^2)
+    double accel_bias_walk; // (m/s^2)
+    double gyro_bias_walk;  // (rad/s)
+
+    // Measurement standard deviations
+    double gyro_std;        // rad/s
+    double lat_accel_std;   // m/s^2
+    double odom_speed_std;  // m/s
+    double odom_yaw_rate_std; // rad/s
+
+    double max_dt;          // longest prediction step, for gaps in the IMU (s)
+};
+
+class VelocityEKF
+{
+    public:
+        enum { V = 0, R = 1, BA = 2, BG = 3, N = 4 };
+
+    private:
+        velocity_ekf_params p;
+        Vector<N> x;
+        Matrix<N, N> P;
+
+        template <int M>
+        void update(const Vector<M> &innovation, const Matrix<M, N> &H, const Matrix<M, M> &Rm)
+        {
+            auto Ht = H.transpose();
+            auto PHt = P*Ht;
+            Matrix<M, M> S_inv;
+            if(!(H*PHt + Rm).inverse(S_inv))
+                return;
+            auto K = PHt*S_inv;
+
+            x += K*innovation;
+
+            // Joseph form, stays positive definite with large gains
+            auto IKH = Matrix<N, N>::identity() - K*H;
+            P = IKH*P*IKH.transpose() + K*Rm*K.transpose();
+            P.symmetrize();
+        }
+
+    public:
+        explicit VelocityEKF(const velocity_ekf_params &p)
+            : p(p)
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            x = Vector<N>::zeros();
+            P = Matrix<N, N>::zeros();
+            P(V, V) = 1.0;
+            P(R, R) = 1.0;
+            P(BA, BA) = 0.25;
+            P(BG, BG) = 0.01;
+        }
+
+        /**
+         * @brief Advance by `dt` seconds with forward acceleration `accel_x`.
+         */
+        void predict(double dt, double accel_x)
+        {
+            dt = std::min(std::max(dt, 0.0), p.max_dt);
+            if(dt <= 0.0)
+                return;
+
+            x(V, 0) += (accel_x - x(BA, 0))*dt;
+
+            auto F = Matrix<N, N>::identity();
+            F(V, BA) = -dt;
+            P = F*P*F.transpose();
+            P(V, V) += p.accel_noise*p.accel_noise*dt;
+            P(R, R) += p.yaw_accel_noise*p.yaw_accel_noise*dt;
+            P(BA, BA) += p.accel_bias_walk*p.accel_bias_walk*dt;
+            P(BG, BG) += p.gyro_bias_walk*p.gyro_bias_walk*dt;
+        }
+
+        // Gyro yaw rate and lateral acceleration from one IMU sample
+        void update_imu(double gyro_z, double accel_y)
+        {
+            auto v = x(V, 0), r = x(R, 0);
+            Vector<2> y;
+            y(0, 0) = gyro_z - (r + x(BG, 0));
+            y(1, 0) = accel_y - v*r;
+
+            auto H = Matrix<2, N>::zeros();
+            H(0, R) = 1.0;
+            H(0, BG) = 1.0;
+            H(1, V) = r;
+            H(1, R) = v;
+
+            auto Rm = Matrix<2, 2>::zeros();
+            Rm(0, 0) = p.gyro_std*p.gyro_std;
+            Rm(1, 1) = p.lat_accel_std*p.lat_accel_std;
+            update(y, H, Rm);
+        }
+
+        // Speed and yaw rate from wheel odometry
+        void update_odom(double speed, double yaw_rate)
+        {
+            Vector<2> y;
+            y(0, 0) = speed - x(V, 0);
+            y(1, 0) = yaw_rate - x(R, 0);
+
+            auto H = Matrix<2, N>::zeros();
+            H(0, V) = 1.0;
+            H(1, R) = 1.0;
+
+            auto Rm = Matrix<2, 2>::zeros();
+            Rm(0, 0) = p.odom_speed_std*p.odom_speed_std;
+            Rm(1, 1) = p.odom_yaw_rate_std*p.odom_yaw_rate_std;
+            update(y, H, Rm);
+        }
+
+        double speed() const { return x(V, 0); }
+        double yaw_rate() const { return x(R, 0); }
+        const Vector<N> &state() const { return x; }
+        const Matrix<N, N> &covariance() const { return P; }
+};
+
+} // namespace race_common
@@ -0,0 +1,50 @@
+/**
+ * @file velocity_input.h
+ * @brief Speed and yaw rate for a node, from velocity_ekf's /velocity_estimate
+ *          while it is running and from raw /odom otherwise.
+ *
+ * Nodes feed both callbacks; odometry is only used once the estimate has
+ * been silent for `timeout`, so nothing breaks when the EKF isn't launched.
+ */
+#pragma once
+
+#include <ros/ros.h>
+#include <geometry_msgs/TwistWithCovarianceStamped.h>
+#include <nav_msgs/Odometry.h>
+
+namespace race_common
+{
+
+class VelocityInput
+{
+    private:
+        double v, r;
+        ros::Time last_estimate;
+        ros::Duration timeout;
+
+    public:
+        explicit VelocityInput(double timeout = 0.1)
+            : v(0.0), r(0.0), timeout(timeout)
+        {
+        }
+
+        void from_odom(const nav_msgs::Odometry &msg)
+        {
+            if(!last_estimate.isZero() && ros::Time::now() - last_estimate < timeout)
+                return;
+            v = msg.twist.twist.linear.x;
+            r = msg.twist.twist.angular.z;
+        }
+
+        void from_estimate(const geometry_msgs::TwistWithCovarianceStamped &msg)
+        {
+            last_estimate = ros::Time::now();
+            v = msg.twist.twist.linear.x;
+            r = msg.twist.twist.angular.z;
+        }
+
+        double speed() const { return v; }
+        double yaw_rate() const { return r; }
+};
+
+} // namespace race_common
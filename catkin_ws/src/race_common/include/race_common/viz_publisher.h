@@ -0,0 +1,239 @@
+/**
+ * @file viz_publisher.h
+ * @brief Debug markers that cost the control path nothing while nobody
+ *          is looking at them.
+ *
+ * A node asks `wanted()` once per cycle. That is one atomic load while the
+ * topic has no subscribers (rviz closed, nothing recording), and otherwise
+ * also limits marker messages to `rate`, skipping a cycle while the
+ * previous markers are still being built. When it says yes, the node
+ * copies what it needs to draw into a closure passed to `post()`. That
+ * closure fills the MarkerArray and the array is published on one shared
+ * thread per process, scheduled below everything else (SCHED_IDLE on
+ * Linux), so rviz and marker building never compete with a callback.
+ *
+ *     if(viz.wanted())
+ *     {
+ *         std::vector<float> ranges(msg.ranges.begin(), msg.ranges.end());
+ *         viz.post([ranges](visualization_msgs::MarkerArray &out) { ... });
+ *     }
+ *
+ * The closure runs after the callback has returned, so it must own its
+ * data: copy scan views, don't capture `this` for state the callbacks
+ * keep changing.
+ */
+#pragma once
+
+#include <ros/ros.h>
+#include <std_msgs/ColorRGBA.h>
+#include <visualization_msgs/MarkerArray.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace race_common
+{
+
+// The one low priority thread that builds and publishes every VizPublisher's markers
+class VizWorker
+{
+    private:
+        std::thread thread;
+        std::mutex m;
+        std::condition_variable wake;
+        std::deque<std::function<void()>> jobs;
+        bool stop;
+
+        void run()
+        {
+#ifdef __linux__
+            sched_param sp;
+            sp.sched_priority = 0;
+            pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+#endif
+            for(;;)
+            {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(m);
+                    wake.wait(lock, [this] { return stop || !jobs.empty(); });
+                    if(stop)
+                        return;
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+        VizWorker()
+            : stop(false)
+        {
+            thread = std::thread(&VizWorker::run, this);
+        }
+
+    public:
+        ~VizWorker()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m);
+                stop = true;
+            }
+            wake.notify_one();
+            thread.join();
+        }
+
+        static VizWorker &instance()
+        {
+            static VizWorker worker;
+            return worker;
+        }
+
+        void push(std::function<void()> job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m);
+                jobs.push_back(std::move(job));
+            }
+            wake.notify_one();
+        }
+};
+
+class VizPublisher
+{
+    public:
+        typedef std::function<void(visualization_msgs::MarkerArray &)> Builder;
+
+    private:
+        // Shared with queued jobs, so a publisher can go away with markers in flight
+        struct state
+        {
+            ros::Publisher pub;
+            std::atomic<int> subscribers;
+            std::atomic<bool> busy;     // markers queued or being built
+        };
+
+        std::shared_ptr<state> s;
+        std::chrono::steady_clock::duration period;
+        std::chrono::steady_clock::time_point last;
+
+    public:
+        VizPublisher()
+            : s(std::make_shared<state>())
+        {
+            s->subscribers = 0;
+            s->busy = false;
+        }
+
+        /**
+         * @param nh     the topic is resolved in its namespace
+         * @param rate   most marker messages per second; <= 0 never advertises
+         */
+        VizPublisher(ros::NodeHandle &nh, const std::string &topic, double rate)
+            : VizPublisher()
+        {
+            if(rate <= 0.0)
+                return;
+            period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(1.0/rate));
+
+            // Counted from the connection callbacks so wanted() needn't ask roscpp
+            std::weak_ptr<state> w = s;
+            s->pub = nh.advertise<visualization_msgs::MarkerArray>(topic, 1,
+                [w](const ros::SingleSubscriberPublisher &) { if(auto p = w.lock()) p->subscribers++; },
+                [w](const ros::SingleSubscriberPublisher &) { if(auto p = w.lock()) p->subscribers--; });
+        }
+
+        /**
+         * @brief Whether to post markers this cycle.
+         *
+         * Call once per cycle and post() whenever it returns true; it
+         * starts the next decimation period.
+         */
+        bool wanted()
+        {
+            if(s->subscribers.load(std::memory_order_relaxed) <= 0)
+                return false;
+            if(s->busy.load(std::memory_order_acquire))
+                return false;
+            auto now = std::chrono::steady_clock::now();
+            if(now - last < period)
+                return false;
+            last = now;
+            return true;
+        }
+
+        void post(Builder build)
+        {
+            s->busy.store(true, std::memory_order_release);
+            auto st = s;
+            VizWorker::instance().push([st, build]() {
+                visualization_msgs::MarkerArray out;
+                build(out);
+                st->pub.publish(out);
+                st->busy.store(false, std::memory_order_release);
+            });
+        }
+};
+
+namespace viz
+{
+
+inline std_msgs::ColorRGBA color(float r, float g, float b, float a = 1.0f)
+{
+    std_msgs::ColorRGBA c;
+    c.r = r;
+    c.g = g;
+    c.b = b;
+    c.a = a;
+    return c;
+}
+
+// Red at 0 through yellow to green at 1
+inline std_msgs::ColorRGBA heat(float t)
+{
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    return color(std::min(2.0f - 2.0f*t, 1.0f), std::min(2.0f*t, 1.0f), 0.0f);
+}
+
+// An ADD marker with the usual defaults filled in
+inline visualization_msgs::Marker marker(const std_msgs::Header &header, const std::string &ns,
+                                         int id, int type, double scale)
+{
+    visualization_msgs::Marker m;
+    m.header = header;
+    m.ns = ns;
+    m.id = id;
+    m.type = type;
+    m.action = visualization_msgs::Marker::ADD;
+    m.pose.orientation.w = 1.0;
+    m.scale.x = m.scale.y = m.scale.z = scale;
+    m.color = color(1.0f, 1.0f, 1.0f);
+    return m;
+}
+
+inline geometry_msgs::Point point(double x, double y)
+{
+    geometry_msgs::Point p;
+    p.x = x;
+    p.y = y;
+    p.z = 0.0;
+    return p;
+}
+
+} // namespace viz
+
+} // namespace race_common
@@ -0,0 +1,183 @@
+/**
+ * @file fault_injector.cpp
+ * @brief Relays /scan and /odom to the nodes under test with faults and
+ *          delays, and delays their outputs to mimic processing latency.
+ *
+ * The nodes under test are remapped onto the injector's topics (see
+ * fault_injection.launch): they read /faulty/scan and /faulty/odom, and
+ * publish every topic in `fault_delayed_outputs` under /faulty instead,
+ * which the injector republishes on the real topic after
+ * `fault_output_latency`. Outputs are relayed without knowing their type.
+ *
+ * Odometry can also go stale: with probability `fault_odom_stale_prob` per
+ * message it stops updating for `fault_odom_stale_time`.
+ *
+ * Delays are measured in ROS time, so they scale with `rosbag play -r`
+ * when the bag publishes /clock.
+ */
+
+#include <ros/ros.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/LaserScan.h>
+#include <topic_tools/shape_shifter.h>
+
+#include <boost/make_shared.hpp>
+
+#include <race_common/fault_injection.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+class FaultInjector
+{
+    private:
+        typedef topic_tools::ShapeShifter::ConstPtr Output;
+
+        struct delayed_output
+        {
+            std::string topic;
+            ros::Subscriber sub;
+            ros::Publisher pub;
+            std::unique_ptr<race_common::DelayLine<Output>> line;
+        };
+
+        ros::NodeHandle n;
+        ros::Subscriber scan_sub, odom_sub;
+        ros::Publisher scan_pub, odom_pub;
+        ros::Timer timer;
+
+        std::mt19937 rng;
+        race_common::scan_faults scan_faults;
+        race_common::DelayLine<sensor_msgs::LaserScan::Ptr> scan_line;
+        race_common::DelayLine<nav_msgs::Odometry::Ptr> odom_line;
+        std::vector<std::unique_ptr<delayed_output>> outputs;
+
+        double stale_prob, stale_time;
+        ros::Time stale_until, last_now;
+
+        // Counts for the summary on shutdown
+        size_t scans_in, scans_out, odoms_in, odoms_out;
+
+    public:
+        FaultInjector()
+            : n(ros::NodeHandle("~")),
+              scan_line(race_common::load_stream_faults(n, "fault_scan")),
+              odom_line(race_common::load_stream_faults(n, "fault_odom")),
+              scans_in(0), scans_out(0), odoms_in(0), odoms_out(0)
+        {
+            int seed;
+            double tick_rate;
+            n.param("fault_seed", seed, 1);
+            n.param("fault_tick_rate", tick_rate, 1000.0);
+            n.param("fault_odom_stale_prob", stale_prob, 0.0);
+            n.param("fault_odom_stale_time", stale_time, 0.2);
+            rng.seed(seed);
+            scan_faults = race_common::load_scan_faults(n);
+
+            // pubs
+            scan_pub = n.advertise<sensor_msgs::LaserScan>("/faulty/scan", 1);
+            odom_pub = n.advertise<nav_msgs::Odometry>("/faulty/odom", 1);
+
+            // subs
+            scan_sub = n.subscribe("/scan", 1, &FaultInjector::scan_cb, this, ros::TransportHints().tcpNoDelay());
+            odom_sub = n.subscribe("/odom", 1, &FaultInjector::odom_cb, this, ros::TransportHints().tcpNoDelay());
+
+            std::vector<std::string> topics;
+            n.getParam("fault_delayed_outputs", topics);
+            auto output_faults = race_common::load_stream_faults(n, "fault_output");
+            for(const auto &t : topics)
+            {
+                std::unique_ptr<delayed_output> out(new delayed_output);
+                out->topic = t;
+                out->line.reset(new race_common::DelayLine<Output>(output_faults));
+                auto raw = out.get();
+                out->sub = n.subscribe<topic_tools::ShapeShifter>("/faulty" + t, 10,
+                    [this, raw](const Output &msg) { output_cb(*raw, msg); });
+                outputs.push_back(std::move(out));
+            }
+
+            timer = n.createTimer(ros::Duration(1.0/tick_rate), &FaultInjector::tick_cb, this);
+        }
+
+        ~FaultInjector()
+        {
+            ROS_INFO("Fault injector: %zu/%zu scans and %zu/%zu odometry messages delivered",
+                     scans_out, scans_in, odoms_out, odoms_in);
+        }
+
+        void scan_cb(const sensor_msgs::LaserScan::ConstPtr &msg)
+        {
+            scans_in++;
+            auto scan = boost::make_shared<sensor_msgs::LaserScan>(*msg);
+            scan->header.stamp = scan_line.skew(scan->header.stamp);
+            race_common::corrupt_scan(*scan, scan_faults, rng);
+            scan_line.push(now(), scan, rng);
+        }
+
+        void odom_cb(const nav_msgs::Odometry::ConstPtr &msg)
+        {
+            odoms_in++;
+            auto t = now();
+            std::uniform_real_distribution<double> u(0.0, 1.0);
+            if(t < stale_until)
+                return;
+            if(stale_prob > 0.0 && u(rng) < stale_prob)
+            {
+                stale_until = t + ros::Duration(stale_time);
+                return;
+            }
+
+            auto odom = boost::make_shared<nav_msgs::Odometry>(*msg);
+            odom->header.stamp = odom_line.skew(odom->header.stamp);
+            odom_line.push(t, odom, rng);
+        }
+
+        void output_cb(delayed_output &out, const Output &msg)
+        {
+            if(!out.pub)
+                out.pub = msg->advertise(n, out.topic, 10);
+            out.line->push(now(), msg, rng);
+        }
+
+        void tick_cb(const ros::TimerEvent &)
+        {
+            auto t = now();
+            scan_line.flush(t, [this](const sensor_msgs::LaserScan::Ptr &m) {
+                scan_pub.publish(m);
+                scans_out++;
+            });
+            odom_line.flush(t, [this](const nav_msgs::Odometry::Ptr &m) {
+                odom_pub.publish(m);
+                odoms_out++;
+            });
+            for(auto &out : outputs)
+                out->line->flush(t, [&out](const Output &m) { out->pub.publish(m); });
+        }
+
+        // ROS time, restarting the delay lines if a looping bag jumps back
+        ros::Time now()
+        {
+            auto t = ros::Time::now();
+            if(t < last_now)
+            {
+                ROS_WARN("Time went backwards, dropping queued messages.");
+                scan_line.clear();
+                odom_line.clear();
+                for(auto &out : outputs)
+                    out->line->clear();
+                stale_until = ros::Time();
+            }
+            last_now = t;
+            return t;
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "fault_injector");
+    FaultInjector f;
+    ros::spin();
+    return 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file lidar_health.cpp
+ * @brief Runs LidarHealthMonitor on every scan and publishes the result on
+ *          /lidar_health. safety_node listens to it and turns conservative
+ *          while the lidar is unhealthy.
+ */
+
+#include <ros/ros.h>
+#include <race_common/LidarHealth.h>
+#include <race_common/laser_scan_view.h>
+#include <race_common/lidar_health.h>
+
+class LidarHealthNode
+{
+    private:
+        ros::NodeHandle n;
+        ros::Subscriber scan_sub;
+        ros::Publisher health_pub;
+
+        race_common::LidarHealthMonitor monitor;
+        race_common::LidarHealth msg;   // reused so its vectors keep their capacity
+        bool was_healthy;
+
+        static race_common::lidar_health_params load(const ros::NodeHandle &n)
+        {
+            race_common::lidar_health_params p;
+            n.param("lidar_health_sectors", p.sectors, 12);
+            n.param("lidar_health_block_range", p.block_range, 0.05);
+            n.param("lidar_health_block_ratio", p.block_ratio, 0.8);
+            n.param("lidar_health_block_time", p.block_time, 1.0);
+            n.param("lidar_health_frozen_scans", p.frozen_scans, 3);
+            return p;
+        }
+
+    public:
+        LidarHealthNode()
+            : n(ros::NodeHandle("~")), monitor(load(n)), was_healthy(true)
+        {
+            health_pub = n.advertise<race_common::LidarHealth>("/lidar_health", 1);
+            scan_sub = n.subscribe("/scan", 1, &LidarHealthNode::scan_cb, this);
+        }
+
+        void scan_cb(const race_common::LaserScanView &scan)
+        {
+            const auto &h = monitor.update(scan);
+
+            msg.header = scan.header;
+            msg.healthy = h.healthy();
+            msg.frozen = h.frozen;
+            msg.invalid_ratio = h.invalid_ratio;
+            msg.sector_invalid_ratio.assign(h.sector_invalid.begin(), h.sector_invalid.end());
+            msg.sector_blocked.assign(h.sector_blocked.begin(), h.sector_blocked.end());
+            health_pub.publish(msg);
+
+            if(msg.healthy != was_healthy)
+            {
+                if(msg.healthy)
+                    ROS_INFO("Lidar healthy again.");
+                else if(h.frozen)
+                    ROS_WARN("Lidar data frozen: scans are identical.");
+                else
+                    ROS_WARN("Lidar sector blocked: returns closer than the block range.");
+                was_healthy = msg.healthy;
+            }
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "lidar_health");
+    LidarHealthNode node;
+    ros::spin();
+    return 0;
+}
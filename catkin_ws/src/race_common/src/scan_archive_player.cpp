@@ -0,0 +1,94 @@
+/**
+ * @file scan_archive_player.cpp
+ * @brief Replays a .scnz archive (see scan_codec.h) on /scan with the
+ *          recorded timing, scaled by `scan_archive_rate`.
+ *
+ * Stamps are kept as recorded unless `scan_archive_restamp` is set, in
+ * which case every scan is stamped with the time it is published. A rate
+ * of 0 decodes and publishes as fast as possible, which doubles as a
+ * benchmark of the decoder.
+ */
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <boost/make_shared.hpp>
+
+#include <race_common/scan_codec.h>
+
+#include <chrono>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "scan_archive_player");
+    ros::NodeHandle n("~");
+
+    std::string in_file;
+    double rate;
+    bool loop, restamp;
+    n.param<std::string>("scan_archive_file", in_file, "scans.scnz");
+    n.param("scan_archive_rate", rate, 1.0);
+    n.param("scan_archive_loop", loop, false);
+    n.param("scan_archive_restamp", restamp, false);
+
+    race_common::ScanArchiveReader reader;
+    if(!reader.open(in_file))
+    {
+        ROS_INFO("Couldn't open %s as a scan archive... \nEXITING", in_file.c_str());
+        return -1;
+    }
+
+    // pubs
+    auto scan_pub = n.advertise<sensor_msgs::LaserScan>("/scan", 10);
+
+    size_t scans = 0, skipped = 0, pass_scans = 0;
+    double decode_time = 0.0;
+    ros::Time first_stamp;
+    ros::WallTime first_wall;
+    while(ros::ok())
+    {
+        auto scan = boost::make_shared<sensor_msgs::LaserScan>();
+        auto t0 = std::chrono::steady_clock::now();
+        auto ok = reader.next(*scan, &skipped);
+        decode_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if(!ok)
+        {
+            if(!loop || !reader.rewind())
+                break;
+            // Looping over nothing would spin forever
+            if(pass_scans == 0)
+            {
+                ROS_ERROR("No scan in %s decodes, stopping.", in_file.c_str());
+                break;
+            }
+            pass_scans = 0;
+            first_stamp = ros::Time();
+            continue;
+        }
+
+        // Hold each scan until its time since the first one, scaled
+        if(first_stamp.isZero())
+        {
+            first_stamp = scan->header.stamp;
+            first_wall = ros::WallTime::now();
+        } else if(rate > 0.0)
+        {
+            auto due = first_wall + ros::WallDuration((scan->header.stamp - first_stamp).toSec()/rate);
+            auto wait = due - ros::WallTime::now();
+            if(wait.toSec() > 0.0)
+                wait.sleep();
+        }
+
+        if(restamp)
+            scan->header.stamp = ros::Time::now();
+        scan_pub.publish(scan);
+        scans++;
+        pass_scans++;
+    }
+
+    if(scans > 0)
+        ROS_INFO("Played %zu scans (%zu undecodable), %.1f us/scan to decode",
+                 scans, skipped, 1e6*decode_time/scans);
+    return 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file scan_archiver.cpp
+ * @brief Records /scan into a compressed .scnz archive (see scan_codec.h),
+ *          the long-term alternative to bagging the scans.
+ *
+ * Encoding is a few tens of microseconds per scan, so it keeps up on the
+ * car. On shutdown it reports the archive's size against what the same
+ * messages take serialized, which is what a bag stores besides its
+ * per-message record headers.
+ */
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <race_common/scan_codec.h>
+
+#include <chrono>
+#include <string>
+
+class ScanArchiver
+{
+    private:
+        ros::NodeHandle n;
+        ros::Subscriber scan_sub;
+        ros::Timer flush_timer;
+
+        std::string out_file;
+        race_common::ScanArchiveWriter writer;
+
+        size_t scans, raw_bytes;
+        double encode_time;
+
+        static race_common::scan_codec_params load_params(const ros::NodeHandle &n)
+        {
+            race_common::scan_codec_params p;
+            double quantum, intensity_quantum;
+            n.param("scan_archive_quantum", quantum, 0.005);
+            n.param("scan_archive_intensity_quantum", intensity_quantum, 1.0);
+            n.param("scan_archive_key_interval", p.key_interval, 40);
+            p.quantum = quantum;
+            p.intensity_quantum = intensity_quantum;
+            p.key_interval = std::max(p.key_interval, 1);
+            return p;
+        }
+
+    public:
+        ScanArchiver()
+            : n(ros::NodeHandle("~")),
+              writer(load_params(n)),
+              scans(0), raw_bytes(0), encode_time(0.0)
+        {
+            n.param<std::string>("scan_archive_file", out_file, "scans.scnz");
+            if(!writer.open(out_file))
+            {
+                ROS_INFO("Couldn't open %s for writing... \nEXITING", out_file.c_str());
+                exit(-1);
+            }
+
+            // subs
+            scan_sub = n.subscribe("/scan", 10, &ScanArchiver::scan_cb, this, ros::TransportHints().tcpNoDelay());
+
+            // What's written survives a crash up to the last second
+            flush_timer = n.createTimer(ros::Duration(1.0), [this](const ros::TimerEvent &) { writer.flush(); });
+        }
+
+        ~ScanArchiver()
+        {
+            writer.close();
+            if(scans == 0)
+                return;
+            ROS_INFO("Archived %zu scans to %s: %zu bytes, %.1fx smaller than serialized, %.1f us/scan",
+                     scans, out_file.c_str(), writer.size(), (double)raw_bytes/writer.size(),
+                     1e6*encode_time/scans);
+        }
+
+        void scan_cb(const sensor_msgs::LaserScan::ConstPtr &msg)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            if(!writer.write(*msg))
+                ROS_ERROR_THROTTLE(1.0, "Couldn't write to %s.", out_file.c_str());
+            encode_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            raw_bytes += ros::serialization::serializationLength(*msg);
+            scans++;
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "scan_archiver");
+    ScanArchiver a;
+    ros::spin();
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file scan_restamper.cpp
+ * @brief Re-stamps a lidar driver's scans on the sensor's own clock:
+ *          ClockSync on the stamps of `restamp_input_topic`, each scan
+ *          republished on `restamp_output_topic` with the corrected stamp.
+ *
+ * Point the driver at /scan_raw (or remap it) and everything downstream
+ * keeps reading /scan. The scan period comes from scan_time when the
+ * driver fills it in, otherwise from the stamps themselves.
+ */
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <boost/make_shared.hpp>
+
+#include <race_common/clock_sync.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+class ScanRestamper
+{
+    private:
+        ros::NodeHandle n;
+        ros::Subscriber scan_sub;
+        ros::Publisher scan_pub;
+        ros::Timer report_timer;
+
+        race_common::ClockSync sync;
+        double max_delay;
+
+        // Correction since the last report (s)
+        double sum_shift, worst_shift;
+        int scans;
+
+        static race_common::clock_sync_params load(const ros::NodeHandle &n)
+        {
+            race_common::clock_sync_params p;
+            n.param("restamp_window", p.window, 200);
+            n.param("restamp_min_samples", p.min_samples, 20);
+            n.param("restamp_huber", p.huber, 1.5);
+            n.param("restamp_quantile", p.quantile, 0.05);
+            n.param("restamp_reset_error", p.reset_error, 0.05);
+            n.param("restamp_reset_count", p.reset_count, 5);
+            return p;
+        }
+
+    public:
+        ScanRestamper()
+            : n(ros::NodeHandle("~")), sync(load(n)), sum_shift(0.0), worst_shift(0.0), scans(0)
+        {
+            std::string input_topic, output_topic;
+            double report_period;
+            n.param<std::string>("restamp_input_topic", input_topic, "/scan_raw");
+            n.param<std::string>("restamp_output_topic", output_topic, "/scan");
+            n.param("restamp_max_delay", max_delay, 0.1);
+            n.param("restamp_report_period", report_period, 10.0);
+
+            // pubs
+            scan_pub = n.advertise<sensor_msgs::LaserScan>(output_topic, 1);
+
+            // subs
+            scan_sub = n.subscribe(input_topic, 1, &ScanRestamper::scan_cb, this, ros::TransportHints().tcpNoDelay());
+
+            if(report_period > 0.0)
+                report_timer = n.createTimer(ros::Duration(report_period), &ScanRestamper::report_cb, this);
+        }
+
+        void scan_cb(const sensor_msgs::LaserScan::ConstPtr &msg)
+        {
+            auto stamp = msg->header.stamp.toSec();
+            auto corrected = sync.correct(stamp, msg->scan_time);
+
+            // Never later than the driver's stamp, nor implausibly earlier
+            auto shift = std::min(std::max(stamp - corrected, 0.0), max_delay);
+
+            auto scan = boost::make_shared<sensor_msgs::LaserScan>(*msg);
+            scan->header.stamp = ros::Time(stamp - shift);
+            scan_pub.publish(scan);
+
+            sum_shift += shift;
+            worst_shift = std::max(worst_shift, shift);
+            scans++;
+        }
+
+        void report_cb(const ros::TimerEvent &)
+        {
+            if(scans == 0)
+                return;
+            if(sync.ready())
+                ROS_INFO("scan_restamper: period %.6f s (drift %+.1f ppm), jitter %.2f ms, correction %.2f ms mean / %.2f ms worst",
+                         sync.getPeriod(), 1e6*sync.getDrift(), 1e3*sync.getJitter(),
+                         1e3*sum_shift/scans, 1e3*worst_shift);
+            else
+                ROS_INFO("scan_restamper: %d scans passed through while the fit warms up", scans);
+            sum_shift = worst_shift = 0.0;
+            scans = 0;
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "scan_restamper");
+    ScanRestamper r;
+    ros::spin();
+    return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file scan_slicer.cpp
+ * @brief Shared preprocessing stage that cuts each consumer's angular
+ *          windows out of /scan once and publishes them as ScanSlices on
+ *          scan_slices/<consumer>.
+ *
+ * Consumers are declared in params:
+ *
+ *     slice_consumers: [wall_follow]
+ *
+ * Each consumer puts the windows it reads, as [min, max] angle pairs, on
+ * scan_slice_windows/<consumer> before it subscribes, so they follow its
+ * own params; they are read again whenever it (re)connects. A fixed list
+ * in this node's slices/<consumer> takes precedence, for consumers that
+ * don't publish theirs:
+ *
+ *     slices:
+ *       other: [0.35, 1.58, -1.58, -0.35]
+ */
+
+#include <ros/ros.h>
+#include <race_common/ScanSlices.h>
+#include <race_common/laser_scan_view.h>
+#include <race_common/scan_slices.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class ScanSlicerNode
+{
+    private:
+        ros::NodeHandle nh, n;  // topics and consumers' windows, our params
+        ros::Subscriber scan_sub;
+
+        struct consumer
+        {
+            std::string name;
+            race_common::ScanSlicer slicer;
+            ros::Publisher pub;
+            race_common::ScanSlices msg;    // reused so its vectors keep their capacity
+            bool ready;                     // has windows
+        };
+        std::vector<std::unique_ptr<consumer>> consumers;
+
+        void load(consumer &c)
+        {
+            std::vector<double> flat;
+            if(!n.getParam("slices/" + c.name, flat) && !nh.getParam("scan_slice_windows/" + c.name, flat))
+            {
+                ROS_WARN("No windows for %s yet", c.name.c_str());
+                return;
+            }
+            if(flat.size() < 2 || flat.size() % 2 != 0)
+            {
+                ROS_ERROR("Windows for %s must be a list of [min, max] angle pairs", c.name.c_str());
+                return;
+            }
+            c.slicer = race_common::ScanSlicer(race_common::ScanSlicer::fromFlat(flat));
+            c.ready = true;
+            ROS_INFO("Slicing %zu windows for %s", flat.size()/2, c.name.c_str());
+        }
+
+    public:
+        ScanSlicerNode()
+            : nh(ros::NodeHandle()), n(ros::NodeHandle("~"))
+        {
+            std::vector<std::string> names;
+            n.getParam("slice_consumers", names);
+
+            for(const auto &name : names)
+            {
+                consumers.emplace_back(new consumer{name, race_common::ScanSlicer(),
+                    ros::Publisher(), race_common::ScanSlices(), false});
+                auto c = consumers.back().get();
+                c->pub = nh.advertise<race_common::ScanSlices>("scan_slices/" + name, 1,
+                    [this, c](const ros::SingleSubscriberPublisher &) { load(*c); });
+            }
+
+            scan_sub = n.subscribe("/scan", 1, &ScanSlicerNode::scan_cb, this);
+        }
+
+        void scan_cb(const race_common::LaserScanView &msg)
+        {
+            for(auto &c : consumers)
+            {
+                if(!c->ready || c->pub.getNumSubscribers() == 0)
+                    continue;
+                c->slicer.fill(msg, c->msg);
+                c->pub.publish(c->msg);
+            }
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "scan_slicer");
+    ScanSlicerNode s;
+    ros::spin();
+    return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file speed_map_recorder.cpp
+ * @brief Learns a speed map (see speed_map.h) from laps driven by any
+ *          controller and writes it out on shutdown.
+ *
+ * Every cell remembers the fastest speed the car went through it. Cells
+ * driven in the moments before an emergency brake are backed off and
+ * capped, so the next map does not push there again. The written speed
+ * is the learned one scaled by `speed_map_gain`, which is how the map
+ * pushes a little harder lap over lap.
+ */
+
+#include <ros/ros.h>
+#include <nav_msgs/Odometry.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <std_msgs/Bool.h>
+
+#include <race_common/speed_map.h>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+
+class SpeedMapRecorder
+{
+    private:
+        ros::NodeHandle n;
+        ros::Subscriber odom_sub, brake_sub;
+
+        std::string out_file;
+        uint32_t width, height;
+        double resolution, origin_x, origin_y;
+        double max_speed, gain, backoff, backoff_time;
+
+        std::vector<float> learned;     // fastest speed seen per cell
+        std::vector<float> cap;         // ceiling after brake events, inf if none
+        std::deque<std::pair<ros::Time, long>> recent;
+
+    public:
+        SpeedMapRecorder()
+            : n(ros::NodeHandle("~"))
+        {
+            n.param<std::string>("speed_map_file", out_file, "speed_map.bin");
+            n.param("speed_map_resolution", resolution, 0.25);
+            n.param("speed_map_gain", gain, 1.1);
+            n.param("speed_map_backoff", backoff, 0.8);
+            n.param("speed_map_backoff_time", backoff_time, 1.0);
+            n.param("max_speed", max_speed, 7.0);
+
+            // Cover the same area as the track map
+            boost::shared_ptr<const nav_msgs::OccupancyGrid>
+                map = ros::topic::waitForMessage<nav_msgs::OccupancyGrid>("/map", n, ros::Duration(10.0));
+            if(map == NULL)
+            {
+                ROS_INFO("Couldn't get /map to size the speed map... \nEXITING");
+                exit(-1);
+            }
+            origin_x = map->info.origin.position.x;
+            origin_y = map->info.origin.position.y;
+            width = (uint32_t)std::ceil(map->info.width*map->info.resolution/resolution);
+            height = (uint32_t)std::ceil(map->info.height*map->info.resolution/resolution);
+            ROS_INFO("Recording a %ux%u speed map at %f m/cell", width, height, resolution);
+
+            learned.assign((size_t)width*height, 0.0f);
+            cap.assign((size_t)width*height, std::numeric_limits<float>::infinity());
+
+            odom_sub = n.subscribe("/odom", 10, &SpeedMapRecorder::odom_cb, this);
+            brake_sub = n.subscribe("/brake_bool", 1, &SpeedMapRecorder::brake_cb, this);
+        }
+
+        void odom_cb(const nav_msgs::Odometry &msg)
+        {
+            auto cx = (long)std::floor((msg.pose.pose.position.x - origin_x)/resolution);
+            auto cy = (long)std::floor((msg.pose.pose.position.y - origin_y)/resolution);
+            if(cx < 0 || cy < 0 || cx >= (long)width || cy >= (long)height)
+                return;
+
+            auto cell = cy*width + cx;
+            auto v = (float)std::fabs(msg.twist.twist.linear.x);
+            learned[cell] = std::max(learned[cell], v);
+
+            recent.emplace_back(msg.header.stamp, cell);
+            while(!recent.empty() && (msg.header.stamp - recent.front().first).toSec() > backoff_time)
+                recent.pop_front();
+        }
+
+        void brake_cb(const std_msgs::Bool &msg)
+        {
+            if(!msg.data)
+                return;
+
+            // Whatever we were doing right before braking was too fast
+            for(const auto &visit : recent)
+            {
+                auto cell = visit.second;
+                cap[cell] = std::min(cap[cell], (float)(learned[cell]*backoff));
+            }
+            ROS_INFO("Brake event: backed off %zu cells", recent.size());
+            recent.clear();
+        }
+
+        bool save() const
+        {
+            std::vector<float> speeds(learned.size());
+            for(size_t i = 0; i < learned.size(); i++)
+            {
+                auto v = std::isfinite(cap[i]) ? cap[i] : (float)(learned[i]*gain);
+                speeds[i] = std::min(v, (float)max_speed);
+            }
+            return race_common::SpeedMap::write(out_file, width, height, resolution,
+                origin_x, origin_y, max_speed, speeds);
+        }
+
+        const std::string &getFile() const
+        {
+            return out_file;
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "speed_map_recorder");
+    SpeedMapRecorder r;
+    ros::spin();
+
+    if(r.save())
+        ROS_INFO("Wrote speed map to %s", r.getFile().c_str());
+    else
+        ROS_ERROR("Failed to write speed map to %s", r.getFile().c_str());
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file velocity_ekf.cpp
+ * @brief Runs VelocityEKF on /imu and /odom and publishes speed and yaw
+ *          rate with covariance on /velocity_estimate at IMU rate.
+ *
+ * Odometry is fused when it arrives, without predicting to its stamp: it
+ * is slower than the IMU and its delay is within one IMU period.
+ */
+
+#include <ros/ros.h>
+#include <geometry_msgs/TwistWithCovarianceStamped.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/Imu.h>
+
+#include <race_common/velocity_ekf.h>
+
+#include <string>
+
+class VelocityEKFNode
+{
+    private:
+        ros::NodeHandle n;
+        ros::Subscriber imu_sub, odom_sub;
+        ros::Publisher estimate_pub;
+
+        race_common::VelocityEKF ekf;
+        ros::Time last_imu;
+        geometry_msgs::TwistWithCovarianceStamped msg;
+
+        static race_common::velocity_ekf_params load(const ros::NodeHandle &n)
+        {
+            race_common::velocity_ekf_params p;
+            n.param("ekf_accel_noise", p.accel_noise, 0.5);
+            n.param("ekf_yaw_accel_noise", p.yaw_accel_noise, 2.0);
+            n.param("ekf_accel_bias_walk", p.accel_bias_walk, 0.01);
+            n.param("ekf_gyro_bias_walk", p.gyro_bias_walk, 0.001);
+            n.param("ekf_gyro_std", p.gyro_std, 0.02);
+            n.param("ekf_lat_accel_std", p.lat_accel_std, 0.5);
+            n.param("ekf_odom_speed_std", p.odom_speed_std, 0.1);
+            n.param("ekf_odom_yaw_rate_std", p.odom_yaw_rate_std, 0.1);
+            n.param("ekf_max_dt", p.max_dt, 0.05);
+            return p;
+        }
+
+    public:
+        VelocityEKFNode()
+            : n(ros::NodeHandle("~")), ekf(load(n))
+        {
+            std::string imu_topic, odom_topic, base_frame;
+            n.param<std::string>("imu_topic", imu_topic, "/imu");
+            n.param<std::string>("odom_topic", odom_topic, "/odom");
+            n.param<std::string>("base_frame", base_frame, "base_link");
+            msg.header.frame_id = base_frame;
+            for(auto &c : msg.twist.covariance)
+                c = 0.0;
+
+            // pubs
+            estimate_pub = n.advertise<geometry_msgs::TwistWithCovarianceStamped>("/velocity_estimate", 1);
+
+            // subs
+            imu_sub = n.subscribe(imu_topic, 10, &VelocityEKFNode::imu_cb, this, ros::TransportHints().tcpNoDelay());
+            odom_sub = n.subscribe(odom_topic, 1, &VelocityEKFNode::odom_cb, this, ros::TransportHints().tcpNoDelay());
+        }
+
+        void imu_cb(const sensor_msgs::Imu &imu)
+        {
+            // Time going backwards means a bag was restarted
+            if(!last_imu.isZero() && imu.header.stamp < last_imu)
+            {
+                ROS_WARN("IMU time went backwards, resetting the velocity EKF.");
+                ekf.reset();
+                last_imu = ros::Time();
+            }
+            if(!last_imu.isZero())
+                ekf.predict((imu.header.stamp - last_imu).toSec(), imu.linear_acceleration.x);
+            last_imu = imu.header.stamp;
+
+            ekf.update_imu(imu.angular_velocity.z, imu.linear_acceleration.y);
+            publish(imu.header.stamp);
+        }
+
+        void odom_cb(const nav_msgs::Odometry &odom)
+        {
+            ekf.update_odom(odom.twist.twist.linear.x, odom.twist.twist.angular.z);
+        }
+
+        void publish(const ros::Time &stamp)
+        {
+            using E = race_common::VelocityEKF;
+            const auto &P = ekf.covariance();
+
+            // 6x6 row major over (x, y, z, rot x, rot y, rot z)
+            msg.header.stamp = stamp;
+            msg.twist.twist.linear.x = ekf.speed();
+            msg.twist.twist.angular.z = ekf.yaw_rate();
+            msg.twist.covariance[0] = P(E::V, E::V);
+            msg.twist.covariance[5] = msg.twist.covariance[30] = P(E::V, E::R);
+            msg.twist.covariance[35] = P(E::R, E::R);
+            estimate_pub.publish(msg);
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "velocity_ekf");
+    VelocityEKFNode node;
+    ros::spin();
+    return 0;
+}
@@ -0,0 +1,299 @@
+/**
+ * @file braking_table.h
+ * @brief Per-speed, per-beam braking thresholds from the car's reachable
+ *          set, so the runtime check is one compare per beam.
+ *
+ * For a speed bin the reachable set is everything the car's footprint can
+ * cover if it brakes at `max_decel` after `latency`, under any steering
+ * the tires allow: curvature up to tan(max_steer)/wheelbase and, at speed,
+ * the friction limit mu*g/v^2. Constant-curvature arcs spanning that range
+ * are driven to a stop and every beam is cast against the footprint box
+ * at each step; a beam's threshold is the furthest the set reaches along
+ * it. A range below its threshold means the obstacle can still be reached,
+ * so we have to brake now.
+ *
+ * Speeds are binned up (a bin's table is built for its top speed) and
+ * reverse driving has its own tables, mirrored front to back.
+ */
+#pragma once
+
+#include <ros/ros.h>
+#include <race_common/car_geometry.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace safety_node
+{
+
+struct braking_params
+{
+    race_common::car_intrinsics car;
+    double max_steer;       // rad
+    double friction;        // tire friction coefficient
+    double max_decel;       // m/s^2
+    double latency;         // s from the scan to the brakes acting
+    double max_speed;       // m/s
+    double speed_step;      // width of a speed bin (m/s)
+    int steer_samples;      // arcs per bin, spread over the curvature range
+};
+
+// Car limits from the simulator's params.yaml, the rest from braking_* params
+inline braking_params load_braking_params(const ros::NodeHandle &n)
+{
+    braking_params p;
+    n.param("wheelbase", p.car.wheelbase, 0.3302);
+    n.param("width", p.car.width, 0.2032);
+    n.param("scan_distance_to_base_link", p.car.base_link, 0.275);
+    n.param("max_steering_angle", p.max_steer, 0.4189);
+    n.param("friction_coeff", p.friction, 0.523);
+    n.param("max_decel", p.max_decel, 8.26);
+    n.param("max_speed", p.max_speed, 7.0);
+    n.param("braking_latency", p.latency, 0.05);
+    n.param("braking_speed_step", p.speed_step, 0.25);
+    n.param("braking_steer_samples", p.steer_samples, 15);
+    p.speed_step = std::max(p.speed_step, 0.01);
+    p.steer_samples = std::max(p.steer_samples, 1);
+    return p;
+}
+
+struct braking_table_header
+{
+    char magic[4];          // "BRKT"
+    uint32_t version;
+    uint32_t num_bins, num_beams;
+    float speed_step;
+    float angle_min, angle_increment;
+};
+
+class BrakingTable
+{
+    private:
+        braking_table_header header;
+        std::vector<float> table;   // [direction][bin][beam], forward first
+
+        std::vector<double> beam_cos, beam_sin;
+
+        // Where the ray along `beam` leaves the footprint box, if it crosses it
+        void cast(const race_common::car_intrinsics &car, double ox, double oy,
+                  double c, double s, int beam, float *row) const
+        {
+            // Ray direction in the box frame (slab test against [0, wheelbase] x [-w/2, w/2])
+            auto dx = c*beam_cos[beam] + s*beam_sin[beam];
+            auto dy = -s*beam_cos[beam] + c*beam_sin[beam];
+            double t_near = 0.0, t_far = 1e9;
+            const double lo[2] = {0.0, -car.width/2.0}, hi[2] = {car.wheelbase, car.width/2.0};
+            const double o[2] = {ox, oy}, d[2] = {dx, dy};
+            for(int k = 0; k < 2; k++)
+            {
+                if(std::fabs(d[k]) < 1e-12)
+                {
+                    if(o[k] < lo[k] || o[k] > hi[k])
+                        return;
+                    continue;
+                }
+                auto t0 = (lo[k] - o[k])/d[k], t1 = (hi[k] - o[k])/d[k];
+                if(t0 > t1)
+                    std::swap(t0, t1);
+                t_near = std::max(t_near, t0);
+                t_far = std::min(t_far, t1);
+            }
+            if(t_near <= t_far)
+                row[beam] = std::max(row[beam], (float)t_far);
+        }
+
+        // Furthest the footprint gets along each beam while driving one arc to a stop
+        void sweep_arc(const braking_params &p, const race_common::lidar_intrinsics &lidar,
+                       double v0, double dir, double kappa_frac, float *row) const
+        {
+            const double g = 9.81, dt = 0.005, max_ds = 0.02;
+            const double kappa_geom = std::tan(p.max_steer)/p.car.wheelbase;
+            const double half_w = p.car.width/2.0;
+            const int full_turn = (int)std::lround(2.0*M_PI/lidar.scan_inc);
+
+            double x = 0.0, y = 0.0, yaw = 0.0, v = v0, t = 0.0;
+            while(true)
+            {
+                // Lidar in the frame of the box (rear axle to front axle, `width` wide)
+                auto c = std::cos(yaw), s = std::sin(yaw);
+                auto ox = c*(p.car.base_link - x) + s*(0.0 - y);
+                auto oy = -s*(p.car.base_link - x) + c*(0.0 - y);
+
+                if(ox >= 0.0 && ox <= p.car.wheelbase && std::fabs(oy) <= half_w)
+                {
+                    // Lidar inside the box: every beam leaves it
+                    for(int b = 0; b < lidar.num_scans; b++)
+                        cast(p.car, ox, oy, c, s, b, row);
+                } else
+                {
+                    // Only the beams between the corners can hit it
+                    auto center = std::atan2(y + s*p.car.wheelbase/2.0, x + c*p.car.wheelbase/2.0 - p.car.base_link);
+                    double span = 0.0;
+                    for(auto fx : {0.0, p.car.wheelbase})
+                        for(auto fy : {-half_w, half_w})
+                        {
+                            auto a = std::atan2(y + s*fx + c*fy, x + c*fx - s*fy - p.car.base_link) - center;
+                            span = std::max(span, std::fabs(std::remainder(a, 2.0*M_PI)));
+                        }
+                    auto k0 = (int)std::floor((center - span - lidar.min_angle)/lidar.scan_inc) - 1;
+                    auto k1 = (int)std::ceil((center + span - lidar.min_angle)/lidar.scan_inc) + 1;
+                    for(int k = k0; k <= k1; k++)
+                    {
+                        auto b = k;
+                        if(b < 0) b += full_turn;
+                        else if(b >= lidar.num_scans) b -= full_turn;
+                        if(b >= 0 && b < lidar.num_scans)
+                            cast(p.car, ox, oy, c, s, b, row);
+                    }
+                }
+
+                if(v <= 0.0)
+                    break;
+
+                auto kappa_max = v > 1e-3 ? std::min(kappa_geom, p.friction*g/(v*v)) : kappa_geom;
+                auto ds = std::min(v*dt, max_ds);
+                auto h = ds/v;
+                x += dir*ds*std::cos(yaw);
+                y += dir*ds*std::sin(yaw);
+                yaw += dir*ds*kappa_frac*kappa_max;
+                t += h;
+                if(t > p.latency)
+                    v = std::max(0.0, v - p.max_decel*h);
+            }
+        }
+
+        void build_bin(const braking_params &p, const race_common::lidar_intrinsics &lidar,
+                       double v0, double dir, float *row)
+        {
+            std::fill(row, row + header.num_beams, 0.0f);
+            for(int k = 0; k < p.steer_samples; k++)
+            {
+                auto frac = p.steer_samples == 1 ? 0.0 : 2.0*k/(p.steer_samples - 1) - 1.0;
+                sweep_arc(p, lidar, v0, dir, frac, row);
+            }
+        }
+
+    public:
+        static constexpr uint32_t VERSION = 1;
+
+        BrakingTable()
+        {
+            std::memset(&header, 0, sizeof(header));
+        }
+
+        void build(const braking_params &p, const race_common::lidar_intrinsics &lidar)
+        {
+            std::memcpy(header.magic, "BRKT", 4);
+            header.version = VERSION;
+            header.num_bins = (uint32_t)std::ceil(p.max_speed/p.speed_step) + 1;
+            header.num_beams = lidar.num_scans;
+            header.speed_step = p.speed_step;
+            header.angle_min = lidar.min_angle;
+            header.angle_increment = lidar.scan_inc;
+
+            beam_cos.resize(lidar.num_scans);
+            beam_sin.resize(lidar.num_scans);
+            for(int b = 0; b < lidar.num_scans; b++)
+            {
+                beam_cos[b] = std::cos(lidar.min_angle + b*lidar.scan_inc);
+                beam_sin[b] = std::sin(lidar.min_angle + b*lidar.scan_inc);
+            }
+
+            table.assign(2*header.num_bins*header.num_beams, 0.0f);
+            for(int d = 0; d < 2; d++)
+                for(uint32_t b = 0; b < header.num_bins; b++)
+                    build_bin(p, lidar, b*p.speed_step, d == 0 ? 1.0 : -1.0,
+                              &table[(d*header.num_bins + b)*header.num_beams]);
+        }
+
+        bool open(const std::string &path)
+        {
+            FILE *f = std::fopen(path.c_str(), "rb");
+            if(f == nullptr)
+                return false;
+
+            braking_table_header hdr;
+            auto ok = std::fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+                      std::memcmp(hdr.magic, "BRKT", 4) == 0 && hdr.version == VERSION &&
+                      hdr.num_bins > 0 && hdr.speed_step > 0.0f;
+            if(ok)
+            {
+                table.resize(2*(size_t)hdr.num_bins*hdr.num_beams);
+                ok = std::fread(table.data(), sizeof(float), table.size(), f) == table.size();
+            }
+            std::fclose(f);
+
+            if(ok)
+                header = hdr;
+            else
+                table.clear();
+            return ok;
+        }
+
+        bool write(const std::string &path) const
+        {
+            FILE *f = std::fopen(path.c_str(), "wb");
+            if(f == nullptr)
+                return false;
+            auto ok = std::fwrite(&header, sizeof(header), 1, f) == 1 &&
+                      std::fwrite(table.data(), sizeof(float), table.size(), f) == table.size();
+            return std::fclose(f) == 0 && ok;
+        }
+
+        // The table only applies to the scan layout it was built for
+        bool matches(const race_common::lidar_intrinsics &lidar) const
+        {
+            return !table.empty() && header.num_beams == (uint32_t)lidar.num_scans &&
+                   std::fabs(header.angle_min - lidar.min_angle) < 1e-4 &&
+                   std::fabs(header.angle_increment - lidar.scan_inc) < 1e-6;
+        }
+
+        // Fastest speed the table covers (m/s)
+        double maxSpeed() const
+        {
+            return (header.num_bins - 1)*(double)header.speed_step;
+        }
+
+        // Thresholds for `speed`, rounded up to the next bin; nullptr past
+        // maxSpeed(), where the table can't say what is safe
+        const float *row(double speed) const
+        {
+            auto bin = std::ceil(std::fabs(speed)/header.speed_step);
+            if(!(bin < header.num_bins))
+                return nullptr;
+            auto d = speed < 0.0 ? 1 : 0;
+            return &table[(d*header.num_bins + (uint32_t)bin)*header.num_beams];
+        }
+
+        uint32_t beams() const
+        {
+            return header.num_beams;
+        }
+};
+
+/**
+ * @brief True if beam range `r` is a real return inside the reachable set.
+ *          Anything outside [lo, hi] (NaN, inf, and the 0 or below
+ *          range_min some drivers report for no return) never is.
+ */
+inline bool inside(float r, float threshold, float lo, float hi)
+{
+    return (r >= lo) & (r <= hi) & (r < threshold);
+}
+
+// True if any beam is inside the reachable set
+inline bool must_brake(const float *r, const float *threshold, size_t n, float lo, float hi)
+{
+    int hit = 0;
+    for(size_t i = 0; i < n; i++)
+        hit |= inside(r[i], threshold[i], lo, hi);
+    return hit != 0;
+}
+
+} // namespace safety_node
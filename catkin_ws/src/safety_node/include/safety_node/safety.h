@@ -0,0 +1,334 @@
+/**
+ * @file safety.h
+ * @brief Emergency braking: the reachable-set table check on every scan,
+ *          then the swept footprint against remembered hits.
+ *
+ * Topics are resolved in the namespace of the NodeHandle it is given, so
+ * several cars can run in one process (see multi_car_sim).
+ */
+#pragma once
+
+#include <ros/ros.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/LaserScan.h>
+#include <ackermann_msgs/AckermannDriveStamped.h>
+#include <std_msgs/Bool.h>
+#include <race_common/LidarHealth.h>
+#include <race_common/car_geometry.h>
+#include <race_common/laser_scan_view.h>
+#include <race_common/scan_tables.h>
+#include <race_common/velocity_input.h>
+#include <race_common/viz_publisher.h>
+#include <safety_node/braking_table.h>
+#include <safety_node/swept_footprint.h>
+#include <cmath> 
+#include <limits>
+#include <memory>
+#include <vector>
+
+class Safety {
+// The class that handles emergency braking
+private:
+    ros::NodeHandle nh, n;   // topics, params
+
+    ros::Subscriber scan_sub, odom_sub, health_sub, velocity_sub; 
+    ros::Publisher brake_pub, speed_pub; 
+
+    // Info to perform emergency braking 
+    race_common::lidar_intrinsics lidar; 
+    std::shared_ptr<const safety_node::BrakingTable> braking; 
+    std::shared_ptr<const race_common::ScanTables> tables; 
+    race_common::VelocityInput velocity; 
+    double speed;
+
+    // Short-term memory of hits, checked against the footprint swept
+    // until we'd stop on the arc we're driving
+    std::unique_ptr<safety_node::SweptFootprint> footprint; 
+    safety_node::pose2d pose; 
+    double yaw_rate, max_curvature, latency, max_decel; 
+
+    // Conservative mode while lidar_health reports a bad lidar: thresholds
+    // of a faster speed bin, and a frozen lidar means we're blind
+    bool lidar_healthy, lidar_frozen; 
+    double conservative_speed_factor; 
+
+    // Time-to-collision heatmap on safety_markers while someone watches it
+    race_common::VizPublisher viz; 
+    double viz_ttc_max; 
+
+    // Data to publish
+    struct {
+        std_msgs::Bool brake;
+        ackermann_msgs::AckermannDriveStamped speed;    
+    } brake_msg; 
+
+public:
+    /**
+     * @param nh      topics are resolved in its namespace
+     * @param pnh     params are read from it
+     * @param shared_braking, shared_tables  tables built once for every
+     *                car with this lidar (multi-car runs); built or
+     *                loaded here when null or for another lidar
+     */
+    Safety(ros::NodeHandle nh = ros::NodeHandle(), ros::NodeHandle pnh = ros::NodeHandle("~"),
+           std::shared_ptr<const safety_node::BrakingTable> shared_braking = nullptr,
+           std::shared_ptr<const race_common::ScanTables> shared_tables = nullptr) 
+        : nh(nh), n(pnh)
+    {
+        ROS_INFO("Initializing emergency brake configs."); 
+        speed = 0.0; 
+        yaw_rate = 0.0; 
+        pose = {0.0, 0.0, 0.0}; 
+        lidar_healthy = true; 
+        lidar_frozen = false; 
+        n.param("conservative_speed_factor", conservative_speed_factor, 1.5); 
+
+        double velocity_timeout; 
+        n.param("velocity_estimate_timeout", velocity_timeout, 0.1); 
+        velocity = race_common::VelocityInput(velocity_timeout); 
+
+        // Initialize brake message
+        brake_msg.brake.data = false; 
+        brake_msg.speed.drive.speed = 0.0; 
+        
+        
+        // n.getParam("scan_beams", lidar.num_scans); 
+        
+        // Listening to one scan message to grab LIDAR instrinsics 
+        boost::shared_ptr<const sensor_msgs::LaserScan> 
+            shared = ros::topic::waitForMessage<sensor_msgs::LaserScan>("scan", nh, ros::Duration(10));
+        
+        if( shared != NULL )
+        {
+            lidar.scan_inc = shared->angle_increment;
+            lidar.max_angle = shared->angle_max; 
+            lidar.min_angle = shared->angle_min; 
+            
+            //
+            // TODO(nmm) make these extrinsics automated and organize
+            //
+            n.getParam("scan_beams", lidar.num_scans); 
+            
+            ROS_INFO(""); 
+            ROS_INFO("Min Angle:\t%f", lidar.min_angle);
+            ROS_INFO("Max Andgle:\t%f", lidar.max_angle); 
+            ROS_INFO("Scan Incr:\t%f", lidar.scan_inc);  
+            ROS_INFO("Num scans:\t%d", lidar.num_scans); 
+            ROS_INFO("");
+        } 
+
+        /*
+        One publisher should publish to the /brake topic with an
+        ackermann_msgs/AckermannDriveStamped brake message.
+
+        One publisher should publish to the /brake_bool topic with a
+        std_msgs/Bool message.
+
+        You should also subscribe to the /scan topic to get the
+        sensor_msgs/LaserScan messages and the /odom topic to get
+        the nav_msgs/Odometry messages
+
+        The subscribers should use the provided odom_callback and 
+        scan_callback as callback methods
+
+        NOTE that the x component of the linear velocity in odom is the speed
+        */
+
+        // [ Pubs ]
+            /* Brake-bool Publisher */
+        brake_pub = nh.advertise<std_msgs::Bool>("brake_bool", 1); 
+            /* Brake-speed Publisher */
+        speed_pub = nh.advertise<ackermann_msgs::AckermannDriveStamped>("brake", 1); 
+            /* TTC marker Publisher, markers are only built while it has subscribers */
+        double viz_rate; 
+        n.param("viz_rate", viz_rate, 10.0); 
+        n.param("viz_ttc_max", viz_ttc_max, 2.0); 
+        viz = race_common::VizPublisher(nh, "safety_markers", viz_rate); 
+
+        // [ Subs ]
+            /* Scan Subscriber*/
+        scan_sub = nh.subscribe("scan", 1, &Safety::scan_callback, this);
+            /* Odom Subscriber */ 
+        odom_sub = nh.subscribe("odom", 1, &Safety::odom_callback, this); 
+            /* EKF velocity Subscriber, /odom's twist is the fallback */
+        velocity_sub = nh.subscribe("velocity_estimate", 1, &Safety::velocity_callback, this, 
+                                   ros::TransportHints().tcpNoDelay()); 
+            /* Lidar health Subscriber */
+        health_sub = nh.subscribe("lidar_health", 1, &Safety::health_callback, this); 
+
+        n.getParam("scan_beams", lidar.num_scans);
+
+        // Reachable-set thresholds, precomputed by braking_table_generator;
+        // built here instead if the file is missing or for another lidar
+        std::string table_file; 
+        n.param<std::string>("braking_table_file", table_file, ""); 
+        auto table = std::make_shared<safety_node::BrakingTable>(); 
+        if(shared_braking != nullptr && shared_braking->matches(lidar))
+        {
+            table = nullptr; 
+            braking = shared_braking; 
+        } else if(!table_file.empty() && table->open(table_file) && table->matches(lidar))
+        {
+            ROS_INFO("Loaded braking table %s", table_file.c_str()); 
+        } else if(shared != NULL) 
+        {
+            ROS_WARN("No usable braking table at '%s', building it now.", table_file.c_str()); 
+            table->build(safety_node::load_braking_params(n), lidar); 
+        } else 
+        {
+            ROS_WARN("No scan to build the braking table from; braking is disabled."); 
+        }
+        if(table != nullptr)
+            braking = table; 
+
+        if(shared_tables != nullptr && shared_tables->lidar.num_scans == lidar.num_scans)
+            tables = shared_tables; 
+        else if(shared != NULL)
+            tables = std::make_shared<const race_common::ScanTables>(safety_node::load_braking_params(n).car, 
+                                                                      race_common::ScanTables::layout(*shared)); 
+
+        bool use_footprint; 
+        n.param("use_swept_footprint", use_footprint, true); 
+        if(use_footprint)
+        {
+            auto bp = safety_node::load_braking_params(n); 
+            double resolution, extent, margin; 
+            int memory; 
+            n.param("footprint_grid_resolution", resolution, 0.05); 
+            n.param("footprint_grid_extent", extent, 4.0); 
+            n.param("footprint_margin", margin, 0.05); 
+            n.param("footprint_memory_scans", memory, 10); 
+            footprint.reset(new safety_node::SweptFootprint(bp.car, resolution, extent, margin, memory)); 
+            max_curvature = std::tan(bp.max_steer)/bp.car.wheelbase; 
+            latency = bp.latency; 
+            max_decel = bp.max_decel; 
+        }
+    }   
+
+    void publish_brake()
+    {
+        brake_msg.brake.data = true; 
+        speed_pub.publish(brake_msg.speed); 
+        brake_pub.publish(brake_msg.brake); 
+    }
+
+    // Beams colored by time to collision at the current speed, red at 0
+    // through green at viz_ttc_max and beyond
+    void post_markers(const race_common::LaserScanView &scan) 
+    {
+        std::vector<float> ranges(scan.ranges.begin(), scan.ranges.end()); 
+        auto header = scan.header; 
+        auto angle_min = scan.angle_min, inc = scan.angle_increment; 
+        auto lo = scan.range_min, hi = scan.range_max; 
+        auto v = speed, ttc_max = viz_ttc_max; 
+
+        viz.post([=](visualization_msgs::MarkerArray &out) {
+            auto m = race_common::viz::marker(header, "ttc", 0, visualization_msgs::Marker::POINTS, 0.05); 
+            m.points.reserve(ranges.size()); 
+            m.colors.reserve(ranges.size()); 
+            for(size_t i = 0; i < ranges.size(); i++)
+            {
+                auto r = ranges[i]; 
+                if(!(r >= lo && r <= hi))
+                    continue; 
+                auto a = angle_min + i*inc; 
+                auto closing = v*std::cos(a); 
+                auto ttc = closing > 0.0 ? r/closing : std::numeric_limits<double>::infinity(); 
+                m.points.push_back(race_common::viz::point(r*std::cos(a), r*std::sin(a))); 
+                m.colors.push_back(race_common::viz::heat(ttc/ttc_max)); 
+            }
+            out.markers.push_back(m); 
+        }); 
+    }
+
+    void odom_callback(const nav_msgs::Odometry::ConstPtr &odom_msg) 
+    {
+        velocity.from_odom(*odom_msg); 
+        speed = velocity.speed(); // Update current speed. 
+        yaw_rate = velocity.yaw_rate(); 
+
+        const auto &p = odom_msg->pose.pose; 
+        pose.x = p.position.x; 
+        pose.y = p.position.y; 
+        pose.yaw = std::atan2(2.0*(p.orientation.w*p.orientation.z + p.orientation.x*p.orientation.y), 
+                              1.0 - 2.0*(p.orientation.y*p.orientation.y + p.orientation.z*p.orientation.z)); 
+    }
+
+    void velocity_callback(const geometry_msgs::TwistWithCovarianceStamped::ConstPtr &velocity_msg) 
+    {
+        velocity.from_estimate(*velocity_msg); 
+        speed = velocity.speed(); 
+        yaw_rate = velocity.yaw_rate(); 
+    }
+
+    void health_callback(const race_common::LidarHealth::ConstPtr &health_msg) 
+    {
+        if(health_msg->healthy != lidar_healthy)
+            ROS_WARN("Lidar %s, %s conservative mode.", health_msg->healthy ? "healthy" : "unhealthy", 
+                     health_msg->healthy ? "leaving" : "entering"); 
+        lidar_healthy = health_msg->healthy; 
+        lidar_frozen = health_msg->frozen; 
+    }
+
+    void scan_callback(const race_common::LaserScanView::ConstPtr &scan_msg) 
+    {   
+        if(footprint)
+            footprint->add_scan(*scan_msg, pose, tables.get()); 
+        if(viz.wanted())
+            post_markers(*scan_msg); 
+
+        if( speed != 0)
+        {
+            // Old data republished: nothing in it can be trusted
+            if(lidar_frozen)
+            {
+                publish_brake(); 
+                ROS_INFO_THROTTLE(1.0, "E-BRAKE:\tlidar frozen"); 
+                return; 
+            }
+
+            // If the array sizes don't match then we won't continue with the scan
+            if(scan_msg->ranges.size() != braking->beams()) 
+            {
+                ROS_INFO_ONCE("Scan size does match precomputed size(%zu != %u)",
+                    scan_msg->ranges.size(), braking->beams()); 
+            } else 
+            {
+                // Any beam inside what we can still reach at this speed
+                auto v = lidar_healthy ? speed : speed*conservative_speed_factor; 
+                auto threshold = braking->row(v); 
+                if(threshold == nullptr)
+                {
+                    // Faster than the table was built for: nothing says it's safe
+                    publish_brake(); 
+                    ROS_WARN_THROTTLE(1.0, "E-BRAKE:\tspeed %.2f m/s beyond the braking table's %.2f m/s", 
+                                      v, braking->maxSpeed()); 
+                    return; 
+                }
+                const auto lo = scan_msg->range_min, hi = scan_msg->range_max; 
+                if(safety_node::must_brake(scan_msg->ranges.data(), threshold, braking->beams(), lo, hi)) 
+                { 
+                    publish_brake(); 
+
+                    size_t i = 0; 
+                    while(!safety_node::inside(scan_msg->ranges[i], threshold[i], lo, hi))
+                        i++; 
+                    ROS_INFO("E-BRAKE:\t(angle)%f", scan_msg->angle_min + i*scan_msg->angle_increment); 
+                    return; 
+                }
+            }
+
+            // Obstacles the lidar may not see anymore, on the arc we're on
+            if(footprint)
+            {
+                auto curvature = std::max(std::min(yaw_rate/speed, max_curvature), -max_curvature); 
+                auto stop = std::fabs(speed)*latency + speed*speed/(2.0*max_decel); 
+                if(footprint->collides(pose, curvature, speed > 0.0 ? stop : -stop))
+                {
+                    publish_brake(); 
+                    ROS_INFO("E-BRAKE:\tswept footprint"); 
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,219 @@
+/**
+ * @file swept_footprint.h
+ * @brief Collision check of the car's swept footprint against a short-term
+ *          occupancy memory, with the grid and the footprint as bitsets.
+ *
+ * Hits from the last few scans are kept in the odom frame, so obstacles
+ * the lidar can no longer see (beside the rear wheels while turning, in
+ * the blind sector behind) still count. Each check re-rasterizes them
+ * into an egocentric bit grid (one row per x cell, one bit per y cell),
+ * rasterizes the footprint swept along the predicted arc into a second
+ * one, and ANDs the two a 64-bit word at a time.
+ */
+#pragma once
+
+#include <race_common/car_geometry.h>
+#include <race_common/scan_tables.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace safety_node
+{
+
+struct pose2d
+{
+    double x, y, yaw;
+};
+
+class SweptFootprint
+{
+    private:
+        race_common::car_intrinsics car;
+        double res, inv_res, extent, margin;
+        int rows, cols, words;              // x cells, y cells, words per row
+
+        std::vector<uint64_t> occupied, swept;
+
+        // Hits of the last `memory` scans, odom frame, one slot per scan
+        std::vector<std::vector<float>> hits_x, hits_y;
+        size_t next_slot;
+
+        void set_span(std::vector<uint64_t> &grid, int row, int lo, int hi)
+        {
+            lo = std::max(lo, 0);
+            hi = std::min(hi, cols - 1);
+            if(row < 0 || row >= rows || lo > hi)
+                return;
+
+            auto w = &grid[row*words];
+            auto wlo = lo >> 6, whi = hi >> 6;
+            auto mlo = ~0ull << (lo & 63);
+            auto mhi = ~0ull >> (63 - (hi & 63));
+            if(wlo == whi)
+            {
+                w[wlo] |= mlo & mhi;
+                return;
+            }
+            w[wlo] |= mlo;
+            for(int i = wlo + 1; i < whi; i++)
+                w[i] = ~0ull;
+            w[whi] |= mhi;
+        }
+
+        // Scanline fill of the footprint box with base_link at (x, y, yaw)
+        void stamp_footprint(double x, double y, double yaw)
+        {
+            auto c = std::cos(yaw), s = std::sin(yaw);
+            const double fx[4] = {-margin, car.wheelbase + margin, car.wheelbase + margin, -margin};
+            const double fy[4] = {-car.width/2.0 - margin, -car.width/2.0 - margin,
+                                  car.width/2.0 + margin, car.width/2.0 + margin};
+            double px[4], py[4];
+            for(int i = 0; i < 4; i++)
+            {
+                px[i] = (x + c*fx[i] - s*fy[i] + extent)*inv_res;
+                py[i] = (y + s*fx[i] + c*fy[i] + extent)*inv_res;
+            }
+
+            auto r0 = (int)std::floor(*std::min_element(px, px + 4));
+            auto r1 = (int)std::floor(*std::max_element(px, px + 4));
+            for(int r = r0; r <= r1; r++)
+            {
+                // y extent of the box over this row (both row edges, so thin
+                // slivers at the corners aren't missed)
+                double lo = 1e9, hi = -1e9;
+                for(int i = 0; i < 4; i++)
+                {
+                    auto j = (i + 1) & 3;
+                    auto xa = std::min(px[i], px[j]), xb = std::max(px[i], px[j]);
+                    auto ca = std::max(xa, (double)r), cb = std::min(xb, (double)r + 1.0);
+                    if(ca > cb)
+                        continue;
+                    for(auto xr : {ca, cb})
+                    {
+                        auto t = xb - xa > 1e-9 ? (xr - px[i])/(px[j] - px[i]) : 0.0;
+                        auto yr = py[i] + t*(py[j] - py[i]);
+                        lo = std::min(lo, yr);
+                        hi = std::max(hi, yr);
+                    }
+                }
+                if(lo <= hi)
+                    set_span(swept, r, (int)std::floor(lo), (int)std::floor(hi));
+            }
+        }
+
+    public:
+        /**
+         * @param extent  half width of the square grid around base_link (m)
+         * @param memory  number of scans whose hits are kept
+         */
+        SweptFootprint(const race_common::car_intrinsics &car, double resolution,
+                       double extent, double margin, int memory)
+            : car(car), res(resolution), inv_res(1.0/resolution), extent(extent),
+              margin(margin), next_slot(0)
+        {
+            rows = cols = (int)std::ceil(2.0*extent*inv_res);
+            words = (cols + 63)/64;
+            occupied.resize(rows*words);
+            swept.resize(rows*words);
+            hits_x.resize(std::max(memory, 1));
+            hits_y.resize(std::max(memory, 1));
+        }
+
+        /**
+         * @brief Remember the hits of `msg`, seen from `odom` (base_link pose).
+         *
+         * @tparam Scan    sensor_msgs::LaserScan or race_common::LaserScanView
+         * @param tables   beam directions for this scan's layout, if known
+         */
+        template <typename Scan>
+        void add_scan(const Scan &msg, const pose2d &odom, const race_common::ScanTables *tables = nullptr)
+        {
+            auto &xs = hits_x[next_slot], &ys = hits_y[next_slot];
+            next_slot = (next_slot + 1) % hits_x.size();
+            xs.clear();
+            ys.clear();
+
+            if(tables != nullptr && !tables->matches(msg))
+                tables = nullptr;
+
+            auto c = std::cos(odom.yaw), s = std::sin(odom.yaw);
+            auto angle = msg.angle_min;
+            long last_cx = 0, last_cy = 0;
+            for(size_t i = 0; i < msg.ranges.size(); i++, angle += msg.angle_increment)
+            {
+                auto r = msg.ranges[i];
+                if(!(r >= msg.range_min && r <= msg.range_max) || r > 2.0*extent)
+                    continue;
+                auto bc = tables != nullptr ? tables->cos[i] : std::cos(angle);
+                auto bs = tables != nullptr ? tables->sin[i] : std::sin(angle);
+                auto bx = car.base_link + r*bc, by = r*bs;
+                auto ox = odom.x + c*bx - s*by, oy = odom.y + s*bx + c*by;
+
+                // Neighbouring beams often land in the same cell; keep one
+                auto cx = std::lround(ox*inv_res), cy = std::lround(oy*inv_res);
+                if(!xs.empty() && cx == last_cx && cy == last_cy)
+                    continue;
+                last_cx = cx;
+                last_cy = cy;
+                xs.push_back(ox);
+                ys.push_back(oy);
+            }
+        }
+
+        /**
+         * @brief True if the footprint, driven `distance` meters along an arc
+         *          of `curvature` (negative distance reverses) from `odom`,
+         *          overlaps a remembered hit.
+         */
+        bool collides(const pose2d &odom, double curvature, double distance)
+        {
+            // Remembered hits into the egocentric grid
+            std::fill(occupied.begin(), occupied.end(), 0ull);
+            const float c = std::cos(odom.yaw)*inv_res, s = std::sin(odom.yaw)*inv_res;
+            const float ox = odom.x, oy = odom.y, off = extent*inv_res;
+            for(size_t k = 0; k < hits_x.size(); k++)
+            {
+                const auto &xs = hits_x[k], &ys = hits_y[k];
+                for(size_t i = 0; i < xs.size(); i++)
+                {
+                    auto dx = xs[i] - ox, dy = ys[i] - oy;
+                    auto fr = c*dx + s*dy + off, fb = c*dy - s*dx + off;
+                    if(!(fr >= 0.0f && fb >= 0.0f))
+                        continue;
+                    auto r = (int)fr, b = (int)fb;
+                    if(r < rows && b < cols)
+                        occupied[r*words + (b >> 6)] |= 1ull << (b & 63);
+                }
+            }
+
+            // Footprint along the arc, a pose every cell; the margin covers
+            // the corners cut between poses
+            std::fill(swept.begin(), swept.end(), 0ull);
+            auto steps = std::max(1, (int)std::ceil(std::fabs(distance)/res));
+            for(int k = 0; k <= steps; k++)
+            {
+                auto d = distance*k/steps;
+                double x, y, yaw = curvature*d;
+                if(std::fabs(curvature) > 1e-6)
+                {
+                    x = std::sin(yaw)/curvature;
+                    y = (1.0 - std::cos(yaw))/curvature;
+                } else
+                {
+                    x = d;
+                    y = 0.0;
+                }
+                stamp_footprint(x, y, yaw);
+            }
+
+            uint64_t hit = 0;
+            for(size_t i = 0; i < swept.size(); i++)
+                hit |= occupied[i] & swept[i];
+            return hit != 0;
+        }
+};
+
+} // namespace safety_node
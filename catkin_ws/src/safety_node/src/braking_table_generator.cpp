@@ -0,0 +1,53 @@
+/**
+ * @file braking_table_generator.cpp
+ * @brief Builds the safety node's reachable-set braking table offline and
+ *          writes it to `braking_table_file`.
+ *
+ * Takes the lidar layout from one /scan message, so run it against the
+ * car (or simulator) the table is meant for:
+ * `roslaunch safety_node braking_table.launch`.
+ */
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+#include <safety_node/braking_table.h>
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "braking_table_generator");
+    ros::NodeHandle n("~");
+
+    std::string file;
+    if(!n.getParam("braking_table_file", file) || file.empty())
+    {
+        ROS_ERROR("Set braking_table_file to the table to write.");
+        return 1;
+    }
+
+    boost::shared_ptr<const sensor_msgs::LaserScan>
+        scan = ros::topic::waitForMessage<sensor_msgs::LaserScan>("/scan", n, ros::Duration(10.0));
+    if(scan == NULL)
+    {
+        ROS_ERROR("No scan received; can't tell the lidar layout.");
+        return 1;
+    }
+
+    race_common::lidar_intrinsics lidar;
+    lidar.min_angle = scan->angle_min;
+    lidar.max_angle = scan->angle_max;
+    lidar.scan_inc = scan->angle_increment;
+    lidar.num_scans = scan->ranges.size();
+
+    auto params = safety_node::load_braking_params(n);
+    safety_node::BrakingTable table;
+    table.build(params, lidar);
+    if(!table.write(file))
+    {
+        ROS_ERROR("Couldn't write braking table to %s", file.c_str());
+        return 1;
+    }
+
+    ROS_INFO("Wrote braking table (%d beams, 0 to %.2f m/s in %.2f m/s bins) to %s",
+             lidar.num_scans, params.max_speed, params.speed_step, file.c_str());
+    return 0;
+}
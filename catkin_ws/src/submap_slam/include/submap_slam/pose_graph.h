@@ -0,0 +1,217 @@
+/**
+ * @file pose_graph.h
+ * @brief Sparse SE(2) pose graph: submap and scan poses tied together by
+ *          relative pose constraints, solved by Gauss-Newton.
+ *
+ * Each constraint only touches two poses, so the normal equations are kept
+ * as 3x3 blocks (one per pose on the diagonal, one per constraint off it)
+ * and solved by conjugate gradient with the diagonal blocks' inverses as
+ * preconditioner. Nothing is ever factored, so a lap's worth of poses stays
+ * in the low milliseconds. The first pose is held fixed to anchor the map.
+ */
+#pragma once
+
+#include <race_common/fixed_matrix.h>
+#include <submap_slam/slam_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace submap_slam
+{
+
+struct constraint
+{
+    int i, j;           // pose j measured in pose i's frame
+    pose2d z;
+    double w_t, w_r;    // information of translation (per m^2) and yaw (per rad^2)
+    bool robust;        // Huber loss, for loop closures that may be wrong
+};
+
+class PoseGraph
+{
+    private:
+        typedef race_common::Matrix<3, 3> Mat3;
+        typedef race_common::Vector<3> Vec3;
+
+        std::vector<pose2d> poses;
+        std::vector<constraint> edges;
+
+        // Normal equations, rebuilt every iteration
+        std::vector<Mat3> diag;     // per pose
+        std::vector<Mat3> off;      // per edge, rows of i and columns of j
+        std::vector<Vec3> rhs;
+
+        // y = H x, with the fixed first pose left out
+        void multiply(const std::vector<Vec3> &x, std::vector<Vec3> &y) const
+        {
+            for(size_t k = 0; k < poses.size(); k++)
+                y[k] = diag[k]*x[k];
+            for(size_t e = 0; e < edges.size(); e++)
+            {
+                const auto &c = edges[e];
+                y[c.i] += off[e]*x[c.j];
+                y[c.j] += off[e].transpose()*x[c.i];
+            }
+            y[0] = Vec3::zeros();
+        }
+
+        static double dot(const std::vector<Vec3> &a, const std::vector<Vec3> &b)
+        {
+            double s = 0.0;
+            for(size_t k = 0; k < a.size(); k++)
+                s += a[k](0, 0)*b[k](0, 0) + a[k](1, 0)*b[k](1, 0) + a[k](2, 0)*b[k](2, 0);
+            return s;
+        }
+
+        /**
+         * @brief Linearize every constraint at the current poses.
+         * @return total (robustified) squared error
+         */
+        double build(double huber)
+        {
+            const auto n = poses.size();
+            diag.assign(n, Mat3::zeros());
+            rhs.assign(n, Vec3::zeros());
+            off.assign(edges.size(), Mat3::zeros());
+            double total = 0.0;
+
+            for(size_t e = 0; e < edges.size(); e++)
+            {
+                const auto &c = edges[e];
+                const auto &a = poses[c.i], &b = poses[c.j];
+                auto co = std::cos(a.yaw), s = std::sin(a.yaw);
+                auto dx = b.x - a.x, dy = b.y - a.y;
+
+                // e_t = R_i^T (t_j - t_i) - z_t, e_r = yaw_j - yaw_i - z_r
+                Vec3 r;
+                r(0, 0) = co*dx + s*dy - c.z.x;
+                r(1, 0) = -s*dx + co*dy - c.z.y;
+                r(2, 0) = wrap_angle(b.yaw - a.yaw - c.z.yaw);
+
+                auto chi2 = c.w_t*(r(0, 0)*r(0, 0) + r(1, 0)*r(1, 0)) + c.w_r*r(2, 0)*r(2, 0);
+                double scale = 1.0;
+                if(c.robust && chi2 > huber*huber)
+                {
+                    auto chi = std::sqrt(chi2);
+                    scale = huber/chi;
+                    total += 2.0*huber*chi - huber*huber;
+                }
+                else
+                    total += chi2;
+
+                auto A = Mat3::zeros(), B = Mat3::zeros();
+                A(0, 0) = -co; A(0, 1) = -s; A(0, 2) = -s*dx + co*dy;
+                A(1, 0) = s;   A(1, 1) = -co; A(1, 2) = -co*dx - s*dy;
+                A(2, 2) = -1.0;
+                B(0, 0) = co;  B(0, 1) = s;
+                B(1, 0) = -s;  B(1, 1) = co;
+                B(2, 2) = 1.0;
+
+                auto W = Mat3::zeros();
+                W(0, 0) = W(1, 1) = scale*c.w_t;
+                W(2, 2) = scale*c.w_r;
+                auto AtW = A.transpose()*W, BtW = B.transpose()*W;
+
+                diag[c.i] += AtW*A;
+                diag[c.j] += BtW*B;
+                off[e] = AtW*B;
+                rhs[c.i] -= AtW*r;
+                rhs[c.j] -= BtW*r;
+            }
+            return total;
+        }
+
+        // Solve H dx = rhs by preconditioned conjugate gradient
+        void solve(std::vector<Vec3> &dx, int max_iterations) const
+        {
+            const auto n = poses.size();
+            std::vector<Mat3> pre(n, Mat3::zeros());
+            for(size_t k = 1; k < n; k++)
+            {
+                auto d = diag[k];
+                for(int i = 0; i < 3; i++)
+                    d(i, i) += 1e-9;
+                if(!d.inverse(pre[k]))
+                    pre[k] = Mat3::zeros();
+            }
+
+            dx.assign(n, Vec3::zeros());
+            std::vector<Vec3> r = rhs, z(n), p(n), q(n);
+            r[0] = Vec3::zeros();
+            for(size_t k = 0; k < n; k++)
+                z[k] = pre[k]*r[k];
+            p = z;
+            auto rz = dot(r, z), r0 = rz;
+            for(int it = 0; it < max_iterations && rz > 1e-20*r0 && rz > 0.0; it++)
+            {
+                multiply(p, q);
+                auto pq = dot(p, q);
+                if(pq <= 0.0)
+                    break;
+                auto alpha = rz/pq;
+                for(size_t k = 0; k < n; k++)
+                {
+                    auto ap = p[k], aq = q[k];
+                    for(int i = 0; i < 3; i++)
+                    {
+                        ap(i, 0) *= alpha;
+                        aq(i, 0) *= alpha;
+                    }
+                    dx[k] += ap;
+                    r[k] -= aq;
+                    z[k] = pre[k]*r[k];
+                }
+                auto rz_next = dot(r, z), beta = rz_next/rz;
+                rz = rz_next;
+                for(size_t k = 0; k < n; k++)
+                    for(int i = 0; i < 3; i++)
+                        p[k](i, 0) = z[k](i, 0) + beta*p[k](i, 0);
+            }
+        }
+
+    public:
+        int addPose(const pose2d &initial)
+        {
+            poses.push_back(initial);
+            return (int)poses.size() - 1;
+        }
+
+        void addConstraint(const constraint &c) { edges.push_back(c); }
+
+        const pose2d &getPose(int k) const { return poses[k]; }
+        int numPoses() const { return (int)poses.size(); }
+        int numConstraints() const { return (int)edges.size(); }
+
+        /**
+         * @brief Gauss-Newton from the current poses.
+         * @param huber          robust constraints' squared error is linear past huber^2
+         * @return total squared error after the last iteration's linearization
+         */
+        double optimize(int iterations, int cg_iterations, double huber)
+        {
+            if(poses.size() < 2)
+                return 0.0;
+            double err = 0.0;
+            std::vector<Vec3> dx;
+            for(int it = 0; it < iterations; it++)
+            {
+                err = build(huber);
+                solve(dx, cg_iterations);
+                double step = 0.0;
+                for(size_t k = 1; k < poses.size(); k++)
+                {
+                    poses[k].x += dx[k](0, 0);
+                    poses[k].y += dx[k](1, 0);
+                    poses[k].yaw = wrap_angle(poses[k].yaw + dx[k](2, 0));
+                    step = std::max(step, std::fabs(dx[k](0, 0)) + std::fabs(dx[k](1, 0)) + std::fabs(dx[k](2, 0)));
+                }
+                if(step < 1e-5)
+                    break;
+            }
+            return err;
+        }
+};
+
+} // namespace submap_slam
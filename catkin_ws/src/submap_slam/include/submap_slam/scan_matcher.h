@@ -0,0 +1,180 @@
+/**
+ * @file scan_matcher.h
+ * @brief Scan to submap matching: Gauss-Newton refinement from a good
+ *          guess (every scan), and an exhaustive coarse-to-fine window
+ *          search for loop closures, where the guess can be far off.
+ *
+ * Poses are of the scan's frame in the submap's frame; points are in the
+ * scan's frame. A score is the mean squashed occupancy under the points:
+ * 0.5 is no better than unknown space, 1 is every point on a wall.
+ */
+#pragma once
+
+#include <race_common/fixed_matrix.h>
+#include <submap_slam/submap.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace submap_slam
+{
+
+struct refine_params
+{
+    int iterations;
+    double translation_weight;  // pull toward the prior, per m^2
+    double rotation_weight;     // per rad^2
+};
+
+struct search_params
+{
+    double linear;      // m either way of the guess
+    double angular;     // rad either way
+};
+
+/**
+ * @brief Minimize the mean (1 - occupancy)^2 under the points, regularized
+ *          toward `prior`, starting at `pose`.
+ * @return the score at the result
+ */
+inline double refine(const Submap &m, const std::vector<point2d> &pts, const pose2d &prior,
+                     pose2d &pose, const refine_params &p)
+{
+    typedef race_common::Matrix<3, 3> Mat3;
+    typedef race_common::Vector<3> Vec3;
+    if(pts.empty())
+        return 0.0;
+    const double inv_res = 1.0/m.getResolution(), inv_n = 1.0/pts.size();
+    double score = 0.0;
+
+    for(int it = 0; it < p.iterations; it++)
+    {
+        auto H = Mat3::zeros();
+        auto g = Vec3::zeros();
+        auto c = std::cos(pose.yaw), s = std::sin(pose.yaw);
+        score = 0.0;
+        for(const auto &q : pts)
+        {
+            auto wx = pose.x + c*q.x - s*q.y, wy = pose.y + s*q.x + c*q.y;
+            double gx, gy;
+            auto v = m.interpolate(m.cellX(wx), m.cellY(wy), gx, gy);
+            score += v;
+            gx *= inv_res;
+            gy *= inv_res;
+
+            // r = 1 - M(T q), J = dr/d(x, y, yaw)
+            auto r = 1.0 - v;
+            const double J[3] = {-gx, -gy, -(gx*(-s*q.x - c*q.y) + gy*(c*q.x - s*q.y))};
+            for(int i = 0; i < 3; i++)
+            {
+                g(i, 0) += J[i]*r*inv_n;
+                for(int j = 0; j < 3; j++)
+                    H(i, j) += J[i]*J[j]*inv_n;
+            }
+        }
+        score *= inv_n;
+
+        // Prior
+        H(0, 0) += p.translation_weight;
+        H(1, 1) += p.translation_weight;
+        H(2, 2) += p.rotation_weight;
+        g(0, 0) += p.translation_weight*(pose.x - prior.x);
+        g(1, 0) += p.translation_weight*(pose.y - prior.y);
+        g(2, 0) += p.rotation_weight*wrap_angle(pose.yaw - prior.yaw);
+
+        Mat3 Hinv;
+        if(!H.inverse(Hinv))
+            break;
+        auto step = Hinv*g;
+        pose.x -= step(0, 0);
+        pose.y -= step(1, 0);
+        pose.yaw = wrap_angle(pose.yaw - step(2, 0));
+        if(std::fabs(step(0, 0)) + std::fabs(step(1, 0)) < 1e-4 && std::fabs(step(2, 0)) < 1e-4)
+            break;
+    }
+    return score;
+}
+
+/**
+ * @brief Best pose within the window around `guess`, first over the
+ *          submap's coarse grid, then at full resolution around the best
+ *          coarse pose.
+ * @return the full resolution score of `best`
+ */
+inline double search(const Submap &m, const std::vector<point2d> &pts, const pose2d &guess,
+                     const search_params &p, pose2d &best)
+{
+    best = guess;
+    if(pts.empty() || !m.isFinished())
+        return 0.0;
+
+    const double res = m.getResolution();
+    const int k = m.coarseFactor();
+    double max_r = 1.0;
+    for(const auto &q : pts)
+        max_r = std::max(max_r, std::hypot((double)q.x, (double)q.y));
+
+    // Coarse: an angle step that moves the farthest point one coarse cell
+    const double coarse_res = k*res;
+    const double da = std::min(coarse_res/max_r, p.angular + 1e-9);
+    const int na = (int)std::ceil(p.angular/da);
+    const int nl = (int)std::ceil(p.linear/coarse_res);
+    const int cs = m.coarseSize();
+    const double inv_n = 1.0/pts.size();
+
+    std::vector<int> cx(pts.size()), cy(pts.size());
+    double best_coarse = -1.0;
+    pose2d best_c = guess;
+    for(int a = -na; a <= na; a++)
+    {
+        auto yaw = guess.yaw + a*da;
+        auto c = std::cos(yaw), s = std::sin(yaw);
+        for(size_t i = 0; i < pts.size(); i++)
+        {
+            const auto &q = pts[i];
+            cx[i] = (int)std::floor((m.cellX(guess.x + c*q.x - s*q.y) + 0.5)/k);
+            cy[i] = (int)std::floor((m.cellY(guess.y + s*q.x + c*q.y) + 0.5)/k);
+        }
+        for(int dy = -nl; dy <= nl; dy++)
+            for(int dx = -nl; dx <= nl; dx++)
+            {
+                double sum = 0.0;
+                for(size_t i = 0; i < pts.size(); i++)
+                {
+                    auto x = cx[i] + dx, y = cy[i] + dy;
+                    sum += (x < 0 || y < 0 || x >= cs || y >= cs) ? 0.5f : m.coarseAt(x, y);
+                }
+                if(sum*inv_n > best_coarse)
+                {
+                    best_coarse = sum*inv_n;
+                    best_c = {guess.x + dx*coarse_res, guess.y + dy*coarse_res, wrap_angle(yaw)};
+                }
+            }
+    }
+
+    // Fine: full resolution cells and angle steps around the coarse best
+    const double fa = da/k;
+    double best_fine = -1.0;
+    for(int a = -k; a <= k; a++)
+    {
+        auto yaw = best_c.yaw + a*fa;
+        auto c = std::cos(yaw), s = std::sin(yaw);
+        for(int dy = -k; dy <= k; dy++)
+            for(int dx = -k; dx <= k; dx++)
+            {
+                auto x0 = best_c.x + dx*res, y0 = best_c.y + dy*res;
+                double sum = 0.0;
+                for(const auto &q : pts)
+                    sum += m.nearest(m.cellX(x0 + c*q.x - s*q.y), m.cellY(y0 + s*q.x + c*q.y));
+                if(sum*inv_n > best_fine)
+                {
+                    best_fine = sum*inv_n;
+                    best = {x0, y0, wrap_angle(yaw)};
+                }
+            }
+    }
+    return best_fine;
+}
+
+} // namespace submap_slam
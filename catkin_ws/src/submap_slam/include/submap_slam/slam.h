@@ -0,0 +1,482 @@
+/**
+ * @file slam.h
+ * @brief Submap SLAM without ROS: a front end that tracks the car against
+ *          the newest submaps on every scan, and a back end thread that
+ *          closes loops and optimizes the pose graph.
+ *
+ * The front end works in a "local" frame that drifts: each scan's pose is
+ * predicted from odometry and refined against the older of the two active
+ * submaps, and once the car has moved far enough it is inserted into both
+ * and becomes a node. Every `scans` insertions the older submap is
+ * finished and a new one started, so consecutive submaps overlap by half.
+ *
+ * Nothing on that path waits for the back end: nodes and finished submaps
+ * are queued under a mutex, and the only thing read back is the correction
+ * from the local to the optimized ("global") frame, one pose. The back end
+ * searches finished submaps near each node for a loop closure, optimizes
+ * when one is found (and every so often otherwise), and renders the
+ * finished submaps into an occupancy map at their optimized poses.
+ */
+#pragma once
+
+#include <submap_slam/pose_graph.h>
+#include <submap_slam/scan_matcher.h>
+#include <submap_slam/submap.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace submap_slam
+{
+
+struct slam_params
+{
+    submap_params submap;
+    refine_params refine;
+    search_params loop_search;
+
+    double match_spacing;       // m between points kept for matching
+    double insert_distance;     // m, rad, s since the last node before the next
+    double insert_angle;
+    double insert_time;
+
+    double loop_radius;         // m from a node to a finished submap's center
+    double loop_min_score;      // search score to accept a closure
+    int loop_skip_submaps;      // most recent finished submaps not searched
+    int loop_every;             // nodes between closure attempts
+
+    double intra_weight_t, intra_weight_r;  // node in its own submaps
+    double loop_weight_t, loop_weight_r;    // node in a loop closure submap
+    double huber;
+
+    int optimize_every;         // nodes between optimizations without a closure
+    int optimize_iterations;
+    int cg_iterations;
+
+    double map_resolution;      // m per cell of the rendered map
+    float map_occupied, map_free;   // log-odds thresholds
+};
+
+// Occupancy grid in the global frame, values as in nav_msgs/OccupancyGrid
+struct occupancy_map
+{
+    double origin_x, origin_y, resolution;
+    int width, height;
+    std::vector<int8_t> data;
+};
+
+struct slam_stats
+{
+    int nodes, submaps, loop_closures;
+    double last_optimize_ms;
+};
+
+class SubmapSlam
+{
+    private:
+        struct node_work
+        {
+            pose2d local;
+            std::vector<point2d> points;    // base frame, for loop closure
+            std::vector<std::pair<int, pose2d>> in_submaps;  // submap id, pose in it
+        };
+
+        struct submap_work
+        {
+            int id;
+            pose2d local;
+        };
+
+        slam_params p;
+
+        // Front end, scan thread only
+        std::vector<std::pair<int, std::shared_ptr<Submap>>> active;
+        int next_submap;
+        bool have_pose;
+        pose2d local, last_odom, last_node;
+        double last_node_time;
+        std::vector<point2d> match_pts, hits_local, misses_local;
+
+        // Shared
+        std::mutex mtx;
+        std::condition_variable wake;
+        bool stop;
+        std::vector<submap_work> new_submaps;
+        std::vector<std::pair<int, std::shared_ptr<Submap>>> new_finished;
+        std::vector<node_work> new_nodes;
+        pose2d correction;      // local -> global
+        occupancy_map map;
+        bool map_fresh;
+        slam_stats stats;
+
+        // Back end, its thread only
+        PoseGraph graph;
+        std::vector<int> submap_var, node_var;
+        std::vector<pose2d> node_local;
+        std::vector<std::vector<point2d>> node_points;
+        std::vector<std::vector<int>> node_submaps;
+        std::vector<std::shared_ptr<Submap>> finished;  // by submap id, null until finished
+        std::vector<int> finished_order;
+        std::thread worker;
+
+        // Keep scan points at least match_spacing apart, in scan order
+        void thin(const std::vector<point2d> &pts, std::vector<point2d> &out) const
+        {
+            out.clear();
+            const auto d2 = p.match_spacing*p.match_spacing;
+            for(const auto &q : pts)
+            {
+                if(!out.empty())
+                {
+                    auto dx = q.x - out.back().x, dy = q.y - out.back().y;
+                    if(dx*dx + dy*dy < d2)
+                        continue;
+                }
+                out.push_back(q);
+            }
+        }
+
+        void startSubmap(const pose2d &origin)
+        {
+            auto id = next_submap++;
+            active.emplace_back(id, std::make_shared<Submap>(origin, p.submap));
+            std::lock_guard<std::mutex> lock(mtx);
+            new_submaps.push_back({id, origin});
+        }
+
+        pose2d globalPose(const pose2d &l)
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            return compose(correction, l);
+        }
+
+        void tryLoopClosure(int n)
+        {
+            const auto &pts = node_points[n];
+            auto g = graph.getPose(node_var[n]);
+            const auto &own = node_submaps[n];
+            auto newest = own.empty() ? next_submap : own.front();
+
+            double best_score = p.loop_min_score;
+            int best_id = -1;
+            pose2d best_pose = {0.0, 0.0, 0.0};
+            for(auto id : finished_order)
+            {
+                if(id > newest - 1 - p.loop_skip_submaps)
+                    continue;
+                auto s = graph.getPose(submap_var[id]);
+                if(std::hypot(s.x - g.x, s.y - g.y) > p.loop_radius)
+                    continue;
+                pose2d found;
+                auto score = search(*finished[id], pts, between(s, g), p.loop_search, found);
+                if(score > best_score)
+                {
+                    best_score = score;
+                    best_id = id;
+                    best_pose = found;
+                }
+            }
+            if(best_id < 0)
+                return;
+
+            // Polish without any pull toward the (drifted) guess
+            refine_params r = p.refine;
+            r.translation_weight = r.rotation_weight = 1e-6;
+            auto guess = best_pose;
+            refine(*finished[best_id], pts, guess, best_pose, r);
+            graph.addConstraint({submap_var[best_id], node_var[n], best_pose,
+                                 p.loop_weight_t, p.loop_weight_r, true});
+            std::lock_guard<std::mutex> lock(mtx);
+            stats.loop_closures++;
+        }
+
+        // Finished submaps at their optimized poses, cropped to what was seen
+        void render(occupancy_map &out) const
+        {
+            double lo_x = 1e18, lo_y = 1e18, hi_x = -1e18, hi_y = -1e18;
+            for(auto id : finished_order)
+            {
+                auto s = graph.getPose(submap_var[id]);
+                auto r = 0.5*M_SQRT2*finished[id]->size()*finished[id]->getResolution();
+                lo_x = std::min(lo_x, s.x - r);
+                lo_y = std::min(lo_y, s.y - r);
+                hi_x = std::max(hi_x, s.x + r);
+                hi_y = std::max(hi_y, s.y + r);
+            }
+            const double res = p.map_resolution;
+            out.resolution = res;
+            out.origin_x = lo_x;
+            out.origin_y = lo_y;
+            out.width = (int)std::ceil((hi_x - lo_x)/res);
+            out.height = (int)std::ceil((hi_y - lo_y)/res);
+
+            // Sum of log odds; submaps overlap, so a wall seen twice counts twice
+            std::vector<float> sum((size_t)out.width*out.height, 0.0f);
+            for(auto id : finished_order)
+            {
+                const auto &m = *finished[id];
+                auto s = graph.getPose(submap_var[id]);
+                auto c = std::cos(s.yaw), sn = std::sin(s.yaw);
+                auto r = 0.5*M_SQRT2*m.size()*m.getResolution();
+                auto x0 = std::max((int)((s.x - r - lo_x)/res), 0), x1 = std::min((int)((s.x + r - lo_x)/res) + 1, out.width);
+                auto y0 = std::max((int)((s.y - r - lo_y)/res), 0), y1 = std::min((int)((s.y + r - lo_y)/res) + 1, out.height);
+                for(int y = y0; y < y1; y++)
+                {
+                    // Cell center in the submap's frame, stepped along the row
+                    auto wy = lo_y + (y + 0.5)*res - s.y;
+                    auto wx = lo_x + (x0 + 0.5)*res - s.x;
+                    double mx = c*wx + sn*wy, my = -sn*wx + c*wy;
+                    for(int x = x0; x < x1; x++, mx += c*res, my -= sn*res)
+                    {
+                        auto ix = (int)std::lround(m.cellX(mx)), iy = (int)std::lround(m.cellY(my));
+                        if(ix < 0 || iy < 0 || ix >= m.size() || iy >= m.size())
+                            continue;
+                        sum[(size_t)y*out.width + x] += m.logOdds(ix, iy);
+                    }
+                }
+            }
+
+            // Crop to the cells that ended up known
+            int cx0 = out.width, cx1 = -1, cy0 = out.height, cy1 = -1;
+            for(int y = 0; y < out.height; y++)
+                for(int x = 0; x < out.width; x++)
+                {
+                    auto l = sum[(size_t)y*out.width + x];
+                    if(l < p.map_occupied && l > p.map_free)
+                        continue;
+                    cx0 = std::min(cx0, x); cx1 = std::max(cx1, x);
+                    cy0 = std::min(cy0, y); cy1 = std::max(cy1, y);
+                }
+            if(cx1 < 0)
+                cx0 = cx1 = cy0 = cy1 = 0;
+
+            auto full_width = out.width;
+            out.origin_x += cx0*res;
+            out.origin_y += cy0*res;
+            out.width = cx1 - cx0 + 1;
+            out.height = cy1 - cy0 + 1;
+            out.data.resize((size_t)out.width*out.height);
+            for(int y = 0; y < out.height; y++)
+                for(int x = 0; x < out.width; x++)
+                {
+                    auto l = sum[(size_t)(y + cy0)*full_width + x + cx0];
+                    out.data[(size_t)y*out.width + x] = l >= p.map_occupied ? 100 : (l <= p.map_free ? 0 : -1);
+                }
+        }
+
+        void backEnd()
+        {
+            int since_optimize = 0;
+            bool dirty = false;
+            while(true)
+            {
+                std::vector<submap_work> started;
+                std::vector<std::pair<int, std::shared_ptr<Submap>>> done;
+                std::vector<node_work> nodes;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    wake.wait(lock, [this]{ return stop || !new_nodes.empty() || !new_finished.empty(); });
+                    if(stop)
+                        return;
+                    started.swap(new_submaps);
+                    done.swap(new_finished);
+                    nodes.swap(new_nodes);
+                }
+
+                // Read once; only this thread writes the correction
+                auto corr = correction;
+                for(const auto &s : started)
+                {
+                    submap_var.resize(s.id + 1, -1);
+                    finished.resize(s.id + 1);
+                    submap_var[s.id] = graph.addPose(compose(corr, s.local));
+                }
+                for(auto &d : done)
+                {
+                    finished[d.first] = d.second;
+                    finished_order.push_back(d.first);
+                    dirty = true;
+                }
+
+                bool closed = false;
+                for(auto &w : nodes)
+                {
+                    int n = (int)node_var.size();
+                    node_var.push_back(graph.addPose(compose(corr, w.local)));
+                    node_local.push_back(w.local);
+                    node_submaps.emplace_back();
+                    for(const auto &in : w.in_submaps)
+                    {
+                        node_submaps[n].push_back(in.first);
+                        graph.addConstraint({submap_var[in.first], node_var[n], in.second,
+                                             p.intra_weight_t, p.intra_weight_r, false});
+                    }
+                    node_points.push_back(std::move(w.points));
+
+                    auto before = graph.numConstraints();
+                    if(p.loop_every > 0 && n % p.loop_every == 0)
+                        tryLoopClosure(n);
+                    closed |= graph.numConstraints() > before;
+                    since_optimize++;
+                }
+
+                if(node_var.empty())
+                    continue;
+                if(closed || since_optimize >= p.optimize_every)
+                {
+                    auto t0 = std::chrono::steady_clock::now();
+                    graph.optimize(p.optimize_iterations, p.cg_iterations, p.huber);
+                    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                    since_optimize = 0;
+                    dirty = true;
+
+                    auto last = node_var.size() - 1;
+                    corr = compose(graph.getPose(node_var[last]), inverse(node_local[last]));
+                    std::lock_guard<std::mutex> lock(mtx);
+                    correction = corr;
+                    stats.last_optimize_ms = ms;
+                }
+                else
+                    continue;
+
+                // Re-render only at new poses, and only if something changed
+                if(dirty && !finished_order.empty())
+                {
+                    occupancy_map m;
+                    render(m);
+                    dirty = false;
+                    std::lock_guard<std::mutex> lock(mtx);
+                    map = std::move(m);
+                    map_fresh = true;
+                }
+            }
+        }
+
+    public:
+        explicit SubmapSlam(const slam_params &p)
+            : p(p), next_submap(0), have_pose(false), last_node_time(0.0),
+              stop(false), correction({0.0, 0.0, 0.0}), map_fresh(false),
+              stats({0, 0, 0, 0.0})
+        {
+            worker = std::thread(&SubmapSlam::backEnd, this);
+        }
+
+        ~SubmapSlam()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                stop = true;
+            }
+            wake.notify_all();
+            worker.join();
+        }
+
+        SubmapSlam(const SubmapSlam &) = delete;
+        SubmapSlam &operator=(const SubmapSlam &) = delete;
+
+        /**
+         * @brief Track one scan.
+         * @param stamp   scan time, s
+         * @param odom    odometry pose at the scan (any fixed frame)
+         * @param sensor  lidar pose in the base frame
+         * @param hits    beam endpoints in the base frame
+         * @param misses  base frame points as far as beams with no return reached
+         * @return the base pose in the global frame
+         */
+        pose2d addScan(double stamp, const pose2d &odom, const pose2d &sensor,
+                       const std::vector<point2d> &hits, const std::vector<point2d> &misses)
+        {
+            if(!have_pose)
+            {
+                have_pose = true;
+                local = {0.0, 0.0, 0.0};
+                last_odom = odom;
+                startSubmap(local);
+            }
+            else
+            {
+                local = compose(local, between(last_odom, odom));
+                last_odom = odom;
+            }
+
+            thin(hits, match_pts);
+            const auto &front = *active.front().second;
+            if(front.getInserted() > 0)
+            {
+                auto prior = between(front.getOrigin(), local);
+                auto pose = prior;
+                refine(front, match_pts, prior, pose, p.refine);
+                local = compose(front.getOrigin(), pose);
+            }
+
+            bool first = front.getInserted() == 0 && active.size() == 1;
+            auto moved = between(last_node, local);
+            if(!first && std::hypot(moved.x, moved.y) < p.insert_distance &&
+               std::fabs(moved.yaw) < p.insert_angle && stamp - last_node_time < p.insert_time)
+                return globalPose(local);
+            last_node = local;
+            last_node_time = stamp;
+
+            // Insert into every active submap and queue the node
+            hits_local.resize(hits.size());
+            for(size_t k = 0; k < hits.size(); k++)
+                hits_local[k] = transform(local, hits[k]);
+            misses_local.resize(misses.size());
+            for(size_t k = 0; k < misses.size(); k++)
+                misses_local[k] = transform(local, misses[k]);
+            auto lidar = compose(local, sensor);
+
+            node_work w;
+            w.local = local;
+            w.points = match_pts;
+            for(auto &a : active)
+            {
+                a.second->insert(lidar, hits_local, misses_local);
+                w.in_submaps.emplace_back(a.first, between(a.second->getOrigin(), local));
+            }
+
+            std::vector<std::pair<int, std::shared_ptr<Submap>>> done;
+            if(active.front().second->getInserted() >= p.submap.scans)
+            {
+                active.front().second->finish();
+                done.push_back(active.front());
+                active.erase(active.begin());
+            }
+            if(active.empty() || active.back().second->getInserted() >= p.submap.scans/2)
+                startSubmap(local);
+
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                new_nodes.push_back(std::move(w));
+                new_finished.insert(new_finished.end(), done.begin(), done.end());
+                stats.nodes++;
+                stats.submaps = next_submap;
+            }
+            wake.notify_one();
+            return globalPose(local);
+        }
+
+        // The latest rendered map, if there is one newer than the last call's
+        bool takeMap(occupancy_map &out)
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if(!map_fresh)
+                return false;
+            out = map;
+            map_fresh = false;
+            return true;
+        }
+
+        slam_stats getStats()
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            return stats;
+        }
+};
+
+} // namespace submap_slam
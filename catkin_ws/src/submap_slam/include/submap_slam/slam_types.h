@@ -0,0 +1,52 @@
+/**
+ * @file slam_types.h
+ * @brief SE(2) poses and 2D points shared by the submap SLAM pieces.
+ */
+#pragma once
+
+#include <cmath>
+
+namespace submap_slam
+{
+
+struct pose2d
+{
+    double x, y, yaw;
+};
+
+struct point2d
+{
+    float x, y;
+};
+
+inline double wrap_angle(double a)
+{
+    return std::remainder(a, 2.0*M_PI);
+}
+
+// a then b (b expressed in a's frame)
+inline pose2d compose(const pose2d &a, const pose2d &b)
+{
+    auto c = std::cos(a.yaw), s = std::sin(a.yaw);
+    return { a.x + c*b.x - s*b.y, a.y + s*b.x + c*b.y, wrap_angle(a.yaw + b.yaw) };
+}
+
+inline pose2d inverse(const pose2d &a)
+{
+    auto c = std::cos(a.yaw), s = std::sin(a.yaw);
+    return { -c*a.x - s*a.y, s*a.x - c*a.y, wrap_angle(-a.yaw) };
+}
+
+// b in a's frame
+inline pose2d between(const pose2d &a, const pose2d &b)
+{
+    return compose(inverse(a), b);
+}
+
+inline point2d transform(const pose2d &a, const point2d &p)
+{
+    auto c = std::cos(a.yaw), s = std::sin(a.yaw);
+    return { (float)(a.x + c*p.x - s*p.y), (float)(a.y + s*p.x + c*p.y) };
+}
+
+} // namespace submap_slam
@@ -0,0 +1,283 @@
+/**
+ * @file submap.h
+ * @brief A square log-odds occupancy grid built from a few seconds of
+ *          scans, fixed in the SLAM's local frame at its first scan.
+ *
+ * Scans are inserted by tracing every beam: the cell it ends in gets a hit
+ * and the cells before it a miss, each at most once per scan, hits first
+ * (so a wall cell crossed by a neighbouring beam isn't cleared). Rays are
+ * walked eight at a time with fixed-point DDA, the lanes' cell indices
+ * stepped together in AVX2 or NEON registers; only applying the updates,
+ * which scatter, is scalar.
+ *
+ * Matching reads the grid through squash(), a cheap sigmoid of the log
+ * odds to [0, 1] (unknown is 0.5). Once finished, a submap is read-only and
+ * also keeps a max-pooled copy for the coarse level of loop closure search.
+ */
+#pragma once
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <submap_slam/slam_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace submap_slam
+{
+
+/**
+ * @brief One DDA step of eight rays: each lane's cell index from its 16.16
+ *          fixed-point position, then the position advanced by its step.
+ */
+inline void dda_step8(int32_t *fx, int32_t *fy, const int32_t *sx, const int32_t *sy, int32_t cells, int32_t *idx)
+{
+#if defined(__AVX2__)
+    auto x = _mm256_loadu_si256((const __m256i *)fx), y = _mm256_loadu_si256((const __m256i *)fy);
+    auto i = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srai_epi32(y, 16), _mm256_set1_epi32(cells)),
+                              _mm256_srai_epi32(x, 16));
+    _mm256_storeu_si256((__m256i *)idx, i);
+    _mm256_storeu_si256((__m256i *)fx, _mm256_add_epi32(x, _mm256_loadu_si256((const __m256i *)sx)));
+    _mm256_storeu_si256((__m256i *)fy, _mm256_add_epi32(y, _mm256_loadu_si256((const __m256i *)sy)));
+#elif defined(__ARM_NEON)
+    auto w = vdupq_n_s32(cells);
+    for(int h = 0; h < 8; h += 4)
+    {
+        auto x = vld1q_s32(fx + h), y = vld1q_s32(fy + h);
+        vst1q_s32(idx + h, vmlaq_s32(vshrq_n_s32(x, 16), vshrq_n_s32(y, 16), w));
+        vst1q_s32(fx + h, vaddq_s32(x, vld1q_s32(sx + h)));
+        vst1q_s32(fy + h, vaddq_s32(y, vld1q_s32(sy + h)));
+    }
+#else
+    for(int l = 0; l < 8; l++)
+    {
+        idx[l] = (fy[l] >> 16)*cells + (fx[l] >> 16);
+        fx[l] += sx[l];
+        fy[l] += sy[l];
+    }
+#endif
+}
+
+struct submap_params
+{
+    double resolution;      // m per cell
+    double size;            // m, side of the square, centered on the origin
+    float hit, miss;        // log-odds added per hit / miss (miss < 0)
+    float max_log_odds;     // clamp, so cells can still flip
+    int scans;              // insertions before the submap is finished
+    int coarse;             // cells per side of a coarse (max-pooled) cell
+};
+
+class Submap
+{
+    private:
+        submap_params p;
+        pose2d origin;              // in the local frame
+        int cells;
+        double inv_res;
+        std::vector<float> grid;    // log odds, row-major from the lower left corner
+        std::vector<uint32_t> touched;  // scan stamp of each cell's last update
+        uint32_t stamp;
+        int inserted;
+        bool finished;
+
+        int coarse_cells;
+        std::vector<float> coarse;  // squashed, max over coarse x coarse cells
+
+        // Clip the segment a -> b (cell coordinates) to the grid; false if outside
+        bool clip(double &ax, double &ay, double &bx, double &by) const
+        {
+            // Cell i spans [i - 0.5, i + 0.5)
+            const double lo = -0.5 + 1e-3, hi = cells - 0.5 - 1e-3;
+            double t0 = 0.0, t1 = 1.0;
+            const double d[2] = {bx - ax, by - ay}, o[2] = {ax, ay};
+            for(int k = 0; k < 2; k++)
+            {
+                if(std::fabs(d[k]) < 1e-12)
+                {
+                    if(o[k] < lo || o[k] > hi)
+                        return false;
+                    continue;
+                }
+                auto ta = (lo - o[k])/d[k], tb = (hi - o[k])/d[k];
+                if(ta > tb)
+                    std::swap(ta, tb);
+                t0 = std::max(t0, ta);
+                t1 = std::min(t1, tb);
+            }
+            if(t0 > t1)
+                return false;
+            bx = o[0] + t1*d[0];
+            by = o[1] + t1*d[1];
+            ax = o[0] + t0*d[0];
+            ay = o[1] + t0*d[1];
+            return true;
+        }
+
+        void update(int idx, float delta)
+        {
+            touched[idx] = stamp;
+            grid[idx] = std::max(std::min(grid[idx] + delta, p.max_log_odds), -p.max_log_odds);
+        }
+
+    public:
+        Submap(const pose2d &origin, const submap_params &p)
+            : p(p), origin(origin), stamp(0), inserted(0), finished(false), coarse_cells(0)
+        {
+            cells = std::max((int)std::ceil(p.size/p.resolution), 2);
+            inv_res = 1.0/p.resolution;
+            grid.assign((size_t)cells*cells, 0.0f);
+            touched.assign(grid.size(), 0);
+        }
+
+        static float squash(float l)
+        {
+            return 0.5f + 0.5f*l/(1.0f + std::fabs(l));
+        }
+
+        const pose2d &getOrigin() const { return origin; }
+        int size() const { return cells; }
+        double getResolution() const { return p.resolution; }
+        int getInserted() const { return inserted; }
+        bool isFinished() const { return finished; }
+        float logOdds(int ix, int iy) const { return grid[(size_t)iy*cells + ix]; }
+
+        // Submap frame (origin at the center) to continuous cell coordinates
+        double cellX(double x) const { return x*inv_res + 0.5*cells - 0.5; }
+        double cellY(double y) const { return y*inv_res + 0.5*cells - 0.5; }
+
+        /**
+         * @brief Insert one scan.
+         * @param sensor  lidar pose in the local frame
+         * @param hits    beam endpoints in the local frame
+         * @param misses  points as far as beams that returned nothing reached
+         */
+        void insert(const pose2d &sensor, const std::vector<point2d> &hits, const std::vector<point2d> &misses)
+        {
+            if(finished)
+                return;
+            if(++stamp == 0)
+            {
+                std::fill(touched.begin(), touched.end(), 0);
+                stamp = 1;
+            }
+            auto to_map = inverse(origin);
+            auto s = compose(to_map, sensor);
+            const double ox = cellX(s.x), oy = cellY(s.y);
+
+            // Hits first, then misses skip whatever was hit
+            for(const auto &h : hits)
+            {
+                auto q = transform(to_map, h);
+                auto ix = (int)std::lround(cellX(q.x)), iy = (int)std::lround(cellY(q.y));
+                if(ix < 0 || iy < 0 || ix >= cells || iy >= cells)
+                    continue;
+                auto idx = iy*cells + ix;
+                if(touched[idx] != stamp)
+                    update(idx, p.hit);
+            }
+
+            const int LANES = 8;
+            const size_t n = hits.size() + misses.size();
+            for(size_t first = 0; first < n; first += LANES)
+            {
+                // 16.16 fixed-point start and step of every lane's ray
+                int32_t fx[LANES], fy[LANES], sx[LANES], sy[LANES], steps[LANES];
+                int max_steps = 0;
+                for(int l = 0; l < LANES; l++)
+                {
+                    steps[l] = 0;
+                    fx[l] = fy[l] = sx[l] = sy[l] = 0;
+                    if(first + l >= n)
+                        continue;
+                    const auto &e = first + l < hits.size() ? hits[first + l] : misses[first + l - hits.size()];
+                    auto q = transform(to_map, e);
+                    double ax = ox, ay = oy, bx = cellX(q.x), by = cellY(q.y);
+                    if(!clip(ax, ay, bx, by))
+                        continue;
+                    // +0.5 so the integer part is the nearest cell
+                    ax += 0.5; ay += 0.5; bx += 0.5; by += 0.5;
+                    auto len = (int)std::ceil(std::max(std::fabs(bx - ax), std::fabs(by - ay)));
+                    if(len <= 0)
+                        continue;
+                    fx[l] = (int32_t)(ax*65536.0);
+                    fy[l] = (int32_t)(ay*65536.0);
+                    sx[l] = (int32_t)((bx - ax)/len*65536.0);
+                    sy[l] = (int32_t)((by - ay)/len*65536.0);
+                    steps[l] = len;
+                    max_steps = std::max(max_steps, len);
+                }
+
+                int32_t idx[LANES];
+                for(int step = 0; step < max_steps; step++)
+                {
+                    dda_step8(fx, fy, sx, sy, cells, idx);
+                    for(int l = 0; l < LANES; l++)
+                        if(step < steps[l] && touched[idx[l]] != stamp)
+                            update(idx[l], p.miss);
+                }
+            }
+            inserted++;
+        }
+
+        /**
+         * @brief Stop inserting: drop the insertion bookkeeping and build the
+         *          coarse grid for loop closure search.
+         */
+        void finish()
+        {
+            finished = true;
+            touched.clear();
+            touched.shrink_to_fit();
+
+            coarse_cells = (cells + p.coarse - 1)/p.coarse;
+            coarse.assign((size_t)coarse_cells*coarse_cells, 0.0f);
+            for(int y = 0; y < cells; y++)
+                for(int x = 0; x < cells; x++)
+                {
+                    auto &c = coarse[(size_t)(y/p.coarse)*coarse_cells + x/p.coarse];
+                    c = std::max(c, squash(grid[(size_t)y*cells + x]));
+                }
+        }
+
+        int coarseSize() const { return coarse_cells; }
+        int coarseFactor() const { return p.coarse; }
+        float coarseAt(int cx, int cy) const { return coarse[(size_t)cy*coarse_cells + cx]; }
+
+        // Squashed value of the nearest cell, 0.5 (unknown) off the grid
+        float nearest(double cx, double cy) const
+        {
+            auto ix = (int)std::lround(cx), iy = (int)std::lround(cy);
+            if(ix < 0 || iy < 0 || ix >= cells || iy >= cells)
+                return 0.5f;
+            return squash(grid[(size_t)iy*cells + ix]);
+        }
+
+        /**
+         * @brief Bilinear squashed value at cell coordinates (cx, cy) and its
+         *          gradient per cell.
+         */
+        float interpolate(double cx, double cy, double &gx, double &gy) const
+        {
+            auto x0 = (int)std::floor(cx), y0 = (int)std::floor(cy);
+            if(x0 < 0 || y0 < 0 || x0 + 1 >= cells || y0 + 1 >= cells)
+            {
+                gx = gy = 0.0;
+                return 0.5f;
+            }
+            auto fx = cx - x0, fy = cy - y0;
+            const float *r0 = &grid[(size_t)y0*cells + x0], *r1 = r0 + cells;
+            double v00 = squash(r0[0]), v10 = squash(r0[1]), v01 = squash(r1[0]), v11 = squash(r1[1]);
+            gx = (1.0 - fy)*(v10 - v00) + fy*(v11 - v01);
+            gy = (1.0 - fx)*(v01 - v00) + fx*(v11 - v10);
+            return (1.0 - fy)*((1.0 - fx)*v00 + fx*v10) + fy*((1.0 - fx)*v01 + fx*v11);
+        }
+};
+
+} // namespace submap_slam
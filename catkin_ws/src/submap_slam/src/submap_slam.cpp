@@ -0,0 +1,210 @@
+/**
+ * @file submap_slam.cpp
+ * @brief Maps a track as the car drives it: SubmapSlam on /scan and /odom,
+ *          publishing the corrected pose on /slam_pose and the map on
+ *          /map (latched) whenever the back end re-renders it.
+ *
+ * Save the map after a lap with `rosrun map_server map_saver -f <name>`,
+ * and drive from then on with that instead of a precomputed one.
+ */
+
+#include <ros/ros.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <submap_slam/slam.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace submap_slam;
+
+class SubmapSlamNode
+{
+    private:
+        ros::NodeHandle n;
+        ros::Subscriber scan_sub, odom_sub;
+        ros::Publisher pose_pub, map_pub;
+        ros::Timer map_timer, report_timer;
+
+        SubmapSlam slam;
+        double base_link, max_range;
+        std::string map_frame;
+
+        bool have_odom;
+        pose2d odom;
+        std::vector<point2d> hits, misses;
+        geometry_msgs::PoseStamped pose_msg;
+
+        // Front end time per scan since the last report
+        double busy_ms, worst_ms;
+        int scans;
+
+        static slam_params load(const ros::NodeHandle &n)
+        {
+            slam_params p;
+            n.param("slam_resolution", p.submap.resolution, 0.05);
+            n.param("slam_submap_size", p.submap.size, 30.0);
+            double hit, miss, max_log_odds;
+            n.param("slam_hit_log_odds", hit, 0.85);
+            n.param("slam_miss_log_odds", miss, -0.1);
+            n.param("slam_max_log_odds", max_log_odds, 3.5);
+            p.submap.hit = hit;
+            p.submap.miss = miss;
+            p.submap.max_log_odds = max_log_odds;
+            n.param("slam_submap_scans", p.submap.scans, 60);
+            n.param("slam_coarse_factor", p.submap.coarse, 4);
+
+            n.param("slam_match_iterations", p.refine.iterations, 10);
+            n.param("slam_match_translation_weight", p.refine.translation_weight, 0.1);
+            n.param("slam_match_rotation_weight", p.refine.rotation_weight, 0.5);
+            n.param("slam_match_spacing", p.match_spacing, 0.05);
+
+            n.param("slam_insert_distance", p.insert_distance, 0.1);
+            n.param("slam_insert_angle", p.insert_angle, 0.05);
+            n.param("slam_insert_time", p.insert_time, 0.5);
+
+            n.param("slam_loop_linear_window", p.loop_search.linear, 2.0);
+            n.param("slam_loop_angular_window", p.loop_search.angular, 0.35);
+            n.param("slam_loop_radius", p.loop_radius, 6.0);
+            n.param("slam_loop_min_score", p.loop_min_score, 0.65);
+            n.param("slam_loop_skip_submaps", p.loop_skip_submaps, 3);
+            n.param("slam_loop_every", p.loop_every, 5);
+
+            n.param("slam_intra_weight_translation", p.intra_weight_t, 1e4);
+            n.param("slam_intra_weight_rotation", p.intra_weight_r, 1e5);
+            n.param("slam_loop_weight_translation", p.loop_weight_t, 1e3);
+            n.param("slam_loop_weight_rotation", p.loop_weight_r, 1e4);
+            n.param("slam_loop_huber", p.huber, 3.0);
+
+            n.param("slam_optimize_every", p.optimize_every, 30);
+            n.param("slam_optimize_iterations", p.optimize_iterations, 5);
+            n.param("slam_cg_iterations", p.cg_iterations, 300);
+
+            n.param("slam_map_resolution", p.map_resolution, 0.05);
+            double occupied, free;
+            n.param("slam_map_occupied", occupied, 0.6);
+            n.param("slam_map_free", free, -0.6);
+            p.map_occupied = occupied;
+            p.map_free = free;
+            return p;
+        }
+
+    public:
+        SubmapSlamNode()
+            : n(ros::NodeHandle("~")), slam(load(n)), have_odom(false), odom({0.0, 0.0, 0.0}),
+              busy_ms(0.0), worst_ms(0.0), scans(0)
+        {
+            std::string pose_topic, map_topic;
+            double map_period, report_period;
+            n.param("scan_distance_to_base_link", base_link, 0.275);
+            n.param("slam_max_range", max_range, 10.0);
+            n.param<std::string>("slam_pose_topic", pose_topic, "/slam_pose");
+            n.param<std::string>("slam_map_topic", map_topic, "/map");
+            n.param<std::string>("slam_map_frame", map_frame, "map");
+            n.param("slam_map_period", map_period, 1.0);
+            n.param("slam_report_period", report_period, 5.0);
+            pose_msg.header.frame_id = map_frame;
+
+            // pubs
+            pose_pub = n.advertise<geometry_msgs::PoseStamped>(pose_topic, 1);
+            map_pub = n.advertise<nav_msgs::OccupancyGrid>(map_topic, 1, true);
+
+            // subs
+            scan_sub = n.subscribe("/scan", 1, &SubmapSlamNode::scan_cb, this, ros::TransportHints().tcpNoDelay());
+            odom_sub = n.subscribe("/odom", 1, &SubmapSlamNode::odom_cb, this, ros::TransportHints().tcpNoDelay());
+
+            map_timer = n.createTimer(ros::Duration(map_period), &SubmapSlamNode::map_cb, this);
+            if(report_period > 0.0)
+                report_timer = n.createTimer(ros::Duration(report_period), &SubmapSlamNode::report_cb, this);
+        }
+
+        void odom_cb(const nav_msgs::Odometry &msg)
+        {
+            const auto &q = msg.pose.pose.orientation;
+            odom.x = msg.pose.pose.position.x;
+            odom.y = msg.pose.pose.position.y;
+            odom.yaw = std::atan2(2.0*(q.w*q.z + q.x*q.y), 1.0 - 2.0*(q.y*q.y + q.z*q.z));
+            have_odom = true;
+        }
+
+        void scan_cb(const sensor_msgs::LaserScan &msg)
+        {
+            if(!have_odom)
+                return;
+            auto t0 = std::chrono::steady_clock::now();
+
+            // Beams in the base frame; anything past max_range only clears
+            hits.clear();
+            misses.clear();
+            const double far = std::min((double)msg.range_max, max_range);
+            for(size_t i = 0; i < msg.ranges.size(); i++)
+            {
+                double r = msg.ranges[i];
+                if(std::isnan(r) || r < msg.range_min)
+                    continue;
+                auto a = msg.angle_min + i*msg.angle_increment;
+                auto c = std::cos(a), s = std::sin(a);
+                if(r < far)
+                    hits.push_back({(float)(base_link + r*c), (float)(r*s)});
+                else
+                    misses.push_back({(float)(base_link + far*c), (float)(far*s)});
+            }
+            auto pose = slam.addScan(msg.header.stamp.toSec(), odom, {base_link, 0.0, 0.0}, hits, misses);
+
+            pose_msg.header.stamp = msg.header.stamp;
+            pose_msg.pose.position.x = pose.x;
+            pose_msg.pose.position.y = pose.y;
+            pose_msg.pose.orientation.z = std::sin(0.5*pose.yaw);
+            pose_msg.pose.orientation.w = std::cos(0.5*pose.yaw);
+            pose_pub.publish(pose_msg);
+
+            auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            busy_ms += ms;
+            worst_ms = std::max(worst_ms, ms);
+            scans++;
+        }
+
+        void map_cb(const ros::TimerEvent &)
+        {
+            occupancy_map m;
+            if(!slam.takeMap(m))
+                return;
+            nav_msgs::OccupancyGrid grid;
+            grid.header.stamp = ros::Time::now();
+            grid.header.frame_id = map_frame;
+            grid.info.map_load_time = grid.header.stamp;
+            grid.info.resolution = m.resolution;
+            grid.info.width = m.width;
+            grid.info.height = m.height;
+            grid.info.origin.position.x = m.origin_x;
+            grid.info.origin.position.y = m.origin_y;
+            grid.info.origin.orientation.w = 1.0;
+            grid.data = std::move(m.data);
+            map_pub.publish(grid);
+        }
+
+        void report_cb(const ros::TimerEvent &)
+        {
+            if(scans == 0)
+                return;
+            auto s = slam.getStats();
+            ROS_INFO("submap_slam: %d scans, %.2f ms mean / %.2f ms worst; %d nodes, %d submaps, %d loop closures, last optimization %.1f ms",
+                     scans, busy_ms/scans, worst_ms, s.nodes, s.submaps, s.loop_closures, s.last_optimize_ms);
+            busy_ms = worst_ms = 0.0;
+            scans = 0;
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "submap_slam");
+    SubmapSlamNode node;
+    ros::spin();
+    return 0;
+}
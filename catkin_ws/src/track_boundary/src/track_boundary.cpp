@@ -0,0 +1,197 @@
+/**
+ * @file track_boundary.cpp
+ * @brief Segments the scan into left and right boundary polylines and
+ *          simplifies them with Douglas-Peucker, so planners get tens of
+ *          vertices instead of every beam.
+ *
+ * Each side is walked once in beam order, rear to front. Beams are
+ * converted to points with a cached trig table and split into segments
+ * where a beam is invalid or the gap to the previous point is larger than
+ * `boundary_break_dist`. Every segment is simplified as soon as it closes.
+ */
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+#include <track_boundary/TrackBoundary.h>
+#include <race_common/laser_scan_view.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+class TrackBoundary
+{
+    private:
+        ros::NodeHandle n;
+        ros::Subscriber scan_sub;
+        ros::Publisher boundary_pub;
+
+        double max_side_angle;  // how far back each side reaches (rad)
+        double break_dist;      // gap between neighbouring points that splits a polyline (m)
+        double epsilon;         // Douglas-Peucker tolerance (m)
+        int min_points;         // shorter segments are dropped as clutter
+
+        // Trig cache, rebuilt only if the scan layout changes
+        std::vector<float> cos_table, sin_table;
+        float cached_min, cached_inc;
+
+        // Scratch reused between scans
+        std::vector<geometry_msgs::Point32> segment;
+        std::vector<char> keep;
+        std::vector<std::pair<size_t, size_t>> stack;
+
+        void update_trig(const race_common::LaserScanView &msg)
+        {
+            if(cos_table.size() == msg.ranges.size() &&
+               cached_min == msg.angle_min && cached_inc == msg.angle_increment)
+                return;
+
+            cos_table.resize(msg.ranges.size());
+            sin_table.resize(msg.ranges.size());
+            for(size_t i = 0; i < msg.ranges.size(); i++)
+            {
+                auto angle = msg.angle_min + i*msg.angle_increment;
+                cos_table[i] = std::cos(angle);
+                sin_table[i] = std::sin(angle);
+            }
+            cached_min = msg.angle_min;
+            cached_inc = msg.angle_increment;
+        }
+
+        int idx(const race_common::LaserScanView &msg, double angle) const
+        {
+            auto i = (int)std::round((angle - msg.angle_min)/msg.angle_increment);
+            return std::min(std::max(i, 0), (int)msg.ranges.size() - 1);
+        }
+
+        // Iterative Douglas-Peucker over `segment`, appending kept vertices to `out`
+        void simplify(std::vector<geometry_msgs::Point32> &out, std::vector<uint32_t> &starts)
+        {
+            if((int)segment.size() < min_points)
+            {
+                segment.clear();
+                return;
+            }
+
+            auto eps_sq = epsilon*epsilon;
+            keep.assign(segment.size(), 0);
+            keep.front() = keep.back() = 1;
+            stack.clear();
+            stack.emplace_back(0, segment.size() - 1);
+
+            while(!stack.empty())
+            {
+                auto span = stack.back();
+                stack.pop_back();
+
+                const auto &a = segment[span.first];
+                const auto &b = segment[span.second];
+                auto dx = b.x - a.x, dy = b.y - a.y;
+                auto len_sq = dx*dx + dy*dy;
+
+                // Farthest point from the chord a-b
+                double worst = -1.0;
+                size_t worst_i = span.first;
+                for(size_t i = span.first + 1; i < span.second; i++)
+                {
+                    auto px = segment[i].x - a.x, py = segment[i].y - a.y;
+                    auto cross = dx*py - dy*px;
+                    auto d_sq = len_sq > 0.0f ? cross*cross/len_sq : px*px + py*py;
+                    if(d_sq > worst)
+                    {
+                        worst = d_sq;
+                        worst_i = i;
+                    }
+                }
+
+                if(worst > eps_sq)
+                {
+                    keep[worst_i] = 1;
+                    stack.emplace_back(span.first, worst_i);
+                    stack.emplace_back(worst_i, span.second);
+                }
+            }
+
+            starts.push_back(out.size());
+            for(size_t i = 0; i < segment.size(); i++)
+            {
+                if(keep[i])
+                    out.push_back(segment[i]);
+            }
+            segment.clear();
+        }
+
+        // One ordered pass from beam `first` towards beam `last`
+        void extract(const race_common::LaserScanView &msg, int first, int last,
+                     std::vector<geometry_msgs::Point32> &out, std::vector<uint32_t> &starts)
+        {
+            auto step = first <= last ? 1 : -1;
+            auto break_sq = break_dist*break_dist;
+            segment.clear();
+
+            for(int i = first; i != last + step; i += step)
+            {
+                auto r = msg.ranges[i];
+                if(!(r >= msg.range_min && r <= msg.range_max))   // also drops NaN/inf
+                {
+                    simplify(out, starts);
+                    continue;
+                }
+
+                geometry_msgs::Point32 p;
+                p.x = r*cos_table[i];
+                p.y = r*sin_table[i];
+                p.z = 0.0f;
+
+                if(!segment.empty())
+                {
+                    auto dx = p.x - segment.back().x, dy = p.y - segment.back().y;
+                    if(dx*dx + dy*dy > break_sq)
+                        simplify(out, starts);
+                }
+                segment.push_back(p);
+            }
+            simplify(out, starts);
+        }
+
+    public:
+        TrackBoundary()
+            : n(ros::NodeHandle("~")),
+              cached_min(0.0f), cached_inc(0.0f)
+        {
+            n.param("boundary_max_side_angle", max_side_angle, 2.35);
+            n.param("boundary_break_dist", break_dist, 0.5);
+            n.param("boundary_epsilon", epsilon, 0.05);
+            n.param("boundary_min_points", min_points, 3);
+            min_points = std::max(min_points, 2);
+
+            boundary_pub = n.advertise<track_boundary::TrackBoundary>("/track_boundary", 1);
+            scan_sub = n.subscribe("/scan", 1, &TrackBoundary::scan_cb, this);
+        }
+
+        void scan_cb(const race_common::LaserScanView &msg)
+        {
+            if(msg.ranges.empty())
+                return;
+            update_trig(msg);
+
+            track_boundary::TrackBoundary out;
+            out.header = msg.header;
+
+            // Left runs from behind (+max) to straight ahead, right from behind (-max)
+            auto front = idx(msg, 0.0);
+            extract(msg, idx(msg, max_side_angle), front, out.left, out.left_starts);
+            extract(msg, idx(msg, -max_side_angle), std::max(front - 1, 0), out.right, out.right_starts);
+
+            boundary_pub.publish(out);
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "track_boundary");
+    TrackBoundary t;
+    ros::spin();
+    return 0;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file bench_common.h
+ * @brief Scan generation, timestamps and latency statistics shared by the
+ *          transport benchmarks.
+ *
+ * Every sample is stamped with CLOCK_MONOTONIC (std::chrono::steady_clock)
+ * at publish time, carried in `header.stamp`, and compared against the same
+ * clock in the callback. The clock is system wide, so publisher and
+ * subscriber may live in different processes as long as they share a host.
+ */
+#pragma once
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace transport_bench
+{
+
+inline int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void stamp(sensor_msgs::LaserScan &msg, int64_t ns)
+{
+    msg.header.stamp.sec = (uint32_t)(ns/1000000000);
+    msg.header.stamp.nsec = (uint32_t)(ns%1000000000);
+}
+
+inline int64_t stamp_ns(const sensor_msgs::LaserScan &msg)
+{
+    return (int64_t)msg.header.stamp.sec*1000000000 + msg.header.stamp.nsec;
+}
+
+// Same layout as the car's lidar: full circle, `beams` ranges + intensities
+inline sensor_msgs::LaserScan make_scan(int beams)
+{
+    sensor_msgs::LaserScan msg;
+    msg.header.frame_id = "laser";
+    msg.angle_min = -M_PI;
+    msg.angle_max = M_PI;
+    msg.angle_increment = 2.0*M_PI/beams;
+    msg.range_min = 0.0f;
+    msg.range_max = 30.0f;
+    msg.ranges.resize(beams);
+    msg.intensities.resize(beams);
+    for(int i = 0; i < beams; i++)
+    {
+        msg.ranges[i] = 1.0f + 0.001f*i;
+        msg.intensities[i] = 1.0f;
+    }
+    return msg;
+}
+
+class LatencyStats
+{
+    private:
+        std::vector<int64_t> samples;   // publish-to-callback, ns
+        uint32_t first_seq, last_seq;
+        int64_t first_rx, last_rx;
+        size_t payload_bytes;
+
+    public:
+        explicit LatencyStats(size_t expected = 100000)
+            : first_seq(0), last_seq(0), first_rx(0), last_rx(0), payload_bytes(0)
+        {
+            samples.reserve(expected);
+        }
+
+        void add(int64_t sent_ns, int64_t rx_ns, uint32_t seq, size_t bytes)
+        {
+            if(samples.empty())
+            {
+                first_seq = seq;
+                first_rx = rx_ns;
+            }
+            samples.push_back(rx_ns - sent_ns);
+            last_seq = seq;
+            last_rx = rx_ns;
+            payload_bytes = bytes;
+        }
+
+        size_t count() const
+        {
+            return samples.size();
+        }
+
+        /**
+         * @brief Print a summary and append it as one CSV row to `csv_file`
+         *          (if not empty) so runs of different transports line up.
+         */
+        void report(const std::string &name, double rate, const std::string &csv_file)
+        {
+            if(samples.empty())
+            {
+                ROS_WARN("[%s] no samples received", name.c_str());
+                return;
+            }
+
+            std::sort(samples.begin(), samples.end());
+            auto pct = [this](double p) {
+                return samples[std::min(samples.size() - 1, (size_t)(p*samples.size()))]/1e3;
+            };
+            double mean = 0.0;
+            for(auto s : samples)
+                mean += s;
+            mean /= samples.size()*1e3;
+
+            auto sent = (size_t)(last_seq - first_seq) + 1;
+            auto dropped = sent > samples.size() ? sent - samples.size() : 0;
+            auto span_s = (last_rx - first_rx)/1e9;
+            auto msgs_per_s = span_s > 0.0 ? (samples.size() - 1)/span_s : 0.0;
+
+            ROS_INFO("[%s @ %s Hz] n=%zu dropped=%zu  latency us: mean=%.1f p50=%.1f p99=%.1f max=%.1f  "
+                     "throughput: %.0f msg/s %.1f MB/s",
+                     name.c_str(), rate > 0.0 ? std::to_string((int)rate).c_str() : "max",
+                     samples.size(), dropped, mean, pct(0.5), pct(0.99), samples.back()/1e3,
+                     msgs_per_s, msgs_per_s*payload_bytes/1e6);
+
+            if(csv_file.empty())
+                return;
+            FILE *f = std::fopen(csv_file.c_str(), "a");
+            if(f == nullptr)
+                return;
+            std::fprintf(f, "%s,%.1f,%zu,%zu,%.1f,%.1f,%.1f,%.1f,%.0f\n",
+                         name.c_str(), rate, samples.size(), dropped, mean,
+                         pct(0.5), pct(0.99), samples.back()/1e3, msgs_per_s);
+            std::fclose(f);
+        }
+};
+
+} // namespace transport_bench
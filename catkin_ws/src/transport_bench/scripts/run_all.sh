@@ -0,0 +1,19 @@
+#!/bin/bash
+# Runs every transport at the lidar rate (40 Hz) and at saturation and
+# collects one CSV row per run. Needs a roscore on this machine:
+#   roscore &
+#   rosrun transport_bench run_all.sh [results.csv]
+set -e
+
+CSV=${1:-$(pwd)/transport_bench.csv}
+echo "transport,rate_hz,received,dropped,mean_us,p50_us,p99_us,max_us,msgs_per_s" > "$CSV"
+
+for RATE in 40 0; do
+    for TRANSPORT in tcp tcp_nodelay udp; do
+        roslaunch transport_bench bench.launch transport:=$TRANSPORT rate:=$RATE csv_file:="$CSV"
+    done
+    roslaunch transport_bench intra.launch rate:=$RATE csv_file:="$CSV"
+    roslaunch transport_bench shm.launch rate:=$RATE csv_file:="$CSV"
+done
+
+column -s, -t < "$CSV"
@@ -0,0 +1,80 @@
+/**
+ * @file scan_bench_intra.cpp
+ * @brief Publisher and subscriber in one process. Publishing a ConstPtr
+ *          lets roscpp hand the same message to the callback without
+ *          serializing it -- the path nodelets take -- so this measures
+ *          the intra-process cost without the nodelet plumbing.
+ */
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <transport_bench/bench_common.h>
+
+class ScanBenchIntra
+{
+    private:
+        ros::NodeHandle n;
+        ros::Publisher pub;
+        ros::Subscriber sub;
+
+        std::string csv_file;
+        double rate;
+        int beams, count;
+        transport_bench::LatencyStats stats;
+
+    public:
+        ScanBenchIntra()
+            : n(ros::NodeHandle("~"))
+        {
+            int queue;
+            n.param<std::string>("csv_file", csv_file, "");
+            n.param("rate", rate, 40.0);
+            n.param("beams", beams, 1080);
+            n.param("count", count, 2000);
+            n.param("queue", queue, 100);
+
+            pub = n.advertise<sensor_msgs::LaserScan>("/bench_scan_intra", queue);
+            sub = n.subscribe("/bench_scan_intra", queue, &ScanBenchIntra::scan_cb, this);
+        }
+
+        void scan_cb(const sensor_msgs::LaserScan::ConstPtr &msg)
+        {
+            auto rx = transport_bench::now_ns();
+            stats.add(transport_bench::stamp_ns(*msg), rx, msg->header.seq,
+                      ros::serialization::serializationLength(*msg));
+        }
+
+        void run()
+        {
+            ros::WallRate loop(rate > 0.0 ? rate : 1.0);
+            auto proto = transport_bench::make_scan(beams);
+
+            for(int i = 0; i < count && ros::ok(); i++)
+            {
+                // A fresh message per publish, as a producer nodelet would
+                sensor_msgs::LaserScan::Ptr scan(new sensor_msgs::LaserScan(proto));
+                scan->header.seq = i;
+                transport_bench::stamp(*scan, transport_bench::now_ns());
+                pub.publish(sensor_msgs::LaserScan::ConstPtr(scan));
+
+                if(rate > 0.0)
+                    loop.sleep();
+            }
+            ros::WallDuration(1.0).sleep();
+            stats.report("intra_process", rate, csv_file);
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "scan_bench_intra");
+    ScanBenchIntra b;
+
+    // Callbacks on their own thread, like a nodelet manager's worker
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+    b.run();
+    spinner.stop();
+    return 0;
+}
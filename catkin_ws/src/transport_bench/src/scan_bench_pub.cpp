@@ -0,0 +1,49 @@
+/**
+ * @file scan_bench_pub.cpp
+ * @brief Publishes stamped LaserScan-sized messages for scan_bench_sub,
+ *          at a fixed rate or as fast as possible (`rate` <= 0).
+ */
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <transport_bench/bench_common.h>
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "scan_bench_pub");
+    ros::NodeHandle n("~");
+
+    int beams, count, queue;
+    double rate;
+    n.param("beams", beams, 1080);
+    n.param("count", count, 2000);
+    n.param("rate", rate, 40.0);
+    n.param("queue", queue, 100);
+
+    auto pub = n.advertise<sensor_msgs::LaserScan>("/bench_scan", queue);
+    auto scan = transport_bench::make_scan(beams);
+
+    // Don't start the clock until someone is listening
+    while(ros::ok() && pub.getNumSubscribers() == 0)
+        ros::WallDuration(0.01).sleep();
+    ros::WallDuration(0.5).sleep();
+
+    ROS_INFO("Publishing %d scans of %d beams at %s Hz", count, beams,
+             rate > 0.0 ? std::to_string(rate).c_str() : "max");
+
+    ros::WallRate loop(rate > 0.0 ? rate : 1.0);
+    for(int i = 0; i < count && ros::ok(); i++)
+    {
+        scan.header.seq = i;
+        transport_bench::stamp(scan, transport_bench::now_ns());
+        pub.publish(scan);
+
+        if(rate > 0.0)
+            loop.sleep();
+    }
+
+    // Let the last messages drain before the connection drops
+    ros::WallDuration(1.0).sleep();
+    return 0;
+}
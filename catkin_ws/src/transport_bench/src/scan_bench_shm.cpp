@@ -0,0 +1,132 @@
+/**
+ * @file scan_bench_shm.cpp
+ * @brief Shared-memory baseline: one process writes scans into a POSIX
+ *          shared memory slot guarded by a seqlock, another polls it.
+ *
+ * roscpp has no shared-memory transport, so this is the floor the ROS
+ * transports are compared against rather than a drop-in transport. Run one
+ * instance with `mode:=pub` and one with `mode:=sub`; the subscriber spins
+ * on the sequence counter, which is the best case for latency.
+ */
+
+#include <ros/ros.h>
+
+#include <transport_bench/bench_common.h>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include <atomic>
+#include <cstring>
+
+namespace bip = boost::interprocess;
+
+namespace
+{
+
+const char *SHM_NAME = "transport_bench_scan";
+const int MAX_BEAMS = 4096;
+
+struct shm_slot
+{
+    std::atomic<uint64_t> seq;  // odd while the writer is mid-update
+    int64_t sent_ns;
+    uint32_t msg_seq;
+    uint32_t beams;
+    float ranges[MAX_BEAMS];
+    float intensities[MAX_BEAMS];
+};
+
+void run_pub(shm_slot *slot, int beams, int count, double rate)
+{
+    auto scan = transport_bench::make_scan(beams);
+    ros::WallRate loop(rate > 0.0 ? rate : 1.0);
+
+    for(int i = 0; i < count && ros::ok(); i++)
+    {
+        auto s = slot->seq.load(std::memory_order_relaxed);
+        slot->seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot->sent_ns = transport_bench::now_ns();
+        slot->msg_seq = i;
+        slot->beams = beams;
+        std::memcpy(slot->ranges, scan.ranges.data(), beams*sizeof(float));
+        std::memcpy(slot->intensities, scan.intensities.data(), beams*sizeof(float));
+
+        slot->seq.store(s + 2, std::memory_order_release);
+
+        if(rate > 0.0)
+            loop.sleep();
+    }
+}
+
+void run_sub(shm_slot *slot, int count, double rate, const std::string &csv_file)
+{
+    transport_bench::LatencyStats stats;
+    std::vector<float> ranges(MAX_BEAMS), intensities(MAX_BEAMS);
+    auto last = slot->seq.load(std::memory_order_acquire);
+    auto last_rx = transport_bench::now_ns();
+
+    while((int)stats.count() < count && ros::ok())
+    {
+        auto s = slot->seq.load(std::memory_order_acquire);
+        if(s == last || (s & 1))
+        {
+            // Publisher finished while we were short of `count` (overwrites at saturation)
+            if(stats.count() > 0 && transport_bench::now_ns() - last_rx > 2000000000)
+                break;
+            continue;
+        }
+
+        // Copy out like a subscriber would, then check nobody wrote meanwhile
+        auto sent = slot->sent_ns;
+        auto msg_seq = slot->msg_seq;
+        auto beams = std::min(slot->beams, (uint32_t)MAX_BEAMS);
+        std::memcpy(ranges.data(), slot->ranges, beams*sizeof(float));
+        std::memcpy(intensities.data(), slot->intensities, beams*sizeof(float));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot->seq.load(std::memory_order_relaxed) != s)
+            continue;
+
+        last = s;
+        last_rx = transport_bench::now_ns();
+        stats.add(sent, last_rx, msg_seq, 2*beams*sizeof(float));
+    }
+    stats.report("shared_memory", rate, csv_file);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "scan_bench_shm", ros::init_options::AnonymousName);
+    ros::NodeHandle n("~");
+
+    std::string mode, csv_file;
+    int beams, count;
+    double rate;
+    n.param<std::string>("mode", mode, "sub");
+    n.param<std::string>("csv_file", csv_file, "");
+    n.param("beams", beams, 1080);
+    n.param("count", count, 2000);
+    n.param("rate", rate, 40.0);
+    beams = std::min(beams, MAX_BEAMS);
+
+    bip::shared_memory_object shm(bip::open_or_create, SHM_NAME, bip::read_write);
+    shm.truncate(sizeof(shm_slot));
+    bip::mapped_region region(shm, bip::read_write);
+    auto slot = static_cast<shm_slot *>(region.get_address());
+
+    if(mode == "pub")
+    {
+        // Give the subscriber time to map the segment
+        ros::WallDuration(1.0).sleep();
+        run_pub(slot, beams, count, rate);
+        bip::shared_memory_object::remove(SHM_NAME);
+    } else
+    {
+        run_sub(slot, count, rate, csv_file);
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file scan_bench_sub.cpp
+ * @brief Receives scan_bench_pub's messages over the transport named by
+ *          `transport` (tcp, tcp_nodelay or udp) and reports
+ *          publish-to-callback latency and throughput.
+ */
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <transport_bench/bench_common.h>
+
+class ScanBenchSub
+{
+    private:
+        ros::NodeHandle n;
+        ros::Subscriber sub;
+        ros::WallTimer idle_timer;
+
+        std::string transport, csv_file;
+        double rate;
+        int count;
+        transport_bench::LatencyStats stats;
+        int64_t last_rx;
+
+    public:
+        ScanBenchSub()
+            : n(ros::NodeHandle("~")), last_rx(0)
+        {
+            int queue;
+            n.param<std::string>("transport", transport, "tcp");
+            n.param<std::string>("csv_file", csv_file, "");
+            n.param("rate", rate, 40.0);
+            n.param("count", count, 2000);
+            n.param("queue", queue, 100);
+
+            ros::TransportHints hints;
+            if(transport == "tcp_nodelay")
+                hints = ros::TransportHints().tcpNoDelay();
+            else if(transport == "udp")
+                hints = ros::TransportHints().udp();
+            else
+                hints = ros::TransportHints().tcp();
+
+            sub = n.subscribe("/bench_scan", queue, &ScanBenchSub::scan_cb, this, hints);
+            idle_timer = n.createWallTimer(ros::WallDuration(0.5), &ScanBenchSub::idle_cb, this);
+        }
+
+        // Publisher finished while we were short of `count` (drops at saturation, udp)
+        void idle_cb(const ros::WallTimerEvent &)
+        {
+            if(stats.count() > 0 && transport_bench::now_ns() - last_rx > 2000000000)
+                finish();
+        }
+
+        void finish()
+        {
+            idle_timer.stop();
+            sub.shutdown();
+            stats.report(transport, rate, csv_file);
+            ros::shutdown();
+        }
+
+        void scan_cb(const sensor_msgs::LaserScan::ConstPtr &msg)
+        {
+            last_rx = transport_bench::now_ns();
+            stats.add(transport_bench::stamp_ns(*msg), last_rx, msg->header.seq,
+                      ros::serialization::serializationLength(*msg));
+
+            if((int)stats.count() == count)
+                finish();
+        }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "scan_bench_sub");
+    ScanBenchSub s;
+    ros::spin();
+    return 0;
+}
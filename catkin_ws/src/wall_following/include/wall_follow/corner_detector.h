@@ -0,0 +1,108 @@
+/**
+ * @file corner_detector.h
+ * @brief Looks down the forward sector of the scan for the end of the
+ *          corridor so the wall follower can start turning and braking
+ *          before the side wall turns away.
+ *
+ * A corner is reported when the free distance straight ahead is short
+ * and one of the forward-diagonal sectors opens up past it. The more
+ * open side is the direction of the turn.
+ */
+#pragma once
+
+#include <sensor_msgs/LaserScan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace wall_follow
+{
+
+struct corner
+{
+    bool present;
+    int dir;        // +1 left, -1 right
+    double dist;    // free distance straight ahead (m)
+};
+
+class CornerDetector
+{
+    private:
+        // [lo, hi] beam indices of each sector
+        int front_lo, front_hi;
+        int left_lo, left_hi;
+        int right_lo, right_hi;
+        double detect_range;    // only look for corners closer than this (m)
+        double open_margin;     // how much farther a side must see to count as open (m)
+
+        static int idx(double angle, double min_angle, double scan_inc)
+        {
+            return (int)std::round((angle - min_angle)/scan_inc);
+        }
+
+        // Smallest and largest valid range over [lo, hi]
+        template <typename Scan>
+        static void sweep(const Scan &msg, int lo, int hi,
+                          float &min_r, float &max_r)
+        {
+            min_r = std::numeric_limits<float>::infinity();
+            max_r = 0.0f;
+            lo = std::max(lo, 0);
+            hi = std::min(hi, (int)msg.ranges.size() - 1);
+            for(int i = lo; i <= hi; i++)
+            {
+                auto r = msg.ranges[i];
+                if(!(r >= msg.range_min))   // also drops NaN
+                    continue;
+                r = std::min(r, msg.range_max);
+                min_r = std::min(min_r, r);
+                max_r = std::max(max_r, r);
+            }
+        }
+
+    public:
+        /**
+         * @param front_half_width  half angle of the straight-ahead cone (rad)
+         * @param side_lo,side_hi   angular extent of each forward-diagonal sector (rad)
+         */
+        CornerDetector(double min_angle, double scan_inc,
+                       double front_half_width, double side_lo, double side_hi,
+                       double detect_range, double open_margin)
+            : detect_range(detect_range), open_margin(open_margin)
+        {
+            front_lo = idx(-front_half_width, min_angle, scan_inc);
+            front_hi = idx(front_half_width, min_angle, scan_inc);
+            left_lo = idx(side_lo, min_angle, scan_inc);
+            left_hi = idx(side_hi, min_angle, scan_inc);
+            right_lo = idx(-side_hi, min_angle, scan_inc);
+            right_hi = idx(-side_lo, min_angle, scan_inc);
+        }
+
+        // Scan is sensor_msgs::LaserScan or race_common::LaserScanView
+        template <typename Scan>
+        corner detect(const Scan &msg) const
+        {
+            corner c = {false, 0, 0.0};
+
+            float front_min, front_max, left_min, left_max, right_min, right_max;
+            sweep(msg, front_lo, front_hi, front_min, front_max);
+            c.dist = std::isfinite(front_min) ? front_min : msg.range_max;
+            if(c.dist > detect_range)
+                return c;
+
+            sweep(msg, left_lo, left_hi, left_min, left_max);
+            sweep(msg, right_lo, right_hi, right_min, right_max);
+
+            auto left_open = left_max > c.dist + open_margin;
+            auto right_open = right_max > c.dist + open_margin;
+            if(!left_open && !right_open)
+                return c;   // dead end or a wall face, nothing to anticipate
+
+            c.present = true;
+            c.dir = left_max >= right_max ? 1 : -1;
+            return c;
+        }
+};
+
+} // namespace wall_follow
@@ -0,0 +1,196 @@
+/**
+ * @file gain_schedule.h
+ * @brief Speed (and optionally curvature) scheduled PID gains for the
+ *          wall follower.
+ *
+ * Breakpoints are loaded from params with arbitrary spacing and resampled
+ * once onto a uniform grid, so a lookup per control cycle is an index
+ * computation plus a (bi)linear blend -- O(1) no matter how many
+ * breakpoints were given.
+ */
+#pragma once
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wall_follow
+{
+
+struct pid_gains
+{
+    double kp, ki, kd;
+};
+
+class GainSchedule
+{
+    private:
+        // Uniform grid, row-major [speed][curvature]
+        std::vector<pid_gains> table;
+        double v_min, v_step;
+        double k_min, k_step;
+        int n_v, n_k;
+
+        static double clamp_idx(double x, int n)
+        {
+            return std::min(std::max(x, 0.0), (double)(n - 1));
+        }
+
+        // Piecewise-linear interpolation on (possibly non-uniform) breakpoints
+        static double interp(const std::vector<double> &xs, const std::vector<double> &ys, double x)
+        {
+            if(x <= xs.front()) return ys.front();
+            if(x >= xs.back()) return ys.back();
+
+            auto hi = std::upper_bound(xs.begin(), xs.end(), x) - xs.begin();
+            auto lo = hi - 1;
+            auto t = (x - xs[lo])/(xs[hi] - xs[lo]);
+            return ys[lo] + t*(ys[hi] - ys[lo]);
+        }
+
+        static pid_gains lerp(const pid_gains &a, const pid_gains &b, double t)
+        {
+            return { a.kp + t*(b.kp - a.kp),
+                     a.ki + t*(b.ki - a.ki),
+                     a.kd + t*(b.kd - a.kd) };
+        }
+
+    public:
+        // Constant gains, used when no schedule is configured.
+        explicit GainSchedule(const pid_gains &fixed)
+            : table(1, fixed),
+              v_min(0.0), v_step(1.0),
+              k_min(0.0), k_step(1.0),
+              n_v(1), n_k(1)
+        {}
+
+        /**
+         * @brief Build a schedule from breakpoints.
+         *
+         * @param speeds     strictly increasing speed breakpoints (m/s)
+         * @param curvatures strictly increasing curvature breakpoints (1/m),
+         *                   may hold a single entry to disable that axis
+         * @param kp,ki,kd   gains, row-major [speed][curvature]
+         * @param resolution number of uniform cells per axis
+         */
+        GainSchedule(const std::vector<double> &speeds,
+                     const std::vector<double> &curvatures,
+                     const std::vector<double> &kp,
+                     const std::vector<double> &ki,
+                     const std::vector<double> &kd,
+                     int resolution = 64)
+        {
+            n_v = speeds.size() > 1 ? resolution : 1;
+            n_k = curvatures.size() > 1 ? resolution : 1;
+            v_min = speeds.front();
+            k_min = curvatures.front();
+            v_step = n_v > 1 ? (speeds.back() - v_min)/(n_v - 1) : 1.0;
+            k_step = n_k > 1 ? (curvatures.back() - k_min)/(n_k - 1) : 1.0;
+
+            auto cols = curvatures.size();
+            std::vector<double> col_kp(speeds.size()), col_ki(speeds.size()), col_kd(speeds.size());
+            std::vector<pid_gains> by_speed(n_v*cols);
+
+            // Resample the speed axis for every curvature column ...
+            for(size_t c = 0; c < cols; c++)
+            {
+                for(size_t s = 0; s < speeds.size(); s++)
+                {
+                    col_kp[s] = kp[s*cols + c];
+                    col_ki[s] = ki[s*cols + c];
+                    col_kd[s] = kd[s*cols + c];
+                }
+                for(int i = 0; i < n_v; i++)
+                {
+                    auto v = v_min + i*v_step;
+                    by_speed[i*cols + c] = { interp(speeds, col_kp, v),
+                                             interp(speeds, col_ki, v),
+                                             interp(speeds, col_kd, v) };
+                }
+            }
+
+            // ... then the curvature axis for every resampled speed row
+            table.resize(n_v*n_k);
+            std::vector<double> row_kp(cols), row_ki(cols), row_kd(cols);
+            for(int i = 0; i < n_v; i++)
+            {
+                for(size_t c = 0; c < cols; c++)
+                {
+                    row_kp[c] = by_speed[i*cols + c].kp;
+                    row_ki[c] = by_speed[i*cols + c].ki;
+                    row_kd[c] = by_speed[i*cols + c].kd;
+                }
+                for(int j = 0; j < n_k; j++)
+                {
+                    auto k = k_min + j*k_step;
+                    table[i*n_k + j] = { interp(curvatures, row_kp, k),
+                                         interp(curvatures, row_ki, k),
+                                         interp(curvatures, row_kd, k) };
+                }
+            }
+        }
+
+        /**
+         * @brief Load a schedule from the parameter server. Falls back to the
+         *          fixed gains when `gain_schedule/speeds` is not set.
+         *
+         * @return nullptr if the parameters are present but malformed
+         */
+        static std::shared_ptr<const GainSchedule> fromParams(
+            const ros::NodeHandle &n, const pid_gains &fixed)
+        {
+            std::vector<double> speeds, curvatures, kp, ki, kd;
+            if(!n.getParam("gain_schedule/speeds", speeds))
+                return std::make_shared<const GainSchedule>(fixed);
+
+            if(!n.getParam("gain_schedule/curvatures", curvatures) || curvatures.empty())
+                curvatures = {0.0};
+
+            n.getParam("gain_schedule/kp", kp);
+            n.getParam("gain_schedule/ki", ki);
+            n.getParam("gain_schedule/kd", kd);
+
+            auto expected = speeds.size()*curvatures.size();
+            if(speeds.empty() || kp.size() != expected || ki.size() != expected || kd.size() != expected)
+            {
+                ROS_ERROR("gain_schedule: expected %zu gains per term (speeds x curvatures)", expected);
+                return nullptr;
+            }
+            // Equal breakpoints would make a zero-width cell (and a zero step
+            // when an axis collapses to one value)
+            auto not_increasing = std::greater_equal<double>();
+            if(std::adjacent_find(speeds.begin(), speeds.end(), not_increasing) != speeds.end() ||
+               std::adjacent_find(curvatures.begin(), curvatures.end(), not_increasing) != curvatures.end())
+            {
+                ROS_ERROR("gain_schedule: breakpoints must be strictly increasing");
+                return nullptr;
+            }
+
+            int resolution = 64;
+            n.getParam("gain_schedule/resolution", resolution);
+            return std::make_shared<const GainSchedule>(
+                speeds, curvatures, kp, ki, kd, std::max(resolution, 2));
+        }
+
+        // O(1): one index computation and a bilinear blend of four cells
+        pid_gains lookup(double speed, double curvature = 0.0) const
+        {
+            auto fv = clamp_idx((std::fabs(speed) - v_min)/v_step, n_v);
+            auto fk = clamp_idx((std::fabs(curvature) - k_min)/k_step, n_k);
+
+            int i0 = (int)fv, j0 = (int)fk;
+            int i1 = std::min(i0 + 1, n_v - 1), j1 = std::min(j0 + 1, n_k - 1);
+            auto tv = fv - i0, tk = fk - j0;
+
+            auto lo = lerp(table[i0*n_k + j0], table[i0*n_k + j1], tk);
+            auto hi = lerp(table[i1*n_k + j0], table[i1*n_k + j1], tk);
+            return lerp(lo, hi, tv);
+        }
+};
+
+} // namespace wall_follow
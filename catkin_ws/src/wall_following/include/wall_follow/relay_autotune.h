@@ -0,0 +1,141 @@
+/**
+ * @file relay_autotune.h
+ * @brief Relay (Astrom-Hagglund) experiment on the lateral error, giving
+ *          starting PID gains for the wall follower.
+ *
+ * The steering is switched between +h and -h on the sign of the error,
+ * with a hysteresis band so sensor noise can't chatter the relay. The loop
+ * settles into a limit cycle at its ultimate period Tu, and the amplitude
+ * a of the error gives the ultimate gain Ku = 4h/(pi*sqrt(a^2 - eps^2)).
+ *
+ * Both are measured while streaming: every upward crossing of the band
+ * closes a cycle, whose period is the time since the previous one and
+ * whose amplitude is half its peak to peak error. The first cycles are
+ * discarded while the oscillation settles, the rest are averaged.
+ */
+#pragma once
+
+#include <wall_follow/gain_schedule.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace wall_follow
+{
+
+struct autotune_params
+{
+    double relay;           // steering amplitude h (rad)
+    double hysteresis;      // error band eps (m)
+    int settle_cycles;      // cycles discarded first
+    int cycles;             // cycles averaged
+    double max_error;       // abort beyond this |error| (m)
+    double timeout;         // abort after this long (s)
+};
+
+class RelayAutotune
+{
+    public:
+        enum state { IDLE, RUNNING, DONE, FAILED };
+
+    private:
+        autotune_params p;
+        state s;
+        double start, last_rise;
+        double output;
+        double lo, hi;              // error extremes of the current cycle
+        int seen;                   // cycles closed so far
+        double period_sum, amp_sum;
+        double ku, tu;
+
+    public:
+        explicit RelayAutotune(const autotune_params &p)
+            : p(p), s(IDLE), output(0.0), ku(0.0), tu(0.0) {}
+
+        void begin(double now)
+        {
+            s = RUNNING;
+            start = now;
+            last_rise = -1.0;
+            output = p.relay;
+            lo = std::numeric_limits<double>::infinity();
+            hi = -lo;
+            seen = 0;
+            period_sum = amp_sum = 0.0;
+        }
+
+        void cancel()
+        {
+            s = IDLE;
+        }
+
+        /**
+         * @brief Feed the error at time `now` (s); returns the steering to
+         *          apply while running.
+         */
+        double update(double error, double now)
+        {
+            if(s != RUNNING)
+                return 0.0;
+            if(std::fabs(error) > p.max_error || now - start > p.timeout)
+            {
+                s = FAILED;
+                return 0.0;
+            }
+
+            lo = std::min(lo, error);
+            hi = std::max(hi, error);
+
+            if(output < 0.0 && error > p.hysteresis)
+            {
+                // Upward crossing: one full cycle since the last one
+                output = p.relay;
+                if(last_rise >= 0.0)
+                {
+                    if(++seen > p.settle_cycles)
+                    {
+                        period_sum += now - last_rise;
+                        amp_sum += 0.5*(hi - lo);
+                    }
+                    if(seen >= p.settle_cycles + p.cycles)
+                        finish();
+                }
+                last_rise = now;
+                lo = hi = error;
+            } else if(output > 0.0 && error < -p.hysteresis)
+            {
+                output = -p.relay;
+            }
+            return output;
+        }
+
+        state getState() const
+        {
+            return s;
+        }
+
+        double getKu() const { return ku; }
+        double getTu() const { return tu; }
+
+        /**
+         * @brief Ziegler-Nichols "some overshoot" rule, gentler than the
+         *          classic one for a car that shouldn't weave.
+         */
+        pid_gains gains() const
+        {
+            return { ku/3.0, (2.0/3.0)*ku/tu, ku*tu/9.0 };
+        }
+
+    private:
+        void finish()
+        {
+            auto a = amp_sum/p.cycles;
+            tu = period_sum/p.cycles;
+            auto eff = std::sqrt(std::max(a*a - p.hysteresis*p.hysteresis, 1e-12));
+            ku = 4.0*p.relay/(M_PI*eff);
+            s = tu > 0.0 ? DONE : FAILED;
+        }
+};
+
+} // namespace wall_follow
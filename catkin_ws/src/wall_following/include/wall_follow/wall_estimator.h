@@ -0,0 +1,114 @@
+/**
+ * @file wall_estimator.h
+ * @brief Two-beam wall estimate (lab 3) that survives gaps in the wall.
+ *
+ * The beams between `a` and `b` are walked once per scan. Any invalid
+ * beam (NaN/inf/out of range) or a range jump between neighbouring beams
+ * marks the window as broken -- a doorway or opening -- and the last good
+ * wall model is held instead, with a confidence that decays over time.
+ */
+#pragma once
+
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace wall_follow
+{
+
+struct wall_model
+{
+    double alpha;   // wall angle relative to the heading (rad)
+    double dist;    // perpendicular distance to the wall (m)
+};
+
+class WallEstimator
+{
+    private:
+        int a_idx, b_idx;
+        double theta;       // angle between beam a and beam b
+        double max_jump;    // largest range step between neighbouring beams (m)
+        double hold_time;   // time constant of the confidence decay (s)
+
+        wall_model model;
+        ros::Time last_good;
+        bool has_model;
+
+    public:
+        /**
+         * @param side_angle  beam orthogonal to the wall: +pi/2 left, -pi/2 right
+         * @param theta       nominal angle from beam b to beam a, towards the front
+         */
+        WallEstimator(double side_angle, double theta,
+                      double min_angle, double scan_inc,
+                      double max_jump, double hold_time)
+            : max_jump(max_jump), hold_time(hold_time),
+              model({0.0, 0.0}), has_model(false)
+        {
+            auto sign = side_angle > 0.0 ? 1.0 : -1.0;
+            b_idx = (int)std::round((side_angle - min_angle)/scan_inc);
+            a_idx = (int)std::round((side_angle - sign*theta - min_angle)/scan_inc);
+
+            // Update theta to be MORE accurate due to rounding errors in finding our idx
+            this->theta = scan_inc*std::abs(b_idx - a_idx);
+        }
+
+        /**
+         * @brief Re-estimate the wall from `msg`.
+         *
+         * @return true when the wall window is continuous and the model was
+         *          refreshed; false when the held model is being reused.
+         *
+         * @tparam Scan  sensor_msgs::LaserScan or race_common::LaserScanView
+         */
+        template <typename Scan>
+        bool update(const Scan &msg)
+        {
+            auto lo = std::min(a_idx, b_idx), hi = std::max(a_idx, b_idx);
+            if(lo < 0 || hi >= (int)msg.ranges.size())
+                return false;
+
+            // Single pass over the window: every beam valid, no steps
+            auto prev = msg.ranges[lo];
+            auto valid = std::isfinite(prev) && prev >= msg.range_min && prev <= msg.range_max;
+            for(int i = lo + 1; valid && i <= hi; i++)
+            {
+                auto r = msg.ranges[i];
+                valid = std::isfinite(r) && r >= msg.range_min && r <= msg.range_max
+                        && std::fabs(r - prev) <= max_jump;
+                prev = r;
+            }
+            if(!valid)
+                return false;
+
+            double a = msg.ranges[a_idx];
+            double b = msg.ranges[b_idx];
+            model.alpha = std::atan((a*std::cos(theta) - b)/(a*std::sin(theta)));
+            model.dist = b*std::cos(model.alpha);
+            last_good = msg.header.stamp;
+            has_model = true;
+            return true;
+        }
+
+        // 1 right after a good estimate, decaying to 0 while the wall is missing
+        double confidence(const ros::Time &now) const
+        {
+            if(!has_model)
+                return 0.0;
+            auto age = std::max((now - last_good).toSec(), 0.0);
+            return std::exp(-age/hold_time);
+        }
+
+        const wall_model &get() const
+        {
+            return model;
+        }
+
+        int getA() const { return a_idx; }
+        int getB() const { return b_idx; }
+        double getTheta() const { return theta; }
+};
+
+} // namespace wall_follow
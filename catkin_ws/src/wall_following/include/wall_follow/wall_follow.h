@@ -0,0 +1,486 @@
+/**
+ * @file wall_follow.h
+ * @brief PID wall follower (F1Tenth lab 3) with gain scheduling, held
+ *          walls through openings, corner anticipation and relay autotune.
+ *
+ * Topics are resolved in the namespace of the NodeHandle it is given, so
+ * several cars can run in one process (see multi_car_sim).
+ */
+#pragma once
+
+#include <ros/ros.h> 
+
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/LaserScan.h>
+#include <ackermann_msgs/AckermannDriveStamped.h>
+#include <ackermann_msgs/AckermannDrive.h>
+
+#include <std_msgs/Int32MultiArray.h>
+#include <std_srvs/Empty.h>
+#include <std_srvs/Trigger.h>
+#include <nav_msgs/Odometry.h>
+
+#include <wall_follow/corner_detector.h>
+#include <wall_follow/gain_schedule.h>
+#include <wall_follow/relay_autotune.h>
+#include <wall_follow/wall_estimator.h>
+#include <race_common/laser_scan_view.h>
+#include <race_common/scan_slices.h>
+#include <race_common/speed_map.h>
+#include <race_common/velocity_input.h>
+#include <race_common/viz_publisher.h>
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+class WallFollow 
+{ 
+    private: 
+        ros::NodeHandle nh, n;   // topics, params and services
+        ros::Publisher drive_pub; 
+        ros::Subscriber scan_sub, mux_sub, odom_sub, velocity_sub; 
+        race_common::SliceIndex slice_index; 
+        ros::ServiceServer reload_srv, autotune_srv; 
+
+        ros::Time curr_time; 
+
+        std::string drive_topic; 
+
+        int mux_idx;
+        bool done;
+        double rate = 60.0;   
+
+        wall_follow::pid_gains gains; 
+
+        // Swapped wholesale on reload, so a cycle never sees a half-built table
+        std::shared_ptr<const wall_follow::GainSchedule> schedule; 
+
+        struct {
+            int num_scans; 
+            double min_angle, max_angle,
+                    scan_inc; 
+        } lidar_data;
+
+        struct {
+            ros::Time time; 
+            double x, y; 
+            double speed, yaw_rate; 
+        } odom_data; 
+        race_common::VelocityInput velocity; 
+        
+        double err, prev_err; 
+        double vel;
+        double p,i,d; 
+        double desired_dist, lookahead, max_steering_angle; 
+        double cruise_speed, max_speed; 
+        race_common::SpeedMap speed_map; 
+        ros::Time prev_time; 
+
+        // Left wall is followed, right wall is the fallback through openings
+        std::unique_ptr<wall_follow::WallEstimator> left_wall, right_wall; 
+        double min_wall_confidence; 
+        double corridor_width; 
+
+        // Feedforward for the corner seen ahead, refreshed every scan
+        std::unique_ptr<wall_follow::CornerDetector> corner_detector; 
+        double wheelbase, friction_coeff, corner_decel, min_turn_radius; 
+        double ff_steer, speed_cap; 
+
+        // Relay experiment that replaces the PID while it runs
+        std::unique_ptr<wall_follow::RelayAutotune> autotune; 
+        double autotune_speed; 
+
+        // Wall fits on wall_follow_markers while someone watches them
+        race_common::VizPublisher viz; 
+
+        double L, theta = M_PI/4.0; // [theta = 45 deg] (0 < theta < 70deg)
+
+    public: 
+        /**
+         * @param nh   topics are resolved in its namespace
+         * @param pnh  params are read from it and services advertised on it
+         */
+        WallFollow(ros::NodeHandle nh = ros::NodeHandle(), ros::NodeHandle pnh = ros::NodeHandle("~")): 
+            nh(nh), n(pnh), 
+            err(0.0), prev_err(0.0),   
+            p(0.0), i(0.0), d(0.0)
+        {
+            odom_data.x = odom_data.y = 0.0; 
+            odom_data.speed = 0.0; 
+            odom_data.yaw_rate = 0.0; 
+            ff_steer = 0.0; 
+            speed_cap = std::numeric_limits<double>::infinity(); 
+
+            // Extract  lidar info from one message
+            boost::shared_ptr<const sensor_msgs::LaserScan>
+                tmp_scan = ros::topic::waitForMessage<sensor_msgs::LaserScan>("scan", nh, ros::Duration(10.0)); 
+            
+            if(tmp_scan != NULL) 
+            { 
+                lidar_data.scan_inc = tmp_scan->angle_increment;
+                lidar_data.min_angle = tmp_scan->angle_min; 
+                lidar_data.max_angle = tmp_scan->angle_max; 
+                lidar_data.num_scans = 
+                    (int)ceil((lidar_data.max_angle - lidar_data.min_angle)/lidar_data.scan_inc); 
+
+                ROS_INFO(""); 
+                ROS_INFO("Min Angle:\t%f", lidar_data.min_angle);
+                ROS_INFO("Max Andgle:\t%f", lidar_data.max_angle); 
+                ROS_INFO("Scan Incr:\t%f", lidar_data.scan_inc);  
+                ROS_INFO("Num scans:\t%d", lidar_data.num_scans); 
+                ROS_INFO("");
+            } else 
+            {
+                ROS_INFO_ONCE("Couldn't extract lidar instrinsics... \nEXITING");
+                exit(-1); 
+            }
+
+            n.getParam("wall_follow_idx", mux_idx); 
+            n.getParam("wall_follow_topic", drive_topic);
+
+            n.param("wall_follow_desired_dist", desired_dist, 1.0); 
+            n.param("wall_follow_lookahead", lookahead, 0.5); 
+            n.param("max_steering_angle", max_steering_angle, 0.4189); 
+            n.param("max_speed", max_speed, 7.0); 
+            n.param("wall_follow_speed", cruise_speed, 1.5); 
+            cruise_speed = std::min(cruise_speed, max_speed); 
+
+            // Optional per-cell speeds; cruise_speed applies off the map
+            std::string speed_map_file; 
+            if(n.getParam("speed_map_file", speed_map_file) && !speed_map_file.empty())
+            {
+                if(speed_map.open(speed_map_file))
+                    ROS_INFO("Loaded speed map %s", speed_map_file.c_str()); 
+                else 
+                    ROS_WARN("Couldn't load speed map %s, using wall_follow_speed", speed_map_file.c_str()); 
+            }
+
+            // Fixed gains double as the fallback when no schedule is given
+            n.param("wall_follow_kp", gains.kp, 1.0); 
+            n.param("wall_follow_ki", gains.ki, 0.0); 
+            n.param("wall_follow_kd", gains.kd, 0.1); 
+            schedule = wall_follow::GainSchedule::fromParams(n, gains); 
+            if(schedule == nullptr)
+                schedule = std::make_shared<const wall_follow::GainSchedule>(gains); 
+
+            // pubs
+            drive_pub = nh.advertise<ackermann_msgs::AckermannDriveStamped>(drive_topic, 1); 
+            double viz_rate; 
+            n.param("viz_rate", viz_rate, 10.0); 
+            viz = race_common::VizPublisher(nh, "wall_follow_markers", viz_rate); 
+
+            // subs (the scan at the end, once the beams we read are known)
+            mux_sub = nh.subscribe("mux", 1, &WallFollow::mux_cb, this); 
+            odom_sub = nh.subscribe("odom", 1, &WallFollow::odom_cb, this); 
+            // velocity_ekf's estimate while it runs, /odom's twist otherwise
+            velocity_sub = nh.subscribe("velocity_estimate", 1, &WallFollow::velocity_cb, this); 
+
+            // srvs
+            reload_srv = n.advertiseService("reload_gains", &WallFollow::reload_gains_cb, this); 
+            autotune_srv = n.advertiseService("autotune", &WallFollow::autotune_cb, this); 
+
+            wall_follow::autotune_params ap; 
+            n.param("autotune_speed", autotune_speed, 1.0); 
+            n.param("autotune_relay", ap.relay, 0.15); 
+            n.param("autotune_hysteresis", ap.hysteresis, 0.03); 
+            n.param("autotune_settle_cycles", ap.settle_cycles, 2); 
+            n.param("autotune_cycles", ap.cycles, 4); 
+            n.param("autotune_max_error", ap.max_error, 0.8); 
+            n.param("autotune_timeout", ap.timeout, 30.0); 
+            autotune.reset(new wall_follow::RelayAutotune(ap)); 
+
+            double max_jump, hold_time; 
+            n.param("wall_gap_jump", max_jump, 0.5); 
+            n.param("wall_hold_time", hold_time, 0.3); 
+            n.param("wall_min_confidence", min_wall_confidence, 0.2); 
+            corridor_width = 2.0*desired_dist; 
+
+            // We want the b beam orthogonally to the left of the front
+            // of the car _| and the a beam theta ahead of it 
+            left_wall.reset(new wall_follow::WallEstimator(M_PI/2.0, theta, 
+                lidar_data.min_angle, lidar_data.scan_inc, max_jump, hold_time)); 
+            right_wall.reset(new wall_follow::WallEstimator(-M_PI/2.0, theta, 
+                lidar_data.min_angle, lidar_data.scan_inc, max_jump, hold_time)); 
+
+            theta = left_wall->getTheta(); 
+            ROS_INFO("Angle Difference: %f", theta); 
+
+            double front_half_width, side_lo, side_hi, detect_range, open_margin; 
+            n.param("corner_front_half_width", front_half_width, 0.1); 
+            n.param("corner_side_min_angle", side_lo, 0.35); 
+            n.param("corner_side_max_angle", side_hi, 1.2); 
+            n.param("corner_detect_range", detect_range, 6.0); 
+            n.param("corner_open_margin", open_margin, 1.5); 
+            n.param("corner_decel", corner_decel, 4.0); 
+            n.param("corner_min_radius", min_turn_radius, 0.5); 
+            n.param("wheelbase", wheelbase, 0.3302); 
+            n.param("friction_coeff", friction_coeff, 0.523); 
+            corner_detector.reset(new wall_follow::CornerDetector(lidar_data.min_angle, 
+                lidar_data.scan_inc, front_half_width, side_lo, side_hi, detect_range, open_margin)); 
+
+            // Either the whole scan, or only our windows from race_common's scan_slicer
+            bool use_scan_slices; 
+            n.param("use_scan_slices", use_scan_slices, false); 
+            if(use_scan_slices)
+            {
+                // The wall beams and corner sectors, a beam wider each way for
+                // the rounding to beam indices. Set before subscribing, which
+                // is when the slicer reads them.
+                auto pad = lidar_data.scan_inc; 
+                std::vector<double> windows = {
+                    M_PI/2.0 - theta - pad, M_PI/2.0 + pad, 
+                    -M_PI/2.0 - pad, -M_PI/2.0 + theta + pad, 
+                    -front_half_width - pad, front_half_width + pad, 
+                    side_lo - pad, side_hi + pad, 
+                    -side_hi - pad, -side_lo + pad}; 
+                nh.setParam("scan_slice_windows/wall_follow", windows); 
+                scan_sub = nh.subscribe("scan_slices/wall_follow", 1, &WallFollow::slices_cb, this); 
+            } else 
+                scan_sub = nh.subscribe("scan", 1, &WallFollow::lidar_cb, this); 
+        } 
+
+        void mux_cb(const std_msgs::Int32MultiArray &msg) 
+        {
+            // Set the mux idx to verify wether to 
+            //  turn the PID controller on/off. 
+            done = msg.data[mux_idx]; 
+        }
+
+        void odom_cb(const nav_msgs::Odometry &msg) 
+        {
+            odom_data.time = msg.header.stamp; 
+            odom_data.x = msg.pose.pose.position.x; 
+            odom_data.y = msg.pose.pose.position.y; 
+            velocity.from_odom(msg); 
+            odom_data.speed = velocity.speed(); 
+            odom_data.yaw_rate = velocity.yaw_rate(); 
+        }
+
+        void velocity_cb(const geometry_msgs::TwistWithCovarianceStamped &msg) 
+        {
+            velocity.from_estimate(msg); 
+            odom_data.speed = velocity.speed(); 
+            odom_data.yaw_rate = velocity.yaw_rate(); 
+        }
+
+        bool reload_gains_cb(std_srvs::Empty::Request &, std_srvs::Empty::Response &) 
+        {
+            // Re-read the schedule; keep the old one if the new one is malformed
+            auto fresh = wall_follow::GainSchedule::fromParams(n, gains); 
+            if(fresh == nullptr)
+                return false; 
+
+            schedule = fresh; 
+            ROS_INFO("Reloaded wall follow gain schedule."); 
+            return true; 
+        }
+
+        bool autotune_cb(std_srvs::Trigger::Request &, std_srvs::Trigger::Response &res) 
+        {
+            autotune->begin(ros::Time::now().toSec()); 
+            res.success = true; 
+            res.message = "Relay experiment started; gains are set when it finishes."; 
+            ROS_INFO("Autotune: relay experiment at %.2f m/s.", autotune_speed); 
+            return true; 
+        }
+
+        // Relay steering at a fixed speed; installs the gains once the
+        // oscillation has been measured
+        void relay_control(const double &err, const ros::Time &stamp) 
+        {
+            ackermann_msgs::AckermannDriveStamped drive; 
+            drive.header.stamp = stamp; 
+            drive.drive.steering_angle = autotune->update(err, stamp.toSec()); 
+            drive.drive.speed = std::min(autotune_speed, max_speed); 
+
+            switch(autotune->getState())
+            {
+                case wall_follow::RelayAutotune::DONE: 
+                {
+                    gains = autotune->gains(); 
+                    schedule = std::make_shared<const wall_follow::GainSchedule>(gains); 
+                    n.setParam("wall_follow_kp", gains.kp); 
+                    n.setParam("wall_follow_ki", gains.ki); 
+                    n.setParam("wall_follow_kd", gains.kd); 
+                    i = 0.0; 
+                    prev_time = ros::Time(); 
+                    ROS_INFO("Autotune: Ku %.3f, Tu %.3f s -> kp %.3f ki %.3f kd %.3f (fixed gains, "
+                             "schedule replaced)", autotune->getKu(), autotune->getTu(), gains.kp, gains.ki, gains.kd); 
+                    autotune->cancel(); 
+                    break; 
+                }
+                case wall_follow::RelayAutotune::FAILED: 
+                    ROS_WARN("Autotune failed (error too large or no steady oscillation); gains unchanged."); 
+                    autotune->cancel(); 
+                    prev_time = ros::Time(); 
+                    break; 
+                default: 
+                    break; 
+            }
+            drive_pub.publish(drive); 
+        }
+
+        void lidar_cb(const race_common::LaserScanView &msg)
+        {
+            process_scan(msg); 
+        }
+
+        void slices_cb(const race_common::ScanSlices::ConstPtr &msg)
+        {
+            process_scan(race_common::SlicedScan(*msg, slice_index)); 
+        }
+
+        // Scan is anything LaserScan shaped: LaserScanView or SlicedScan
+        template <typename Scan>
+        void process_scan(const Scan &msg)
+        {
+            const auto &now = msg.header.stamp; 
+            auto left_ok = left_wall->update(msg); 
+            auto right_ok = right_wall->update(msg); 
+
+            if(left_ok && right_ok)
+                corridor_width = left_wall->get().dist + right_wall->get().dist; 
+
+            // Project the distance forward by the distance covered in `lookahead` seconds
+            L = std::max(odom_data.speed, 0.5)*lookahead; 
+
+            auto left_conf = left_ok ? 1.0 : left_wall->confidence(now); 
+            auto right_conf = right_ok ? 1.0 : right_wall->confidence(now); 
+
+            double error; 
+            if(left_conf >= min_wall_confidence || right_conf < min_wall_confidence)
+            {
+                // Left wall, or its held model fading out through an opening
+                const auto &wall = left_wall->get(); 
+                auto dt_1 = wall.dist + L*std::sin(wall.alpha); 
+                error = left_conf*(dt_1 - desired_dist); 
+            } else 
+            {
+                // Opening on the left: keep the same line off the right wall
+                const auto &wall = right_wall->get(); 
+                auto dt_1 = wall.dist + L*std::sin(wall.alpha); 
+                error = right_conf*((corridor_width - desired_dist) - dt_1); 
+                ROS_INFO_THROTTLE(1.0, "Left wall lost, following right wall."); 
+            }
+
+            if(viz.wanted())
+                post_markers(msg.header, left_conf, right_conf); 
+
+            if(autotune->getState() == wall_follow::RelayAutotune::RUNNING)
+            {
+                relay_control(error, now); 
+                return; 
+            }
+
+            anticipate_corner(msg); 
+            pid_control(error, odom_data.speed, now); 
+        }
+
+        // Both wall fits in the lidar frame, fading with their confidence,
+        // and the line desired_dist off the left one
+        void post_markers(const std_msgs::Header &header, double left_conf, double right_conf) 
+        {
+            auto left = left_wall->get(), right = right_wall->get(); 
+            auto target = desired_dist; 
+
+            viz.post([=](visualization_msgs::MarkerArray &out) {
+                // side +1 left, -1 right; the wall is `offset` closer than the fit
+                auto line = [&](const wall_follow::wall_model &w, int side, double offset, int id, 
+                                const std_msgs::ColorRGBA &color) {
+                    auto m = race_common::viz::marker(header, "walls", id, visualization_msgs::Marker::LINE_STRIP, 0.03); 
+                    m.color = color; 
+                    auto d = w.dist - offset; 
+                    auto fx = -d*std::sin(w.alpha), fy = side*d*std::cos(w.alpha); 
+                    for(double s : {-1.0, 3.0})
+                        m.points.push_back(race_common::viz::point(fx + s*std::cos(w.alpha), 
+                                                                   fy + s*side*std::sin(w.alpha))); 
+                    out.markers.push_back(m); 
+                }; 
+                line(left, 1, 0.0, 0, race_common::viz::color(0.0f, 1.0f, 0.0f, std::max(left_conf, 0.1))); 
+                line(right, -1, 0.0, 1, race_common::viz::color(0.0f, 0.5f, 1.0f, std::max(right_conf, 0.1))); 
+                line(left, 1, target, 2, race_common::viz::color(1.0f, 1.0f, 1.0f, std::max(left_conf, 0.1))); 
+            }); 
+        }
+
+        template <typename Scan>
+        void anticipate_corner(const Scan &msg)
+        {
+            auto c = corner_detector->detect(msg); 
+            if(!c.present)
+            {
+                ff_steer = 0.0; 
+                speed_cap = std::numeric_limits<double>::infinity(); 
+                return; 
+            }
+
+            // Arc that ends `desired_dist` off the far wall; it tightens as
+            // the corner gets closer, which ramps the feedforward in
+            auto to_turn = std::max(c.dist - desired_dist, 0.0); 
+            auto radius = std::max(to_turn, min_turn_radius); 
+            ff_steer = c.dir*std::atan(wheelbase/radius); 
+
+            // Fastest speed we can still brake down from to take that arc
+            auto v_corner_sq = friction_coeff*9.81*radius; 
+            speed_cap = std::sqrt(v_corner_sq + 2.0*corner_decel*to_turn); 
+        }
+
+        void pid_control(const double &err, const double &vel, const ros::Time &stamp)
+        {
+            auto dt = prev_time.isZero() ? 0.0 : (stamp - prev_time).toSec(); 
+            prev_time = stamp; 
+
+            // yaw rate over speed is the path curvature we are currently driving
+            auto curvature = std::fabs(vel) > 0.1 ? odom_data.yaw_rate/vel : 0.0; 
+            auto k = schedule->lookup(vel, curvature); 
+
+            p = err; 
+            auto prev_i = i; 
+            if(dt > 0.0)
+            {
+                i += err*dt; 
+                d = (err - prev_err)/dt; 
+            }
+            prev_err = err; 
+
+            auto raw_steer = k.kp*p + k.ki*i + k.kd*d + ff_steer; 
+            auto steer = std::min(std::max(raw_steer, -max_steering_angle), max_steering_angle); 
+
+            // Anti-windup: while the steering is saturated, don't integrate
+            // error that pushes it further into the limit
+            if(steer != raw_steer && k.ki*err*raw_steer > 0.0)
+                i = prev_i; 
+
+            ackermann_msgs::AckermannDriveStamped drive; 
+            drive.header.stamp = stamp; 
+            drive.drive.steering_angle = steer; 
+
+            // Slow down with steering effort (lab 3 speed bands, scaled to the
+            // speed the map allows here)
+            auto top_speed = std::min(speed_map.query(odom_data.x, odom_data.y, cruise_speed), max_speed); 
+            auto abs_steer = std::fabs(steer); 
+            if(abs_steer < 10.0*M_PI/180.0)
+                drive.drive.speed = top_speed; 
+            else if(abs_steer < 20.0*M_PI/180.0)
+                drive.drive.speed = top_speed*(2.0/3.0); 
+            else 
+                drive.drive.speed = top_speed/3.0; 
+            drive.drive.speed = std::min((double)drive.drive.speed, speed_cap); 
+
+            drive_pub.publish(drive); 
+        }
+
+        double getRange(const sensor_msgs::LaserScan &data, const double &angle);
+        double followLeft(); // need params
+
+        bool getStatus() const 
+        {
+            return done; 
+        }
+
+        double getRate() const 
+        {
+            return rate; 
+        }
+};